@@ -19,6 +19,8 @@ typedef struct {
     clientState state;
 } client;
 
+void clientHandshakeTask(void * data);
+
 client startClient(address clientAddress)
 {
     client newClient;
@@ -43,6 +45,7 @@ void clientConnect(client * CLIENT, address serverAddress)
     CLIENT->state = CLIENT_REQUESTING_CONNECTION;
     CLIENT->serverAddress = serverAddress;
     CLIENT->lastPacketRecieveTime = CLIENT->time;
+    task_spawn(clientHandshakeTask, CLIENT);
 }
 
 void clientTimeout(client * CLIENT)
@@ -51,6 +54,55 @@ void clientTimeout(client * CLIENT)
     LOG_CLIENT("Connection timed out");
 }
 
+typedef struct {
+    client * CLIENT;
+    clientState state;
+    double until;
+} clientWait;
+
+bool clientStateChangedOrTimeReached(void * data)
+{
+    clientWait * wait = (clientWait*)data;
+    return wait->CLIENT->state != wait->state || wait->CLIENT->time >= wait->until;
+}
+
+// Handshake with the server as a task (oogabooga/task.c), started by clientConnect().
+// Keeps resending the current handshake packet until the server answers and clientProcessPacket() moves the state on.
+void clientHandshakeTask(void * data)
+{
+    client * CLIENT = (client*)data;
+    while (CLIENT->state == CLIENT_REQUESTING_CONNECTION || CLIENT->state == CLIENT_SENDING_CHALLENGE_RESPONSE)
+    {
+        if ((CLIENT->time - CLIENT->lastPacketRecieveTime) > 5.0)
+        {
+            clientTimeout(CLIENT);
+            return;
+        }
+
+        if (CLIENT->time - CLIENT->lastPacketSendTime >= 0.1)
+        {
+            CLIENT->lastPacketSendTime = CLIENT->time;
+            packet packet;
+            if (CLIENT->state == CLIENT_REQUESTING_CONNECTION)
+            {
+                printf("CLIENT: Sending Request Packet to Server.\n");
+                packet = createConnectionRequestPacket(ProtocolID, CLIENT->clientSalt);
+            }
+            else
+            {
+                printf("CLIENT: Sending Challenge Response Packet to Server.\n");
+                packet = createChallengeResponsePacket(ProtocolID, CLIENT->clientSalt ^ CLIENT->serverSalt);
+            }
+            socketSend(CLIENT->clientSocket, packet.data, packet.size, CLIENT->serverAddress);
+            dealloc(get_heap_allocator(), packet.data);
+        }
+
+        // Wake up to resend, or as soon as a packet moves the handshake on.
+        clientWait wait = { CLIENT, CLIENT->state, CLIENT->lastPacketSendTime + 0.1 };
+        task_await_condition(clientStateChangedOrTimeReached, &wait);
+    }
+}
+
 void clientProcessPacket(client * CLIENT, address from, void * payload, unsigned int size)
 {
     PacketType type = *((u8*)payload);
@@ -163,51 +215,13 @@ void clientReceive(client * CLIENT)
 
 }
 
+// Call before task_update() each frame, the handshake task runs on the time and packets from here.
 void clientUpdate(client * CLIENT, double currentTime)
 {
     CLIENT->time = currentTime; 
     clientReceive(CLIENT);
     switch (CLIENT->state)
     {
-        case CLIENT_REQUESTING_CONNECTION:
-            // Check if time since last packet is greater than connection request resend rate.
-            if ((CLIENT->time - CLIENT->lastPacketRecieveTime) > 5.0)
-            {
-               clientTimeout(CLIENT); 
-            }
-
-            // Keep sending request packets.
-            if (CLIENT->time - CLIENT->lastPacketSendTime >= 0.1)
-            {
-                CLIENT->lastPacketSendTime = CLIENT->time;
-                packet packet = createConnectionRequestPacket(ProtocolID, CLIENT->clientSalt);
-
-                printf("CLIENT: Sending Request Packet to Server.\n");
-
-                socketSend(CLIENT->clientSocket, packet.data, packet.size, CLIENT->serverAddress);
-                dealloc(get_heap_allocator(), packet.data);
-            }
-            break;
-        case CLIENT_SENDING_CHALLENGE_RESPONSE:
-            if ((CLIENT->time - CLIENT->lastPacketRecieveTime) > 5.0)
-            {
-               clientTimeout(CLIENT); 
-            }
-
-            if (CLIENT->time - CLIENT->lastPacketSendTime >= 0.1)
-            {
-                // send packet again!
-                CLIENT->lastPacketSendTime = CLIENT->time;
-                packet response = createChallengeResponsePacket(ProtocolID, CLIENT->clientSalt ^ CLIENT->serverSalt);
-
-                printf("CLIENT: Sending Challenge Response Packet to Server.\n");
-
-                socketSend(CLIENT->clientSocket, response.data, response.size, CLIENT->serverAddress);
-                dealloc(get_heap_allocator(), response.data);
-            }
-            break;
-        case CLIENT_DISCONNECTED:
-            break;
         case CLIENT_CONNECTED:
             if ((CLIENT->time - CLIENT->lastPacketRecieveTime) > 5.0)
             {
@@ -33,12 +33,57 @@ bool is_action_just_pressed(Action action) {
 Gfx_Image * playerImages[4];
 Gfx_Font * font;
 
-typedef struct {
-    int id;
-    char name[32];
-    Vector2 position;
-    bool connected;
-} Player;
+// Players live in entity storage (oogabooga/entity_storage.c), one column per field.
+Entity_Storage world;
+Component_Id positionComponent; // Vector2
+Component_Id playerComponent;   // int imageId, const char * name
+
+void registerComponents()
+{
+    entity_storage_init(&world, get_heap_allocator());
+
+    u64 positionColumns[] = { sizeof(Vector2) };
+    positionComponent = entity_storage_register_component(&world, 1, positionColumns);
+
+    u64 playerColumns[] = { sizeof(int), sizeof(const char *) };
+    playerComponent = entity_storage_register_component(&world, 2, playerColumns);
+}
+
+Entity_Id createPlayer(int imageId, const char * name)
+{
+    Entity_Id player = entity_create(&world);
+    entity_add_component(&world, player, positionComponent);
+    entity_add_component(&world, player, playerComponent);
+    *(int*)entity_get_field(&world, player, playerComponent, 0) = imageId;
+    *(const char **)entity_get_field(&world, player, playerComponent, 1) = name;
+    return player;
+}
+
+void setPosition(Entity_Id entity, Vector2 position)
+{
+    *(Vector2*)entity_get_field(&world, entity, positionComponent, 0) = position;
+}
+
+bool assetsLoaded = false;
+
+// Runs as a task (oogabooga/task.c), the files are read on the job system while the game keeps running.
+void loadAssetsTask(void * data)
+{
+    playerImages[0] = task_load_image_from_disk(fixed_string("res/player.png"), get_heap_allocator());
+    playerImages[1] = task_load_image_from_disk(fixed_string("res/glimbo.png"), get_heap_allocator());
+    playerImages[2] = task_load_image_from_disk(fixed_string("res/pear.jpg"), get_heap_allocator());
+    playerImages[3] = task_load_image_from_disk(fixed_string("res/cat.jpg"), get_heap_allocator());
+
+    assert(playerImages[0]);
+    assert(playerImages[1]);
+    assert(playerImages[2]);
+    assert(playerImages[3]);
+
+	font = task_load_font_from_disk(STR("C:/windows/fonts/arial.ttf"), get_heap_allocator());
+	assert(font, "Failed loading arial.ttf");
+
+    assetsLoaded = true;
+}
 
 void drawPlayer(int ID,const char * name, Vector2 position)
 {
@@ -46,6 +91,18 @@ void drawPlayer(int ID,const char * name, Vector2 position)
     draw_text(font, STR(name), 32, v2(position.x, position.y + 128), v2(1, 1), COLOR_BLACK);
 }
 
+void drawPlayers()
+{
+    u64 count = components_align(&world, playerComponent, positionComponent);
+    int * imageIds = (int*)component_get_column(&world, playerComponent, 0);
+    const char ** names = (const char **)component_get_column(&world, playerComponent, 1);
+    Vector2 * positions = (Vector2*)component_get_column(&world, positionComponent, 0);
+    for (u64 i = 0; i < count; i++)
+    {
+        drawPlayer(imageIds[i], names[i], positions[i]);
+    }
+}
+
 int entry(int argc, char **argv)
 {
 
@@ -96,20 +153,16 @@ int entry(int argc, char **argv)
     key_binds[ACTION_GREEN].codes[0] = 'G';
 	key_binds[ACTION_BLUE].codes[0]  = 'B';
 
-    playerImages[0] = load_image_from_disk(fixed_string("res/player.png"), get_heap_allocator());
-    playerImages[1] = load_image_from_disk(fixed_string("res/glimbo.png"), get_heap_allocator());
-    playerImages[2] = load_image_from_disk(fixed_string("res/pear.jpg"), get_heap_allocator());
-    playerImages[3] = load_image_from_disk(fixed_string("res/cat.jpg"), get_heap_allocator());
+    task_spawn(loadAssetsTask, 0);
 
-    assert(playerImages[0]);
-    assert(playerImages[1]);
-    assert(playerImages[2]);
-    assert(playerImages[3]);
+    registerComponents();
+    Entity_Id players[4];
+    players[0] = createPlayer(0, "rordo");
+    players[1] = createPlayer(1, "dylan");
+    players[2] = createPlayer(2, "flo");
+    players[3] = createPlayer(3, "gabi");
     float64 currentTime = os_get_elapsed_seconds();
 
-	font = load_font_from_disk(STR("C:/windows/fonts/arial.ttf"), get_heap_allocator());
-	assert(font, "Failed loading arial.ttf");
-	
 	const u32 font_height = 48;
 
     while (!window.should_close) {
@@ -122,6 +175,7 @@ int entry(int argc, char **argv)
 
         clientUpdate(&CLIENT, now);
         serverUpdate(&SERVER, now);
+        task_update();
 
         if (CLIENT.state == CLIENT_CONNECTED)
         {
@@ -133,19 +187,25 @@ int entry(int argc, char **argv)
             // Poll for new packets.
         }
 
+        setPosition(players[0], v2(sin(now)*1000*0.4-60, -60));
+        setPosition(players[1], v2(cos(now)*1000*0.4-60, -60));
+        setPosition(players[2], v2(sin(now)*-1000*0.4-60, -60));
+        setPosition(players[3], v2(cos(now)*-1000*0.4-60, -60));
+
         Matrix4 rect_xform = m4_scalar(1.0);
 		rect_xform         = m4_rotate_z(rect_xform, (f32)now);
 		rect_xform         = m4_translate(rect_xform, v3(-125, -125, 0));
 		draw_rect_xform(rect_xform, v2(250, 250), COLOR_GREEN);
-        draw_text(font, STR("I am text"), font_height, v2(-75, 0), v2(1, 1), COLOR_BLACK);
-		drawPlayer(0,"rordo", v2(sin(now)*1000*0.4-60, -60));
-		drawPlayer(1,"dylan", v2(cos(now)*1000*0.4-60, -60));
-		drawPlayer(2,"flo", v2(sin(now)*-1000*0.4-60, -60));
-		drawPlayer(3,"gabi", v2(cos(now)*-1000*0.4-60, -60));
+        if (assetsLoaded)
+        {
+            draw_text(font, STR("I am text"), font_height, v2(-75, 0), v2(1, 1), COLOR_BLACK);
+            drawPlayers();
+        }
 		os_update(); 
 		gfx_update();
 	}
 
+    entity_storage_deinit(&world);
     networkingShutdown();
 	return 0;
 }
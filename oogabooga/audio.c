@@ -133,6 +133,11 @@ typedef struct Wav_Stream {
 	Wav_Subformat_Guid sub_format;
 } Wav_Stream;
 
+typedef struct Audio_Source_Lock {
+	Mutex mutex_for_destroy; // This should ONLY be used so a source isnt sampled on audio thread while it's being destroyed
+	volatile u64 ref_count; // The source itself and every player holding a copy of it
+} Audio_Source_Lock;
+
 typedef struct Audio_Source {
 
 	Audio_Source_Kind kind;
@@ -160,7 +165,9 @@ typedef struct Audio_Source {
 	// For memory source
 	void *pcm_frames;
 	
-	Mutex mutex_for_destroy; // This should ONLY be used so a source isnt sampled on audio thread while it's being destroyed
+	// Players keep copies of the source, so this lives on the heap where all copies
+	// share it. 0 until the source is opened.
+	Audio_Source_Lock *lock;
 	
 } Audio_Source;
 
@@ -599,6 +606,27 @@ audio_source_get_frames(Audio_Source *src, u64 first_frame_index,
 					             u64 number_of_frames, void *output_buffer);
 
 
+Audio_Source_Lock*
+audio_source_lock_create() {
+	Audio_Source_Lock *l = (Audio_Source_Lock*)alloc(get_heap_allocator(), sizeof(Audio_Source_Lock));
+	mutex_init(&l->mutex_for_destroy);
+	l->ref_count = 1;
+	return l;
+}
+void
+audio_source_lock_retain(Audio_Source_Lock *l) {
+	assert(l, "Audio source was not opened");
+	atomic_add_64(&l->ref_count, 1);
+}
+// Freed when the source is destroyed and no player holds it anymore
+void
+audio_source_lock_release(Audio_Source_Lock *l) {
+	if (atomic_sub_64(&l->ref_count, 1) == 1) {
+		mutex_destroy(&l->mutex_for_destroy);
+		dealloc(get_heap_allocator(), l);
+	}
+}
+
 bool
 audio_open_source_stream_format(Audio_Source *src, string path, Audio_Format format, 
 							    Allocator allocator) {
@@ -606,8 +634,6 @@ audio_open_source_stream_format(Audio_Source *src, string path, Audio_Format for
 	src->uid = next_audio_source_uid;
 	next_audio_source_uid += 1;
 	
-	mutex_init(&src->mutex_for_destroy);
-	
 	src->allocator = allocator;
 	src->kind = AUDIO_SOURCE_FILE_STREAM;
 	
@@ -647,6 +673,8 @@ audio_open_source_stream_format(Audio_Source *src, string path, Audio_Format for
 		return false;
 	}
 	
+	src->lock = audio_source_lock_create();
+	
 	return true;
 }
 bool
@@ -664,8 +692,6 @@ audio_open_source_load_format(Audio_Source *src, string path, Audio_Format forma
 	src->uid = next_audio_source_uid;
 	next_audio_source_uid += 1;
 	
-	mutex_init(&src->mutex_for_destroy);
-	
 	src->allocator = allocator;
 	src->kind = AUDIO_SOURCE_MEMORY;
 	src->format = format;
@@ -724,6 +750,8 @@ audio_open_source_load_format(Audio_Source *src, string path, Audio_Format forma
 		return false;
 	}
 	
+	src->lock = audio_source_lock_create();
+	
 	return true;
 }
 bool
@@ -737,7 +765,9 @@ audio_open_source_load(Audio_Source *src, string path, Allocator allocator) {
 void 
 audio_source_destroy(Audio_Source *src) {
 
-	mutex_acquire_or_wait(&src->mutex_for_destroy);
+	assert(src->lock, "Audio source was not opened or was already destroyed");
+	Audio_Source_Lock *lock = src->lock;
+	mutex_acquire_or_wait(&lock->mutex_for_destroy);
 
 	switch (src->kind) {
 		case AUDIO_SOURCE_FILE_STREAM: {
@@ -762,7 +792,9 @@ audio_source_destroy(Audio_Source *src) {
 		}
 	}
 	
-	mutex_release(&src->mutex_for_destroy);
+	src->lock = 0;
+	mutex_release(&lock->mutex_for_destroy);
+	audio_source_lock_release(lock);
 }
 
 int
@@ -1237,57 +1269,53 @@ typedef struct Audio_Player {
 	
 } Audio_Player;
 #define AUDIO_PLAYERS_PER_BLOCK 128
-typedef struct Audio_Player_Block {
-	Audio_Player players[AUDIO_PLAYERS_PER_BLOCK]; // Players need to be persistent in memory
-	
-	struct Audio_Player_Block *next;
-} Audio_Player_Block;
 
+// Players are acquired on the calling thread and released on the audio thread, so the pool
+// is behind a lock. The audio thread walks player slots by index without it, which is fine
+// because pool chunks never move.
 // #Global
-ogb_instance Audio_Player_Block audio_player_block;
+ogb_instance Object_Pool audio_player_pool;
+ogb_instance Spinlock audio_player_pool_lock;
 
 #if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
-Audio_Player_Block audio_player_block = {0};
+Object_Pool audio_player_pool = {0};
+Spinlock audio_player_pool_lock = {0};
 #endif
 
 Audio_Player *
 audio_player_get_one() {
 
-	Audio_Player_Block *block = &audio_player_block;
-	Audio_Player_Block *last = 0;
+	spinlock_acquire_or_wait(&audio_player_pool_lock);
 	
-	while (block) {
-		
-		for (u64 i = 0; i < AUDIO_PLAYERS_PER_BLOCK; i++) {
-			if (!block->players[i].allocated) {
-			
-				memset(&block->players[i], 0, sizeof(block->players[i]));
-				block->players[i].allocated = true;
-				block->players[i].config.volume = 1.0;
-				block->players[i].config.playback_speed = 1.0;
-				
-				return &block->players[i];
-			}
-		}
-		
-		last = block;
-		block = block->next;
+	if (!audio_player_pool.item_size) {
+		object_pool_init(&audio_player_pool, sizeof(Audio_Player), AUDIO_PLAYERS_PER_BLOCK, get_heap_allocator());
 	}
 	
-	// No free player found, make another block
-	// #Volatile can't assign to last->next before this is zero initialized
-	Audio_Player_Block *new_block = alloc(get_heap_allocator(), sizeof(Audio_Player_Block));
+	Audio_Player *p = (Audio_Player*)object_pool_acquire(&audio_player_pool, 0);
 	
-#if !DO_ZERO_INITIALIATION
-	memset(new_block, 0, sizeof(*new_block));
-#endif
-
-	last->next = new_block;
+	spinlock_release(&audio_player_pool_lock);
+	
+	p->config.volume = 1.0;
+	p->config.playback_speed = 1.0;
+	
+	// Must be last, this is what the audio thread looks at
+	MEMORY_BARRIER;
+	p->allocated = true;
+	
+	return p;
+}
 
-	new_block->players[0].allocated = true;
-	new_block->players[0].config.volume = 1.0;
-	block->players[0].config.playback_speed = 1.0;
-	return &new_block->players[0];
+// Called on audio thread
+void
+audio_player_return_to_pool(Audio_Player *p) {
+	p->allocated = false;
+	
+	if (p->has_source) audio_source_lock_release(p->source.lock);
+	
+	spinlock_acquire_or_wait(&audio_player_pool_lock);
+	Object_Handle h = object_pool_get_handle(&audio_player_pool, p);
+	object_pool_release(&audio_player_pool, h);
+	spinlock_release(&audio_player_pool_lock);
 }
 
 void 
@@ -1387,19 +1415,28 @@ audio_player_get_current_progression_factor(Audio_Player *p) {
 void 
 audio_player_set_source(Audio_Player *p, Audio_Source src) {
 	
+	audio_source_lock_retain(src.lock);
+	
 	spinlock_acquire_or_wait(&p->sample_lock);
 
+	Audio_Source_Lock *old_lock = p->has_source ? p->source.lock : 0;
 	p->source = src;
 	p->has_source = true;
 	
 	p->frame_index = 0;
 	
 	spinlock_release(&p->sample_lock);
+	
+	if (old_lock) audio_source_lock_release(old_lock);
 }
 void 
 audio_player_transition_to_source(Audio_Player *p, Audio_Source src, float64 transition_seconds) {
 	
+	audio_source_lock_retain(src.lock);
+	
 	spinlock_acquire_or_wait(&p->sample_lock);
+	
+	Audio_Source_Lock *old_lock = p->has_source ? p->source.lock : 0;
 
 	float64 full_duration 
 		= (float64)p->source.number_of_frames / (float64)p->source.format.sample_rate;
@@ -1427,17 +1464,22 @@ audio_player_transition_to_source(Audio_Player *p, Audio_Source src, float64 tra
 	p->frame_index = 0;
 	
 	spinlock_release(&p->sample_lock);
+	
+	if (old_lock) audio_source_lock_release(old_lock);
 }
 void 
 audio_player_clear_source(Audio_Player *p) {
 	spinlock_acquire_or_wait(&p->sample_lock);
 	assert(p->frame_index <= p->source.number_of_frames);
 	
+	Audio_Source_Lock *old_lock = p->has_source ? p->source.lock : 0;
 	p->has_source = false;
 	p->state = AUDIO_PLAYER_STATE_PAUSED;
 	p->source = ZERO(Audio_Source);
 	
 	spinlock_release(&p->sample_lock);
+	
+	if (old_lock) audio_source_lock_release(old_lock);
 }
 void
 audio_player_set_looping(Audio_Player *p, bool looping) {
@@ -1510,7 +1552,9 @@ DEPRECATED(play_one_audio_clip_at_position(string path, Vector3 pos), "Use play_
 			log_error("Could not load audio to play from %s", path);
 			return;
 		}
-		hash_table_add(&just_audio_clips, path, new_src);
+		// The table keeps the key by reference and path is often temporary
+		string key = string_copy(path, get_heap_allocator());
+		hash_table_add(&just_audio_clips, key, new_src);
 		play_one_audio_clip_source_at_position(new_src, pos);
 	}
 	
@@ -1532,7 +1576,9 @@ play_one_audio_clip_with_config(string path, Audio_Playback_Config config) {
 			log_error("Could not load audio to play from %s", path);
 			return;
 		}
-		hash_table_add(&just_audio_clips, path, new_src);
+		// The table keeps the key by reference and path is often temporary
+		string key = string_copy(path, get_heap_allocator());
+		hash_table_add(&just_audio_clips, key, new_src);
 		play_one_audio_clip_source_with_config(new_src, config);
 	}
 }
@@ -1771,8 +1817,6 @@ do_program_audio_sample(u64 number_of_output_frames, Audio_Format out_format,
     
 	memset(output, 0, output_size);
 	
-	Audio_Player_Block *block = &audio_player_block;
-	
 	if (!audio_source_start_time_records) {
 		growing_array_init_reserve((void**)&audio_source_start_time_records, sizeof(float64), next_audio_source_uid, get_heap_allocator());
 	}
@@ -1781,21 +1825,30 @@ do_program_audio_sample(u64 number_of_output_frames, Audio_Format out_format,
 		growing_array_resize((void**)&audio_source_start_time_records, next_audio_source_uid);
 	}
 	
-	while (block) {
+	// Read once, players acquired while we mix are picked up next time
+	u32 player_slot_count = audio_player_pool.slot_count;
+	MEMORY_BARRIER;
+	
+	u32 chunk_start = 0;
+	for (u32 chunk = 0; chunk_start < player_slot_count; chunk++) {
+		Audio_Player *players = (Audio_Player*)audio_player_pool.chunks[chunk];
+		u32 chunk_slot_count = (u32)min(object_pool_get_chunk_capacity(&audio_player_pool, chunk), player_slot_count - chunk_start);
 		
-		for (u64 i = 0; i < AUDIO_PLAYERS_PER_BLOCK; i++) {
-			Audio_Player *p = &block->players[i];
+		for (u32 i = 0; i < chunk_slot_count; i++) {
+			Audio_Player *p = &players[i];
+			if (!p->allocated) {
+				continue;
+			}
+			
 			if (p->release_when_done && (p->frame_index >= p->source.number_of_frames
 										  || !p->has_source)) {
-				p->allocated = false;
-			}
-			if (!p->allocated) {
+				audio_player_return_to_pool(p);
 				continue;
 			}
 			
 			if (p->marked_for_release) {
 				p->marked_for_release = false;
-				p->allocated = false;
+				audio_player_return_to_pool(p);
 				continue;
 			}
 			
@@ -1808,13 +1861,15 @@ do_program_audio_sample(u64 number_of_output_frames, Audio_Format out_format,
 			
 			if (p->frame_index >= p->source.number_of_frames && !p->looping) continue;
 			
+			if (!p->has_source) continue;
+			
 			spinlock_acquire_or_wait(&p->sample_lock);
 			
 			audio_prepare_intermediate_buffers();
 			
-			Audio_Source src = p->source;
+			mutex_acquire_or_wait(&p->source.lock->mutex_for_destroy);
 			
-			mutex_acquire_or_wait(&src.mutex_for_destroy);
+			Audio_Source src = p->source;
 
 			Audio_Format sample_format = src.format;
 			sample_format.sample_rate = sample_format.sample_rate*p->config.playback_speed;
@@ -2049,9 +2104,9 @@ do_program_audio_sample(u64 number_of_output_frames, Audio_Format out_format,
 			mix_frames(output, mix_buffer, number_of_output_frames, out_format);
 			
 			
-			mutex_release(&src.mutex_for_destroy);
+			mutex_release(&p->source.lock->mutex_for_destroy);
 		}
 		
-		block = block->next;
+		chunk_start += chunk_slot_count;
 	}
 }
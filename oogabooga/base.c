@@ -87,11 +87,16 @@ get_heap_allocator();
 ogb_instance Allocator
 get_temporary_allocator();
 
+typedef struct Temporary_Storage Temporary_Storage;
+
 typedef struct Context {
 	void *logger; // void(*Logger_Proc)(Log_Level level, string fmt, ...)
 	
 	u64 thread_id;
 	
+	// Each thread gets its own, set by temporary_storage_init()
+	Temporary_Storage *temporary_storage;
+	
 	CONTEXT_EXTRA extra;
 } Context;
 
@@ -105,6 +110,13 @@ typedef struct Context {
 ogb_instance 
 Context get_context();
 
+#if ENABLE_HEAP_PROFILING
+	// These need to be real calls so they know where they were called from
+	#define ALLOC_PROC NO_INLINE
+#else
+	#define ALLOC_PROC
+#endif
+
 ogb_instance void* 
 alloc(Allocator allocator, u64 size);
 
@@ -114,6 +126,11 @@ alloc_uninitialized(Allocator allocator, u64 size);
 ogb_instance void 
 dealloc(Allocator allocator, void *p);
 
+// Resizes p, in place if the allocator can, keeping the contents up to the smaller size.
+// p may be 0. The grown part is NOT zero initialized.
+ogb_instance void* 
+reallocate(Allocator allocator, void *p, u64 size);
+
 ogb_instance void 
 push_context(Context c);
 
@@ -129,20 +146,38 @@ thread_local Context context;
 thread_local Context context_stack[CONTEXT_STACK_MAX];
 thread_local u64 num_contexts = 0;
 
-void* 
+#if ENABLE_HEAP_PROFILING
+// Where the alloc() being served on this thread was called from, for the heap profiler
+thread_local void *alloc_call_site = 0;
+#endif
+
+ALLOC_PROC void* 
 alloc(Allocator allocator, u64 size) {
 	assert(size > 0, "You requested an allocation of zero bytes. I'm not sure what you want with that.");
+#if ENABLE_HEAP_PROFILING
+	alloc_call_site = get_return_address();
+#endif
 	void *p = allocator.proc(size, 0, ALLOCATOR_ALLOCATE, allocator.data);
+#if ENABLE_HEAP_PROFILING
+	alloc_call_site = 0;
+#endif
 #if DO_ZERO_INITIALIZATION
 	memset(p, 0, size);
 #endif
 	return p;
 }
 
-void* 
+ALLOC_PROC void* 
 alloc_uninitialized(Allocator allocator, u64 size) {
 	assert(size > 0, "You requested an allocation of zero bytes. I'm not sure what you want with that.");
+#if ENABLE_HEAP_PROFILING
+	alloc_call_site = get_return_address();
+	void *p = allocator.proc(size, 0, ALLOCATOR_ALLOCATE, allocator.data);
+	alloc_call_site = 0;
+	return p;
+#else
 	return allocator.proc(size, 0, ALLOCATOR_ALLOCATE, allocator.data);	
+#endif
 }
 
 void 
@@ -151,6 +186,19 @@ dealloc(Allocator allocator, void *p) {
 	allocator.proc(0, p, ALLOCATOR_DEALLOCATE, allocator.data);
 }
 
+ALLOC_PROC void* 
+reallocate(Allocator allocator, void *p, u64 size) {
+	assert(size > 0, "You requested a reallocation to zero bytes. Use dealloc instead.");
+#if ENABLE_HEAP_PROFILING
+	alloc_call_site = get_return_address();
+	void *result = allocator.proc(size, p, ALLOCATOR_REALLOCATE, allocator.data);
+	alloc_call_site = 0;
+	return result;
+#else
+	return allocator.proc(size, p, ALLOCATOR_REALLOCATE, allocator.data);
+#endif
+}
+
 void 
 push_context(Context c) {
 	assert(num_contexts < CONTEXT_STACK_MAX, "Context stack overflow");
@@ -0,0 +1,169 @@
+
+/*
+
+	Array of items which never move.
+
+	Items live in chunks which double in size, so appending never copies anything and
+	pointers to items stay valid until the item is removed or the array is cleared. You
+	can keep Thing* across frames instead of looking things up by index every frame.
+	Index access is a bit scan to find the chunk and then an offset into it, and each
+	chunk is contiguous for iteration.
+
+	Not thread safe.
+
+	Full API:
+
+		void  chunked_array_init(Chunked_Array *array, u64 item_size, u64 first_chunk_count, Allocator allocator);
+		void  chunked_array_deinit(Chunked_Array *array);
+
+		// Returned item is zeroed
+		void *chunked_array_add_empty(Chunked_Array *array);
+		// item is copied
+		void *chunked_array_add(Chunked_Array *array, void *item);
+		void  chunked_array_reserve(Chunked_Array *array, u64 count_to_reserve);
+
+		void *chunked_array_get(Chunked_Array *array, u64 index);
+
+		void  chunked_array_pop(Chunked_Array *array);
+		// Copies the last item into index, so pointers to the last item go stale
+		void  chunked_array_unordered_remove(Chunked_Array *array, u64 index);
+		// Keeps the chunks for reuse
+		void  chunked_array_clear(Chunked_Array *array);
+
+		// Chunk iteration. count is the number of items in use in that chunk.
+		u64   chunked_array_get_chunk_count(Chunked_Array *array);
+		void *chunked_array_get_chunk(Chunked_Array *array, u64 chunk, u64 *count);
+
+	Usage:
+
+		Chunked_Array things;
+		chunked_array_init(&things, sizeof(Thing), 64, get_heap_allocator());
+
+		Thing *thing = chunked_array_add_empty(&things);
+		// thing stays valid no matter how much more is added
+
+		for (u64 c = 0; c < chunked_array_get_chunk_count(&things); c += 1) {
+			u64 count;
+			Thing *chunk = chunked_array_get_chunk(&things, c, &count);
+			for (u64 i = 0; i < count; i += 1) {
+				update_thing(&chunk[i]);
+			}
+		}
+
+		chunked_array_deinit(&things);
+*/
+
+// Chunk n holds first_chunk_count << n items
+#define CHUNKED_ARRAY_MAX_CHUNKS 48
+
+typedef struct Chunked_Array {
+	u64 item_size;
+	u64 first_chunk_count; // Power of two
+	u64 first_chunk_shift;
+	Allocator allocator;
+
+	u8 *chunks[CHUNKED_ARRAY_MAX_CHUNKS];
+	u64 chunk_count; // Allocated chunks
+	u64 count;
+} Chunked_Array;
+
+void
+chunked_array_init(Chunked_Array *array, u64 item_size, u64 first_chunk_count, Allocator allocator) {
+	assert(item_size > 0, "Chunked array item size must be more than 0");
+	assert(first_chunk_count > 0, "Chunked array chunk count must be more than 0");
+
+	*array = ZERO(Chunked_Array);
+	array->item_size = item_size;
+	array->first_chunk_count = get_next_power_of_two(first_chunk_count);
+	array->first_chunk_shift = bit_scan_forward_64(array->first_chunk_count);
+	array->allocator = allocator;
+}
+void
+chunked_array_deinit(Chunked_Array *array) {
+	for (u64 i = 0; i < array->chunk_count; i += 1) {
+		dealloc(array->allocator, array->chunks[i]);
+	}
+	*array = ZERO(Chunked_Array);
+}
+
+inline u64
+chunked_array_get_chunk_capacity(Chunked_Array *array, u64 chunk) {
+	return array->first_chunk_count << chunk;
+}
+inline u64
+chunked_array_get_chunk_start_index(Chunked_Array *array, u64 chunk) {
+	return array->first_chunk_count*((1ULL << chunk) - 1);
+}
+
+void
+chunked_array_add_chunk(Chunked_Array *array) {
+	assert(array->chunk_count < CHUNKED_ARRAY_MAX_CHUNKS, "Chunked array is full");
+	u64 capacity = chunked_array_get_chunk_capacity(array, array->chunk_count);
+	array->chunks[array->chunk_count] = (u8*)alloc(array->allocator, capacity*array->item_size);
+	array->chunk_count += 1;
+}
+
+void
+chunked_array_reserve(Chunked_Array *array, u64 count_to_reserve) {
+	assert(array->item_size, "Chunked array was not initialized");
+	while (chunked_array_get_chunk_start_index(array, array->chunk_count) < count_to_reserve) {
+		chunked_array_add_chunk(array);
+	}
+}
+
+// Chunk n starts at first_chunk_count*(2^n - 1)
+inline void*
+chunked_array_get(Chunked_Array *array, u64 index) {
+	assert(index < array->count, "Chunked array index out of range");
+	u64 chunk = bit_scan_reverse_64((index >> array->first_chunk_shift) + 1);
+	u64 offset = index - chunked_array_get_chunk_start_index(array, chunk);
+	return array->chunks[chunk] + offset*array->item_size;
+}
+
+void*
+chunked_array_add_empty(Chunked_Array *array) {
+	chunked_array_reserve(array, array->count+1);
+	array->count += 1;
+	void *item = chunked_array_get(array, array->count-1);
+	memset(item, 0, array->item_size);
+	return item;
+}
+void*
+chunked_array_add(Chunked_Array *array, void *item) {
+	chunked_array_reserve(array, array->count+1);
+	array->count += 1;
+	void *p = chunked_array_get(array, array->count-1);
+	memcpy(p, item, array->item_size);
+	return p;
+}
+
+void
+chunked_array_pop(Chunked_Array *array) {
+	assert(array->count > 0, "No items to pop in chunked array");
+	array->count -= 1;
+}
+void
+chunked_array_unordered_remove(Chunked_Array *array, u64 index) {
+	assert(index < array->count, "Chunked array index out of range");
+	if (index != array->count-1) {
+		memcpy(chunked_array_get(array, index), chunked_array_get(array, array->count-1), array->item_size);
+	}
+	array->count -= 1;
+}
+void
+chunked_array_clear(Chunked_Array *array) {
+	array->count = 0;
+}
+
+u64
+chunked_array_get_chunk_count(Chunked_Array *array) {
+	if (!array->count) return 0;
+	return bit_scan_reverse_64(((array->count-1) >> array->first_chunk_shift) + 1) + 1;
+}
+void*
+chunked_array_get_chunk(Chunked_Array *array, u64 chunk, u64 *count) {
+	assert(chunk < chunked_array_get_chunk_count(array), "Chunked array chunk out of range");
+	u64 start = chunked_array_get_chunk_start_index(array, chunk);
+	*count = min(chunked_array_get_chunk_capacity(array, chunk), array->count - start);
+	return array->chunks[chunk];
+}
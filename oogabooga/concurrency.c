@@ -10,10 +10,78 @@ inline bool compare_and_swap_32(volatile uint32_t *a, uint32_t b, uint32_t old);
 inline bool compare_and_swap_64(volatile uint64_t *a, uint64_t b, uint64_t old);
 inline bool compare_and_swap_bool(volatile bool *a, bool b, bool old);
 
+// Atomic read-modify-writes. add & exchange return the old value and are always full
+// barriers (they're locked instructions on x86).
+inline uint32_t atomic_add_32(volatile uint32_t *a, uint32_t x);
+inline uint64_t atomic_add_64(volatile uint64_t *a, uint64_t x);
+inline uint32_t atomic_exchange_32(volatile uint32_t *a, uint32_t x);
+inline uint64_t atomic_exchange_64(volatile uint64_t *a, uint64_t x);
+inline uint32_t atomic_sub_32(volatile uint32_t *a, uint32_t x) { return atomic_add_32(a, 0u - x); }
+inline uint64_t atomic_sub_64(volatile uint64_t *a, uint64_t x) { return atomic_add_64(a, 0ull - x); }
+
+// Atomic loads & stores.
+// No suffix is sequentially consistent, the safe default.
+// _acquire loads: nothing after the load happens before it. Pair with a _release store.
+// _release stores: nothing before the store happens after it. Publish data with these.
+// _relaxed: only atomic, no ordering. For counters & flags nothing else depends on.
+inline uint32_t atomic_load_32(volatile uint32_t *a);
+inline uint64_t atomic_load_64(volatile uint64_t *a);
+inline uint32_t atomic_load_acquire_32(volatile uint32_t *a);
+inline uint64_t atomic_load_acquire_64(volatile uint64_t *a);
+inline uint32_t atomic_load_relaxed_32(volatile uint32_t *a);
+inline uint64_t atomic_load_relaxed_64(volatile uint64_t *a);
+inline void atomic_store_32(volatile uint32_t *a, uint32_t x);
+inline void atomic_store_64(volatile uint64_t *a, uint64_t x);
+inline void atomic_store_release_32(volatile uint32_t *a, uint32_t x);
+inline void atomic_store_release_64(volatile uint64_t *a, uint64_t x);
+inline void atomic_store_relaxed_32(volatile uint32_t *a, uint32_t x);
+inline void atomic_store_relaxed_64(volatile uint64_t *a, uint64_t x);
+// Sequentially consistent fence. Nothing before it, stores included, happens after it.
+inline void atomic_thread_fence();
+
+///
+// Cache line padding
+// When threads write to different variables on the same 64 byte cache line, the line
+// bounces between their cores on every write even though they never touch the same data
+// (false sharing). Per-thread data that is written a lot should own its cache lines:
+//
+//     // Each item starts on its own cache line and is padded to a multiple of it
+//     typedef struct Worker_State {
+//         alignat(CACHE_LINE_SIZE) u64 processed_count;
+//         ...
+//     } Worker_State;
+//
+//     Worker_State *states = alloc_cache_line_aligned(get_heap_allocator(), thread_count*sizeof(Worker_State));
+//     ... thread i only writes states[i] ...
+//     dealloc_cache_line_aligned(get_heap_allocator(), states);
+//
+// alignat on the first member makes the struct size a multiple of the cache line, but
+// heap memory is only 16 byte aligned so arrays of them need alloc_cache_line_aligned().
+// Better yet, accumulate in locals and write the shared slot once at the end.
+// For single hot values, like a counter every thread adds to, use the Padded_ types.
+#define CACHE_LINE_SIZE 64
+
+#define DEFINE_CACHE_LINE_PADDED(Name, Type) \
+	typedef struct Name { \
+		alignat(CACHE_LINE_SIZE) Type value; \
+	} Name;
+
+DEFINE_CACHE_LINE_PADDED(Padded_U32, volatile u32)
+DEFINE_CACHE_LINE_PADDED(Padded_U64, volatile u64)
+
+void* ogb_instance
+alloc_cache_line_aligned(Allocator allocator, u64 size);
+
+void ogb_instance
+dealloc_cache_line_aligned(Allocator allocator, void *p);
+
 ///
 // Spinlock "primitive"
 // Like a mutex but it eats up the entire core while waiting.
-// Beneficial if contention is low or sync speed is important
+// Beneficial if contention is low or sync speed is important.
+// Waiting threads pause between looks at the lock, doubling the pause each time up to
+// SPIN_BACKOFF_MAX_PAUSES, so they don't hog the bus or the sibling hyperthread.
+#define SPIN_BACKOFF_MAX_PAUSES 64
 typedef struct Spinlock {
 	volatile bool locked;
 } Spinlock;
@@ -33,18 +101,22 @@ spinlock_release(Spinlock* l);
 
 
 ///
-// High-level mutex primitive (short spinlock then OS mutex lock)
-// Just spins for a few (configurable) microseconds with a spinlock,
-// and if acquiring fails it falls back to a OS mutex.
+// High-level mutex primitive
+// Taking a free mutex is one compare_and_swap and releasing it with nobody waiting is
+// another, so the uncontended case never calls into the OS.
+// When it's taken, it spins with backoff for a few (configurable) microseconds and then
+// parks the thread in the OS until the owner releases it.
 #define MUTEX_DEFAULT_SPIN_TIME_MICROSECONDS 100
 typedef struct Mutex {
-	Spinlock spinlock;
+	volatile u32 state; // MUTEX_STATE_*
 	f64 spin_time_microseconds;
-	Mutex_Handle os_handle;
-	volatile bool spinlock_acquired;
 	volatile u64 acquiring_thread;
 } Mutex;
 
+#define MUTEX_STATE_UNLOCKED 0
+#define MUTEX_STATE_LOCKED 1
+#define MUTEX_STATE_LOCKED_WITH_WAITERS 2 // Release needs to wake someone
+
 void ogb_instance
 mutex_init(Mutex *m);
 
@@ -58,32 +130,261 @@ void ogb_instance
 mutex_release(Mutex *m);
 
 
+///
+// More sync primitives
+// Like Mutex, these spin for a little while (SYNC_SPIN_ROUNDS rounds of backoff) and then
+// park the thread with os_wait_on_address() until someone wakes it.
+#define SYNC_SPIN_ROUNDS 8
+
+// Any number of readers or one writer. A waiting writer keeps new readers out so
+// writers don't starve on tables that are read all the time.
+typedef struct Rw_Lock {
+	volatile u32 state; // Reader count | RW_LOCK_* bits
+} Rw_Lock;
+
+#define RW_LOCK_WRITER         (1u << 31)
+#define RW_LOCK_WRITER_WAITING (1u << 30)
+#define RW_LOCK_PARKED         (1u << 29) // Someone is sleeping on state
+#define RW_LOCK_READER_MASK    (RW_LOCK_PARKED-1)
+
+void ogb_instance
+rw_lock_init(Rw_Lock *l);
+
+void ogb_instance
+rw_lock_acquire_read_or_wait(Rw_Lock *l);
+
+void ogb_instance
+rw_lock_release_read(Rw_Lock *l);
+
+void ogb_instance
+rw_lock_acquire_write_or_wait(Rw_Lock *l);
+
+void ogb_instance
+rw_lock_release_write(Rw_Lock *l);
+
+// Counting semaphore. wait takes one from count, waiting until there is one.
+typedef struct Semaphore {
+	volatile u32 count;
+	volatile u32 waiter_count;
+} Semaphore;
+
+void ogb_instance
+semaphore_init(Semaphore *s, u32 initial_count);
+
+void ogb_instance
+semaphore_wait(Semaphore *s);
+
+// Returns false instead of waiting
+bool ogb_instance
+semaphore_try_wait(Semaphore *s);
+
+void ogb_instance
+semaphore_signal(Semaphore *s, u32 count);
+
+// Waits until thread_count threads are waiting, then lets all of them go. Can be reused
+// right away, so the same barrier works every frame.
+typedef struct Barrier {
+	u32 thread_count;
+	volatile u32 arrived_count;
+	volatile u32 generation;
+} Barrier;
+
+void ogb_instance
+barrier_init(Barrier *b, u32 thread_count);
+
+// Returns true on exactly one of the threads, for work that should happen once per round
+bool ogb_instance
+barrier_wait(Barrier *b);
+
+// Auto-reset event. A signal lets exactly one wait through, now or when it comes, and
+// signaling an event that's already signaled does nothing.
+typedef struct Event {
+	volatile u32 signaled;
+	volatile u32 waiter_count;
+} Event;
+
+void ogb_instance
+event_init(Event *e, bool signaled);
+
+void ogb_instance
+event_wait(Event *e);
+
+void ogb_instance
+event_signal(Event *e);
+
+
+///
+// Ring buffers
+// Bounded lock-free queues of fixed size items, for handing things between threads.
+// Capacity is rounded up to a power of two. Push returns false when full and pop returns
+// false when empty, so the caller decides whether to spin, yield or drop.
+// The indices producers and consumers write live on separate cache lines so the two
+// sides don't fight over one line. The ring is cache line aligned, so put it in memory
+// from alloc_cache_line_aligned() when it's on the heap.
+
+// One producer thread & one consumer thread
+typedef struct Spsc_Ring {
+	u8 *data;
+	u64 item_size;
+	u64 mask;
+	Allocator allocator;
+	
+	// Written by producer
+	alignat(CACHE_LINE_SIZE) volatile u64 tail;
+	u64 cached_head; // Last head the producer saw, so it only reads head when it looks full
+	
+	// Written by consumer
+	alignat(CACHE_LINE_SIZE) volatile u64 head;
+	u64 cached_tail;
+} Spsc_Ring;
+
+void ogb_instance
+spsc_ring_init(Spsc_Ring *r, u64 item_size, u64 capacity, Allocator allocator);
+
+void ogb_instance
+spsc_ring_deinit(Spsc_Ring *r);
+
+// Producer only. item is copied.
+bool ogb_instance
+spsc_ring_push(Spsc_Ring *r, void *item);
+
+// Consumer only. Copies the item to out.
+bool ogb_instance
+spsc_ring_pop(Spsc_Ring *r, void *out);
+
+// Only exact when called from the producer or the consumer while the other side is idle
+u64 ogb_instance
+spsc_ring_count(Spsc_Ring *r);
+
+// Any number of producer & consumer threads.
+// Each slot has a sequence number which says whose turn it is on that slot, so producers
+// and consumers only contend on claiming an index, not on the items.
+typedef struct Mpmc_Ring {
+	u8 *cells; // u64 sequence followed by the item
+	u64 cell_size;
+	u64 item_size;
+	u64 mask;
+	Allocator allocator;
+	
+	alignat(CACHE_LINE_SIZE) volatile u64 tail;
+	
+	alignat(CACHE_LINE_SIZE) volatile u64 head;
+} Mpmc_Ring;
+
+void ogb_instance
+mpmc_ring_init(Mpmc_Ring *r, u64 item_size, u64 capacity, Allocator allocator);
+
+void ogb_instance
+mpmc_ring_deinit(Mpmc_Ring *r);
+
+bool ogb_instance
+mpmc_ring_push(Mpmc_Ring *r, void *item);
+
+bool ogb_instance
+mpmc_ring_pop(Mpmc_Ring *r, void *out);
+
+// Approximate if other threads are pushing or popping
+u64 ogb_instance
+mpmc_ring_count(Mpmc_Ring *r);
+
+
+///
+// Job system
+// A worker thread per logical processor (minus the thread which starts it), each with a
+// Chase-Lev deque: the owner pushes & pops jobs at the bottom and other workers steal from
+// the top when they run dry. Jobs pushed from threads outside of the pool go in a shared
+// queue which everyone takes from.
+// Waiting on a Job_Counter runs other jobs until the counter hits 0, so jobs can start
+// more jobs and wait for them (fork-join) without blocking a worker.
+// The job system starts itself on first use, or call job_system_init() to pick the number
+// of workers.
+// Workers reset their temporary storage after every job, so temp memory allocated in a job
+// is only valid until the job returns. Don't hand it back through the job data.
+typedef void (*Job_Proc)(void *data);
+typedef void (*Parallel_For_Proc)(u64 start, u64 end, void *data);
+
+// Number of jobs in flight. Zero it before use.
+typedef struct Job_Counter {
+	volatile u64 count;
+} Job_Counter;
+
+typedef struct Job {
+	Job_Proc proc;
+	Parallel_For_Proc range_proc; // Set for parallel_for() ranges instead of proc
+	void *data;
+	u64 start;
+	u64 end;
+	u64 grain;
+	Job_Counter *counter;
+} Job;
+
+// Must be a power of two. When a worker's deque is full, jobs go in the shared queue.
+#define JOB_DEQUE_CAPACITY 4096
+#define JOB_WORKER_TEMPORARY_STORAGE_SIZE (1024ULL*256ULL)
+
+// 0 for os_get_number_of_logical_processors()-1
+void ogb_instance
+job_system_init(u64 worker_count);
+
+void ogb_instance
+job_system_shutdown();
+
+u64 ogb_instance
+job_system_get_worker_count();
+
+// counter may be 0. It's incremented now and decremented when the job is done.
+void ogb_instance
+job_run(Job_Proc proc, void *data, Job_Counter *counter);
+
+// Runs other jobs while waiting
+void ogb_instance
+job_counter_wait(Job_Counter *counter);
+
+// Calls proc on ranges of [0, count), split down to at least grain items per range, and
+// returns when all of them are done. The calling thread works on ranges too.
+void ogb_instance
+parallel_for(u64 count, u64 grain, Parallel_For_Proc proc, void *data);
+
+// radix_sort_keys() (utility.c) split over the job system. Each pass, every block of keys
+// is counted and scattered on its own job. Small counts just call radix_sort_keys().
+#define PARALLEL_RADIX_SORT_MIN_BLOCK_SIZE (1024*16)
+#define PARALLEL_RADIX_SORT_MAX_BLOCKS 32
+void ogb_instance
+parallel_radix_sort_keys(u64 *keys, u64 *help_buffer, u64 count, u64 number_of_bits);
+
+
 #if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
 
 void spinlock_init(Spinlock *l) {
 	memset(l, 0, sizeof(*l));
 }
+inline void spin_backoff(u64 *pauses) {
+	for (u64 i = 0; i < *pauses; i += 1) _mm_pause();
+	if (*pauses < SPIN_BACKOFF_MAX_PAUSES) *pauses *= 2;
+}
 void spinlock_acquire_or_wait(Spinlock* l) {
+	u64 pauses = 1;
 	while (true) {
         bool expected = false;
         if (compare_and_swap_bool(&l->locked, true, expected)) {
             return;
         }
         while (l->locked) {
-            // spinny boi
+            spin_backoff(&pauses);
         }
     }
 }
 // Returns true on aquired, false if timeout seconds reached
 bool spinlock_acquire_or_wait_timeout(Spinlock* l, f64 timeout_seconds) {
     f64 start = os_get_elapsed_seconds();
+	u64 pauses = 1;
 	while (true) {
         bool expected = false;
         if (compare_and_swap_bool(&l->locked, true, expected)) {
             return true;
         }
         while (l->locked) {
-            // spinny boi
+            spin_backoff(&pauses);
             if ((os_get_elapsed_seconds()-start) >= timeout_seconds) return false;
         }
     }
@@ -97,24 +398,49 @@ void spinlock_release(Spinlock* l) {
 
 
 ///
-// High-level mutex primitive (short spinlock then OS mutex lock)
+// Cache line padding
+
+// The pointer to give back to dealloc is kept right before the aligned memory
+void *alloc_cache_line_aligned(Allocator allocator, u64 size) {
+	u8 *p = (u8*)alloc(allocator, size + CACHE_LINE_SIZE);
+	u8 *aligned = (u8*)align_next((u64)p + sizeof(void*), CACHE_LINE_SIZE);
+	((void**)aligned)[-1] = p;
+	return aligned;
+}
+void dealloc_cache_line_aligned(Allocator allocator, void *p) {
+	dealloc(allocator, ((void**)p)[-1]);
+}
+
+///
+// High-level mutex primitive
 
 void mutex_init(Mutex *m) {
-	spinlock_init(&m->spinlock);
+	m->state = MUTEX_STATE_UNLOCKED;
 	m->spin_time_microseconds = MUTEX_DEFAULT_SPIN_TIME_MICROSECONDS;
-	m->os_handle = os_make_mutex();
-	m->spinlock_acquired = false;
 	m->acquiring_thread = 0;
 }
 void mutex_destroy(Mutex *m) {
-	os_destroy_mutex(m->os_handle);
+	assert(m->state == MUTEX_STATE_UNLOCKED, "Destroyed a mutex which is acquired");
+}
+void mutex_acquire_contended(Mutex *m) {
+	f64 start = os_get_elapsed_seconds();
+	u64 pauses = 1;
+	while ((os_get_elapsed_seconds()-start)*1000000.0 < m->spin_time_microseconds) {
+		if (m->state == MUTEX_STATE_UNLOCKED && compare_and_swap_32(&m->state, MUTEX_STATE_LOCKED, MUTEX_STATE_UNLOCKED)) {
+			return;
+		}
+		spin_backoff(&pauses);
+	}
+	
+	// Taking it as LOCKED_WITH_WAITERS even if we're the last waiter only costs an extra wake
+	while (atomic_exchange_32(&m->state, MUTEX_STATE_LOCKED_WITH_WAITERS) != MUTEX_STATE_UNLOCKED) {
+		os_wait_on_address(&m->state, MUTEX_STATE_LOCKED_WITH_WAITERS);
+	}
 }
 void mutex_acquire_or_wait(Mutex *m) {
-	if (spinlock_acquire_or_wait_timeout(&m->spinlock, m->spin_time_microseconds / 1000000.0)) {
-        assert(!m->spinlock_acquired, "Internal sync error in Mutex");
-    	m->spinlock_acquired = true;
-    }
-    os_lock_mutex(m->os_handle);
+	if (!compare_and_swap_32(&m->state, MUTEX_STATE_LOCKED, MUTEX_STATE_UNLOCKED)) {
+		mutex_acquire_contended(m);
+	}
     
     assert(!m->acquiring_thread, "Internal sync error in Mutex: Multiple threads acquired");
     m->acquiring_thread = context.thread_id;
@@ -123,12 +449,732 @@ void mutex_release(Mutex *m) {
 	assert(m->acquiring_thread != 0, "Tried to release a mutex which is not acquired");
 	assert(m->acquiring_thread == context.thread_id, "Non-owning thread tried to release mutex");
 	m->acquiring_thread = 0;
-	bool was_spinlock_acquired = m->spinlock_acquired;
-	m->spinlock_acquired = false;
-	os_unlock_mutex(m->os_handle);
-	if (was_spinlock_acquired) {
-		spinlock_release(&m->spinlock);
+	
+	if (atomic_exchange_32(&m->state, MUTEX_STATE_UNLOCKED) == MUTEX_STATE_LOCKED_WITH_WAITERS) {
+		os_wake_one_on_address(&m->state);
+	}
+}
+
+///
+// More sync primitives
+
+void rw_lock_init(Rw_Lock *l) {
+	l->state = 0;
+}
+// Sets RW_LOCK_PARKED and sleeps while state stays the same. Returns right away if state
+// changed, so call it in a loop.
+void rw_lock_park(Rw_Lock *l, u32 state) {
+	if (!(state & RW_LOCK_PARKED)) {
+		if (!compare_and_swap_32(&l->state, state | RW_LOCK_PARKED, state)) return;
+		state |= RW_LOCK_PARKED;
+	}
+	os_wait_on_address(&l->state, state);
+}
+void rw_lock_acquire_read_or_wait(Rw_Lock *l) {
+	u64 pauses = 1;
+	u64 rounds = 0;
+	while (true) {
+		u32 state = l->state;
+		if (!(state & (RW_LOCK_WRITER | RW_LOCK_WRITER_WAITING))) {
+			assert((state & RW_LOCK_READER_MASK) != RW_LOCK_READER_MASK, "Too many readers in Rw_Lock");
+			if (compare_and_swap_32(&l->state, state + 1, state)) return;
+			continue;
+		}
+		if (rounds < SYNC_SPIN_ROUNDS) {
+			spin_backoff(&pauses);
+			rounds += 1;
+		} else {
+			rw_lock_park(l, state);
+		}
+	}
+}
+void rw_lock_release_read(Rw_Lock *l) {
+	while (true) {
+		u32 state = l->state;
+		assert(state & RW_LOCK_READER_MASK, "Released read on a Rw_Lock with no readers");
+		u32 new_state = state - 1;
+		bool last_reader = !(new_state & RW_LOCK_READER_MASK);
+		if (last_reader) new_state &= ~RW_LOCK_PARKED;
+		if (compare_and_swap_32(&l->state, new_state, state)) {
+			if (last_reader && (state & RW_LOCK_PARKED)) os_wake_all_on_address(&l->state);
+			return;
+		}
+	}
+}
+void rw_lock_acquire_write_or_wait(Rw_Lock *l) {
+	u64 pauses = 1;
+	u64 rounds = 0;
+	while (true) {
+		u32 state = l->state;
+		if (!(state & (RW_LOCK_WRITER | RW_LOCK_READER_MASK))) {
+			u32 new_state = (state | RW_LOCK_WRITER) & ~RW_LOCK_WRITER_WAITING;
+			if (compare_and_swap_32(&l->state, new_state, state)) return;
+			continue;
+		}
+		if (!(state & RW_LOCK_WRITER_WAITING)) {
+			compare_and_swap_32(&l->state, state | RW_LOCK_WRITER_WAITING, state);
+			continue;
+		}
+		if (rounds < SYNC_SPIN_ROUNDS) {
+			spin_backoff(&pauses);
+			rounds += 1;
+		} else {
+			rw_lock_park(l, state);
+		}
+	}
+}
+void rw_lock_release_write(Rw_Lock *l) {
+	while (true) {
+		u32 state = l->state;
+		assert(state & RW_LOCK_WRITER, "Released write on a Rw_Lock which is not write acquired");
+		// Other waiting writers set RW_LOCK_WRITER_WAITING again when they wake up
+		u32 new_state = state & ~(RW_LOCK_WRITER | RW_LOCK_PARKED);
+		if (compare_and_swap_32(&l->state, new_state, state)) {
+			if (state & RW_LOCK_PARKED) os_wake_all_on_address(&l->state);
+			return;
+		}
+	}
+}
+
+void semaphore_init(Semaphore *s, u32 initial_count) {
+	s->count = initial_count;
+	s->waiter_count = 0;
+}
+bool semaphore_try_wait(Semaphore *s) {
+	while (true) {
+		u32 count = s->count;
+		if (!count) return false;
+		if (compare_and_swap_32(&s->count, count-1, count)) return true;
+	}
+}
+void semaphore_wait(Semaphore *s) {
+	u64 pauses = 1;
+	for (u64 rounds = 0; rounds < SYNC_SPIN_ROUNDS; rounds += 1) {
+		if (semaphore_try_wait(s)) return;
+		spin_backoff(&pauses);
+	}
+	
+	// Both sides do a locked op before looking at the other's variable, so either the
+	// signaler sees us waiting or we see its count.
+	atomic_add_32(&s->waiter_count, 1);
+	while (!semaphore_try_wait(s)) {
+		os_wait_on_address(&s->count, 0);
+	}
+	atomic_sub_32(&s->waiter_count, 1);
+}
+void semaphore_signal(Semaphore *s, u32 count) {
+	if (!count) return;
+	atomic_add_32(&s->count, count);
+	if (s->waiter_count) {
+		if (count == 1) os_wake_one_on_address(&s->count);
+		else            os_wake_all_on_address(&s->count);
+	}
+}
+
+void barrier_init(Barrier *b, u32 thread_count) {
+	assert(thread_count > 0, "Barrier thread count must be more than 0");
+	b->thread_count = thread_count;
+	b->arrived_count = 0;
+	b->generation = 0;
+}
+bool barrier_wait(Barrier *b) {
+	u32 generation = b->generation;
+	u32 arrived = atomic_add_32(&b->arrived_count, 1) + 1;
+	assert(arrived <= b->thread_count, "More threads than Barrier.thread_count are waiting on barrier");
+	
+	if (arrived == b->thread_count) {
+		// Reset before releasing anyone, so threads that come straight back for the next
+		// round count from 0
+		b->arrived_count = 0;
+		atomic_add_32(&b->generation, 1);
+		os_wake_all_on_address(&b->generation);
+		return true;
+	}
+	
+	u64 pauses = 1;
+	for (u64 rounds = 0; rounds < SYNC_SPIN_ROUNDS; rounds += 1) {
+		if (b->generation != generation) return false;
+		spin_backoff(&pauses);
+	}
+	while (b->generation == generation) {
+		os_wait_on_address(&b->generation, generation);
+	}
+	return false;
+}
+
+void event_init(Event *e, bool signaled) {
+	e->signaled = signaled ? 1 : 0;
+	e->waiter_count = 0;
+}
+void event_wait(Event *e) {
+	u64 pauses = 1;
+	for (u64 rounds = 0; rounds < SYNC_SPIN_ROUNDS; rounds += 1) {
+		if (compare_and_swap_32(&e->signaled, 0, 1)) return;
+		spin_backoff(&pauses);
+	}
+	
+	atomic_add_32(&e->waiter_count, 1);
+	while (!compare_and_swap_32(&e->signaled, 0, 1)) {
+		os_wait_on_address(&e->signaled, 0);
+	}
+	atomic_sub_32(&e->waiter_count, 1);
+}
+void event_signal(Event *e) {
+	if (!compare_and_swap_32(&e->signaled, 1, 0)) return;
+	if (e->waiter_count) os_wake_one_on_address(&e->signaled);
+}
+
+///
+// Ring buffers
+
+void spsc_ring_init(Spsc_Ring *r, u64 item_size, u64 capacity, Allocator allocator) {
+	assert(item_size > 0, "Ring item size must be more than 0");
+	assert(capacity > 0, "Ring capacity must be more than 0");
+	
+	*r = ZERO(Spsc_Ring);
+	capacity = get_next_power_of_two(capacity);
+	r->data = (u8*)alloc(allocator, capacity*item_size);
+	r->item_size = item_size;
+	r->mask = capacity-1;
+	r->allocator = allocator;
+}
+void spsc_ring_deinit(Spsc_Ring *r) {
+	dealloc(r->allocator, r->data);
+	*r = ZERO(Spsc_Ring);
+}
+bool spsc_ring_push(Spsc_Ring *r, void *item) {
+	u64 tail = r->tail;
+	if (tail - r->cached_head > r->mask) {
+		r->cached_head = atomic_load_acquire_64(&r->head);
+		if (tail - r->cached_head > r->mask) return false;
+	}
+	
+	memcpy(r->data + (tail & r->mask)*r->item_size, item, r->item_size);
+	atomic_store_release_64(&r->tail, tail+1);
+	return true;
+}
+bool spsc_ring_pop(Spsc_Ring *r, void *out) {
+	u64 head = r->head;
+	if (head == r->cached_tail) {
+		r->cached_tail = atomic_load_acquire_64(&r->tail);
+		if (head == r->cached_tail) return false;
+	}
+	
+	memcpy(out, r->data + (head & r->mask)*r->item_size, r->item_size);
+	atomic_store_release_64(&r->head, head+1);
+	return true;
+}
+u64 spsc_ring_count(Spsc_Ring *r) {
+	u64 head = atomic_load_acquire_64(&r->head);
+	u64 tail = atomic_load_acquire_64(&r->tail);
+	return tail - head;
+}
+
+inline volatile u64 *mpmc_ring_get_sequence(Mpmc_Ring *r, u64 index) {
+	return (volatile u64*)(r->cells + (index & r->mask)*r->cell_size);
+}
+
+void mpmc_ring_init(Mpmc_Ring *r, u64 item_size, u64 capacity, Allocator allocator) {
+	assert(item_size > 0, "Ring item size must be more than 0");
+	assert(capacity > 0, "Ring capacity must be more than 0");
+	
+	*r = ZERO(Mpmc_Ring);
+	capacity = get_next_power_of_two(capacity);
+	r->cell_size = sizeof(u64) + align_next(item_size, 8);
+	r->cells = (u8*)alloc(allocator, capacity*r->cell_size);
+	r->item_size = item_size;
+	r->mask = capacity-1;
+	r->allocator = allocator;
+	
+	// Slot i is free for the producer which claims index i
+	for (u64 i = 0; i < capacity; i += 1) {
+		*mpmc_ring_get_sequence(r, i) = i;
+	}
+}
+void mpmc_ring_deinit(Mpmc_Ring *r) {
+	dealloc(r->allocator, r->cells);
+	*r = ZERO(Mpmc_Ring);
+}
+bool mpmc_ring_push(Mpmc_Ring *r, void *item) {
+	u64 tail = r->tail;
+	volatile u64 *sequence;
+	while (true) {
+		sequence = mpmc_ring_get_sequence(r, tail);
+		s64 diff = (s64)(atomic_load_acquire_64(sequence) - tail);
+		if (diff == 0) {
+			if (compare_and_swap_64(&r->tail, tail+1, tail)) break;
+			tail = r->tail;
+		} else if (diff < 0) {
+			// Slot still holds the item from one lap ago
+			return false;
+		} else {
+			// Another producer claimed this index
+			tail = r->tail;
+		}
+	}
+	
+	memcpy((u8*)sequence + sizeof(u64), item, r->item_size);
+	atomic_store_release_64(sequence, tail+1);
+	return true;
+}
+bool mpmc_ring_pop(Mpmc_Ring *r, void *out) {
+	u64 head = r->head;
+	volatile u64 *sequence;
+	while (true) {
+		sequence = mpmc_ring_get_sequence(r, head);
+		s64 diff = (s64)(atomic_load_acquire_64(sequence) - (head+1));
+		if (diff == 0) {
+			if (compare_and_swap_64(&r->head, head+1, head)) break;
+			head = r->head;
+		} else if (diff < 0) {
+			// Nothing written to this slot yet
+			return false;
+		} else {
+			head = r->head;
+		}
+	}
+	
+	memcpy(out, (u8*)sequence + sizeof(u64), r->item_size);
+	// Free for the producer one lap ahead
+	atomic_store_release_64(sequence, head + r->mask + 1);
+	return true;
+}
+u64 mpmc_ring_count(Mpmc_Ring *r) {
+	u64 head = atomic_load_acquire_64(&r->head);
+	u64 tail = atomic_load_acquire_64(&r->tail);
+	return tail > head ? tail - head : 0;
+}
+
+///
+// Job system
+
+typedef struct Job_Deque {
+	volatile s64 top; // Thieves take from here
+	u8 top_padding[56];
+	volatile s64 bottom; // Only the owner writes this
+	u8 bottom_padding[56];
+	Job jobs[JOB_DEQUE_CAPACITY];
+} Job_Deque;
+
+typedef struct Job_Worker {
+	Job_Deque deque;
+	Thread thread;
+	Binary_Semaphore wake;
+	volatile bool sleeping;
+} Job_Worker;
+
+// #Global
+Job_Worker *volatile job_workers = 0;
+u64 job_worker_count = 0;
+volatile bool job_system_running = false;
+// Read on every push, kept off the lines that change with every push
+Padded_U64 job_sleeping_count = {0};
+Spinlock job_system_init_lock = {0};
+
+Spinlock job_shared_lock = {0};
+Job *job_shared_queue = 0; // Ring buffer
+u64 job_shared_capacity = 0;
+u64 job_shared_head = 0;
+Padded_U64 job_shared_count = {0};
+
+thread_local s64 job_worker_index = -1; // -1 on threads outside of the pool
+thread_local u64 job_steal_seed = 0;
+
+// Owner only
+bool job_deque_push(Job_Deque *d, Job *job) {
+	s64 b = d->bottom;
+	s64 t = d->top;
+	if (b - t >= JOB_DEQUE_CAPACITY) return false;
+	
+	d->jobs[b & (JOB_DEQUE_CAPACITY-1)] = *job;
+	MEMORY_BARRIER;
+	d->bottom = b + 1;
+	return true;
+}
+// Owner only
+bool job_deque_pop(Job_Deque *d, Job *job) {
+	s64 b = d->bottom - 1;
+	d->bottom = b;
+	atomic_thread_fence();
+	s64 t = d->top;
+	
+	if (t > b) {
+		d->bottom = b + 1;
+		return false;
+	}
+	
+	*job = d->jobs[b & (JOB_DEQUE_CAPACITY-1)];
+	if (t == b) {
+		// Last job, thieves might be going for it too
+		bool won = compare_and_swap_64((volatile u64*)&d->top, (u64)(t + 1), (u64)t);
+		d->bottom = b + 1;
+		return won;
+	}
+	return true;
+}
+// Any thread. The job is copied before top is claimed, and the owner can't overwrite that
+// slot until top has moved past it, so the copy is good if the claim succeeds.
+bool job_deque_steal(Job_Deque *d, Job *job) {
+	s64 t = d->top;
+	MEMORY_BARRIER;
+	s64 b = d->bottom;
+	if (t >= b) return false;
+	
+	*job = d->jobs[t & (JOB_DEQUE_CAPACITY-1)];
+	return compare_and_swap_64((volatile u64*)&d->top, (u64)(t + 1), (u64)t);
+}
+
+void job_shared_push(Job *job) {
+	spinlock_acquire_or_wait(&job_shared_lock);
+	if (job_shared_count.value == job_shared_capacity) {
+		u64 new_capacity = job_shared_capacity ? job_shared_capacity*2 : 256;
+		Job *new_queue = (Job*)alloc(get_heap_allocator(), new_capacity*sizeof(Job));
+		for (u64 i = 0; i < job_shared_count.value; i += 1) {
+			new_queue[i] = job_shared_queue[(job_shared_head + i) % job_shared_capacity];
+		}
+		if (job_shared_queue) dealloc(get_heap_allocator(), job_shared_queue);
+		job_shared_queue = new_queue;
+		job_shared_capacity = new_capacity;
+		job_shared_head = 0;
+	}
+	job_shared_queue[(job_shared_head + job_shared_count.value) % job_shared_capacity] = *job;
+	job_shared_count.value += 1;
+	spinlock_release(&job_shared_lock);
+}
+bool job_shared_pop(Job *job) {
+	if (!job_shared_count.value) return false;
+	
+	spinlock_acquire_or_wait(&job_shared_lock);
+	bool found = job_shared_count.value > 0;
+	if (found) {
+		*job = job_shared_queue[job_shared_head];
+		job_shared_head = (job_shared_head + 1) % job_shared_capacity;
+		job_shared_count.value -= 1;
+	}
+	spinlock_release(&job_shared_lock);
+	return found;
+}
+
+bool job_is_any_work_queued() {
+	if (job_shared_count.value) return true;
+	for (u64 i = 0; i < job_worker_count; i += 1) {
+		if (job_workers[i].deque.bottom > job_workers[i].deque.top) return true;
+	}
+	return false;
+}
+
+bool job_find_work(Job *job) {
+	s64 self = job_worker_index;
+	if (self >= 0 && job_deque_pop(&job_workers[self].deque, job)) return true;
+	if (job_shared_pop(job)) return true;
+	
+	// Start at a different victim each time so thieves spread out
+	job_steal_seed = job_steal_seed*6364136223846793005ULL + 1442695040888963407ULL;
+	u64 start = (job_steal_seed >> 33) % job_worker_count;
+	for (u64 i = 0; i < job_worker_count; i += 1) {
+		u64 victim = (start + i) % job_worker_count;
+		if ((s64)victim == self) continue;
+		if (job_deque_steal(&job_workers[victim].deque, job)) return true;
+	}
+	return false;
+}
+
+void job_wake_one() {
+	for (u64 i = 0; i < job_worker_count; i += 1) {
+		Job_Worker *w = &job_workers[i];
+		if (w->sleeping && compare_and_swap_bool(&w->sleeping, false, true)) {
+			atomic_sub_64(&job_sleeping_count.value, 1);
+			os_binary_semaphore_signal(&w->wake);
+			return;
+		}
+	}
+}
+
+void job_push(Job *job) {
+	s64 self = job_worker_index;
+	if (self < 0 || !job_deque_push(&job_workers[self].deque, job)) {
+		job_shared_push(job);
+	}
+	
+	// Pairs with the barrier in job_worker_proc, so either we see the sleeper or the
+	// sleeper sees this job.
+	atomic_thread_fence();
+	if (job_sleeping_count.value) job_wake_one();
+}
+
+void job_execute(Job *job);
+
+// Splits off the upper half of the range as a new job until it's down to grain, so idle
+// workers steal big ranges and split them further themselves.
+void job_execute_range(Job *job) {
+	u64 start = job->start;
+	u64 end = job->end;
+	while (end - start > job->grain) {
+		u64 middle = start + ((end - start)/job->grain/2)*job->grain;
+		if (middle == start) middle = start + job->grain;
+		
+		Job upper = *job;
+		upper.start = middle;
+		upper.end = end;
+		atomic_add_64(&job->counter->count, 1);
+		job_push(&upper);
+		
+		end = middle;
+	}
+	job->range_proc(start, end, job->data);
+}
+
+void job_execute(Job *job) {
+	if (job->range_proc) job_execute_range(job);
+	else job->proc(job->data);
+	
+	if (job->counter) atomic_sub_64(&job->counter->count, 1);
+}
+
+void job_worker_proc(Thread *t) {
+	job_worker_index = (s64)(u64)t->data;
+	job_steal_seed = (u64)job_worker_index + 1;
+	Job_Worker *w = &job_workers[job_worker_index];
+	
+	u64 idle_count = 0;
+	while (job_system_running) {
+		Job job;
+		if (job_find_work(&job)) {
+			job_execute(&job);
+			// Like task workers, temp memory only lives for one job. Jobs run from
+			// job_wait() inside this one are nested in it, so this is the only reset.
+			reset_temporary_storage();
+			idle_count = 0;
+			continue;
+		}
+		
+		idle_count += 1;
+		if (idle_count < 64) continue;
+		if (idle_count < 128) {
+			os_yield_thread();
+			continue;
+		}
+		
+		// Say we're going to sleep before the last look for work, so a job pushed after the
+		// look will wake us.
+		w->sleeping = true;
+		atomic_add_64(&job_sleeping_count.value, 1);
+		atomic_thread_fence();
+		if (job_is_any_work_queued() || !job_system_running) {
+			if (compare_and_swap_bool(&w->sleeping, false, true)) {
+				atomic_sub_64(&job_sleeping_count.value, 1);
+			} else {
+				// Someone already woke us, take the signal
+				os_binary_semaphore_wait(&w->wake);
+			}
+		} else {
+			os_binary_semaphore_wait(&w->wake);
+		}
+		idle_count = 0;
+	}
+}
+
+void job_system_init(u64 worker_count) {
+	assert(!job_workers, "Job system is already initialized");
+	
+	if (!worker_count) worker_count = max((s64)os_get_number_of_logical_processors() - 1, 1);
+	
+	Job_Worker *workers = (Job_Worker*)alloc(get_heap_allocator(), worker_count*sizeof(Job_Worker));
+	job_worker_count = worker_count;
+	job_system_running = true;
+	job_sleeping_count.value = 0;
+	
+	for (u64 i = 0; i < worker_count; i += 1) {
+		Job_Worker *w = &workers[i];
+		w->deque.top = 0;
+		w->deque.bottom = 0;
+		w->sleeping = false;
+		os_binary_semaphore_init(&w->wake, false);
+		os_thread_init(&w->thread, job_worker_proc);
+		w->thread.data = (void*)i;
+		w->thread.temporary_storage_size = JOB_WORKER_TEMPORARY_STORAGE_SIZE;
+	}
+	
+	MEMORY_BARRIER;
+	job_workers = workers;
+	
+	for (u64 i = 0; i < worker_count; i += 1) {
+		os_thread_start(&workers[i].thread);
+	}
+}
+
+void job_system_init_if_needed() {
+	if (job_workers) return;
+	spinlock_acquire_or_wait(&job_system_init_lock);
+	if (!job_workers) job_system_init(0);
+	spinlock_release(&job_system_init_lock);
+}
+
+// Waits for the workers to finish their current job. Jobs still queued are not run.
+void job_system_shutdown() {
+	if (!job_workers) return;
+	
+	job_system_running = false;
+	atomic_thread_fence();
+	for (u64 i = 0; i < job_worker_count; i += 1) {
+		os_binary_semaphore_signal(&job_workers[i].wake);
+	}
+	for (u64 i = 0; i < job_worker_count; i += 1) {
+		os_thread_join(&job_workers[i].thread);
+		os_thread_destroy(&job_workers[i].thread);
+		os_binary_semaphore_destroy(&job_workers[i].wake);
+	}
+	
+	dealloc(get_heap_allocator(), job_workers);
+	job_workers = 0;
+	job_worker_count = 0;
+	
+	if (job_shared_queue) dealloc(get_heap_allocator(), job_shared_queue);
+	job_shared_queue = 0;
+	job_shared_capacity = 0;
+	job_shared_head = 0;
+	job_shared_count.value = 0;
+}
+
+u64 job_system_get_worker_count() {
+	job_system_init_if_needed();
+	return job_worker_count;
+}
+
+void job_run(Job_Proc proc, void *data, Job_Counter *counter) {
+	job_system_init_if_needed();
+	
+	Job job = ZERO(Job);
+	job.proc = proc;
+	job.data = data;
+	job.counter = counter;
+	if (counter) atomic_add_64(&counter->count, 1);
+	job_push(&job);
+}
+
+void job_counter_wait(Job_Counter *counter) {
+	u64 idle_count = 0;
+	while (counter->count) {
+		Job job;
+		if (job_workers && job_find_work(&job)) {
+			job_execute(&job);
+			idle_count = 0;
+		} else {
+			// The last jobs are running on other threads
+			idle_count += 1;
+			if (idle_count > 64) os_yield_thread();
+		}
+	}
+}
+
+void parallel_for(u64 count, u64 grain, Parallel_For_Proc proc, void *data) {
+	if (!count) return;
+	if (!grain) grain = 1;
+	if (count <= grain) {
+		proc(0, count, data);
+		return;
+	}
+	
+	job_system_init_if_needed();
+	
+	Job_Counter counter = {1};
+	Job job = ZERO(Job);
+	job.range_proc = proc;
+	job.data = data;
+	job.start = 0;
+	job.end = count;
+	job.grain = grain;
+	job.counter = &counter;
+	job_execute(&job);
+	
+	job_counter_wait(&counter);
+}
+
+///
+// Parallel radix sort
+
+typedef struct Parallel_Radix_Sort {
+	u64 *src;
+	u64 *dst;
+	u64 count;
+	u64 block_size;
+	u32 shift;
+	u32 *block_offsets; // [block][digit], counts and then offsets into dst
+} Parallel_Radix_Sort;
+
+void parallel_radix_sort_count_proc(u64 start, u64 end, void *data) {
+	Parallel_Radix_Sort *sort = (Parallel_Radix_Sort*)data;
+	for (u64 block = start; block < end; block += 1) {
+		u32 *counts = sort->block_offsets + block*RADIX_KEY_BUCKETS;
+		memset(counts, 0, RADIX_KEY_BUCKETS*sizeof(u32));
+		u64 first = block*sort->block_size;
+		u64 last = min(first + sort->block_size, sort->count);
+		for (u64 i = first; i < last; i += 1) {
+			counts[sort_key_get_digit(sort->src[i], sort->shift)] += 1;
+		}
+	}
+}
+void parallel_radix_sort_scatter_proc(u64 start, u64 end, void *data) {
+	Parallel_Radix_Sort *sort = (Parallel_Radix_Sort*)data;
+	for (u64 block = start; block < end; block += 1) {
+		u32 *offsets = sort->block_offsets + block*RADIX_KEY_BUCKETS;
+		u64 first = block*sort->block_size;
+		u64 last = min(first + sort->block_size, sort->count);
+		for (u64 i = first; i < last; i += 1) {
+			u64 key = sort->src[i];
+			sort->dst[offsets[sort_key_get_digit(key, sort->shift)]++] = key;
+		}
+	}
+}
+
+void parallel_radix_sort_keys(u64 *keys, u64 *help_buffer, u64 count, u64 number_of_bits) {
+	assert(number_of_bits > 0 && number_of_bits <= 32, "parallel_radix_sort_keys sorts on 1 to 32 bits");
+	
+	// Small sorts never touch the job system, so they don't start the workers
+	u64 block_count = min(count/PARALLEL_RADIX_SORT_MIN_BLOCK_SIZE, (u64)PARALLEL_RADIX_SORT_MAX_BLOCKS);
+	if (block_count >= 2) block_count = min(block_count, job_system_get_worker_count()+1);
+	if (block_count < 2) {
+		radix_sort_keys(keys, help_buffer, count, number_of_bits);
+		return;
+	}
+	
+	Parallel_Radix_Sort sort = ZERO(Parallel_Radix_Sort);
+	sort.src = keys;
+	sort.dst = help_buffer;
+	sort.count = count;
+	sort.block_size = (count + block_count - 1)/block_count;
+	sort.block_offsets = (u32*)alloc(get_heap_allocator(), block_count*RADIX_KEY_BUCKETS*sizeof(u32));
+	
+	const u32 pass_count = (u32)((number_of_bits + RADIX_KEY_BITS_PER_PASS - 1) / RADIX_KEY_BITS_PER_PASS);
+	for (u32 pass = 0; pass < pass_count; pass += 1) {
+		sort.shift = pass*RADIX_KEY_BITS_PER_PASS;
+		
+		parallel_for(block_count, 1, parallel_radix_sort_count_proc, &sort);
+		
+		// Digit major, block minor, so each block's keys of one digit land after the keys
+		// of that digit from earlier blocks. That keeps the sort stable.
+		u32 sum = 0;
+		bool all_same_digit = false;
+		for (u32 d = 0; d < RADIX_KEY_BUCKETS; d += 1) {
+			u32 digit_start = sum;
+			for (u64 block = 0; block < block_count; block += 1) {
+				u32 *slot = sort.block_offsets + block*RADIX_KEY_BUCKETS + d;
+				u32 c = *slot;
+				*slot = sum;
+				sum += c;
+			}
+			if (sum - digit_start == count) all_same_digit = true;
+		}
+		if (all_same_digit) continue;
+		
+		parallel_for(block_count, 1, parallel_radix_sort_scatter_proc, &sort);
+		
+		u64 *t = sort.src; sort.src = sort.dst; sort.dst = t;
 	}
+	
+	if (sort.src != keys) memcpy(keys, sort.src, count*sizeof(u64));
+	
+	dealloc(get_heap_allocator(), sort.block_offsets);
 }
 
 #endif
\ No newline at end of file
@@ -25,13 +25,14 @@ typedef struct Cpu_Capabilities {
 
 ///
 // Compiler specific stuff
-#if COMPILER_MVSC
+#if COMPILER_MSVC
 	#define inline __forceinline
 	#define alignat(x) __declspec(align(x))
 	#define noreturn __declspec(noreturn)
+	#define NO_INLINE __declspec(noinline)
     #define COMPILER_HAS_MEMCPY_INTRINSICS 1
-    inline void 
-    crash() noreturn {
+    noreturn inline void 
+    crash() {
 		__debugbreak();
 		volatile int *a = 0;
 		*a = 5;
@@ -40,6 +41,9 @@ typedef struct Cpu_Capabilities {
 	}
     #include <intrin.h>
     #pragma intrinsic(__rdtsc)
+    #pragma intrinsic(_ReturnAddress)
+    // Where the calling function will return to. Must be a macro so it's the caller's.
+    #define get_return_address() _ReturnAddress()
     inline u64 
     rdtsc() {
         return __rdtsc();
@@ -73,7 +77,7 @@ typedef struct Cpu_Capabilities {
 		#define COMPILER_CAN_DO_AVX512 0
 	#endif
 	
-	#define DEPRECATED(proc, msg) __declspec(deprecated(msg)) func
+	#define DEPRECATED(proc, msg) __declspec(deprecated(msg)) proc
 	
 	#pragma intrinsic(_InterlockedCompareExchange8)
 	#pragma intrinsic(_InterlockedCompareExchange16)
@@ -106,6 +110,63 @@ typedef struct Cpu_Capabilities {
 	}
 	
 	#define MEMORY_BARRIER _ReadWriteBarrier()
+	// Compiler only. On x86 that's enough for acquire loads & release stores, since the cpu
+	// doesn't reorder loads with older loads or stores with older stores.
+	#define COMPILER_BARRIER _ReadWriteBarrier()
+	
+	#pragma intrinsic(_InterlockedExchangeAdd)
+	#pragma intrinsic(_InterlockedExchangeAdd64)
+	#pragma intrinsic(_InterlockedExchange)
+	#pragma intrinsic(_InterlockedExchange64)
+	
+	inline uint32_t
+	atomic_add_32(volatile uint32_t *a, uint32_t x) {
+		return (uint32_t)_InterlockedExchangeAdd((volatile long*)a, (long)x);
+	}
+	inline uint64_t
+	atomic_add_64(volatile uint64_t *a, uint64_t x) {
+		return (uint64_t)_InterlockedExchangeAdd64((volatile long long*)a, (long long)x);
+	}
+	inline uint32_t
+	atomic_exchange_32(volatile uint32_t *a, uint32_t x) {
+		return (uint32_t)_InterlockedExchange((volatile long*)a, (long)x);
+	}
+	inline uint64_t
+	atomic_exchange_64(volatile uint64_t *a, uint64_t x) {
+		return (uint64_t)_InterlockedExchange64((volatile long long*)a, (long long)x);
+	}
+	
+	// Aligned loads are atomic on x86. Stores are seq_cst through xchg, so plain loads are too.
+	inline uint32_t atomic_load_relaxed_32(volatile uint32_t *a) { return *a; }
+	inline uint64_t atomic_load_relaxed_64(volatile uint64_t *a) { return *a; }
+	inline uint32_t atomic_load_acquire_32(volatile uint32_t *a) { uint32_t x = *a; COMPILER_BARRIER; return x; }
+	inline uint64_t atomic_load_acquire_64(volatile uint64_t *a) { uint64_t x = *a; COMPILER_BARRIER; return x; }
+	inline uint32_t atomic_load_32(volatile uint32_t *a) { COMPILER_BARRIER; uint32_t x = *a; COMPILER_BARRIER; return x; }
+	inline uint64_t atomic_load_64(volatile uint64_t *a) { COMPILER_BARRIER; uint64_t x = *a; COMPILER_BARRIER; return x; }
+	
+	inline void atomic_store_relaxed_32(volatile uint32_t *a, uint32_t x) { *a = x; }
+	inline void atomic_store_relaxed_64(volatile uint64_t *a, uint64_t x) { *a = x; }
+	inline void atomic_store_release_32(volatile uint32_t *a, uint32_t x) { COMPILER_BARRIER; *a = x; }
+	inline void atomic_store_release_64(volatile uint64_t *a, uint64_t x) { COMPILER_BARRIER; *a = x; }
+	inline void atomic_store_32(volatile uint32_t *a, uint32_t x) { _InterlockedExchange((volatile long*)a, (long)x); }
+	inline void atomic_store_64(volatile uint64_t *a, uint64_t x) { _InterlockedExchange64((volatile long long*)a, (long long)x); }
+	
+	// Full fence, orders stores before later loads too
+	inline void atomic_thread_fence() { _mm_mfence(); }
+	
+	// Index of lowest/highest set bit. x must not be 0.
+	inline u64 
+	bit_scan_forward_64(u64 x) {
+		unsigned long index;
+		_BitScanForward64(&index, x);
+		return (u64)index;
+	}
+	inline u64 
+	bit_scan_reverse_64(u64 x) {
+		unsigned long index;
+		_BitScanReverse64(&index, x);
+		return (u64)index;
+	}
 	
 	#define thread_local __declspec(thread)
 	
@@ -116,6 +177,7 @@ typedef struct Cpu_Capabilities {
 	#define inline __attribute__((always_inline)) inline
 	#define alignat(x) __attribute__((aligned(x)))	
     #define noreturn __attribute__((noreturn))
+    #define NO_INLINE __attribute__((noinline))
     #define COMPILER_HAS_MEMCPY_INTRINSICS 1
     
     inline void noreturn
@@ -127,6 +189,9 @@ typedef struct Cpu_Capabilities {
     	*a = 5;
 	}
 	
+    // Where the calling function will return to. Must be a macro so it's the caller's.
+    #define get_return_address() __builtin_return_address(0)
+    
     inline u64 
     rdtsc() {
         unsigned int lo, hi;
@@ -226,6 +291,53 @@ typedef struct Cpu_Capabilities {
 	}
 	
 	#define MEMORY_BARRIER {__asm__ __volatile__("" ::: "memory");__sync_synchronize();}
+	// Compiler only. On x86 that's enough for acquire loads & release stores, since the cpu
+	// doesn't reorder loads with older loads or stores with older stores.
+	#define COMPILER_BARRIER __asm__ __volatile__("" ::: "memory")
+	
+	inline uint32_t
+	atomic_add_32(volatile uint32_t *a, uint32_t x) {
+		return __atomic_fetch_add(a, x, __ATOMIC_SEQ_CST);
+	}
+	inline uint64_t
+	atomic_add_64(volatile uint64_t *a, uint64_t x) {
+		return __atomic_fetch_add(a, x, __ATOMIC_SEQ_CST);
+	}
+	inline uint32_t
+	atomic_exchange_32(volatile uint32_t *a, uint32_t x) {
+		return __atomic_exchange_n(a, x, __ATOMIC_SEQ_CST);
+	}
+	inline uint64_t
+	atomic_exchange_64(volatile uint64_t *a, uint64_t x) {
+		return __atomic_exchange_n(a, x, __ATOMIC_SEQ_CST);
+	}
+	
+	inline uint32_t atomic_load_relaxed_32(volatile uint32_t *a) { return __atomic_load_n(a, __ATOMIC_RELAXED); }
+	inline uint64_t atomic_load_relaxed_64(volatile uint64_t *a) { return __atomic_load_n(a, __ATOMIC_RELAXED); }
+	inline uint32_t atomic_load_acquire_32(volatile uint32_t *a) { return __atomic_load_n(a, __ATOMIC_ACQUIRE); }
+	inline uint64_t atomic_load_acquire_64(volatile uint64_t *a) { return __atomic_load_n(a, __ATOMIC_ACQUIRE); }
+	inline uint32_t atomic_load_32(volatile uint32_t *a) { return __atomic_load_n(a, __ATOMIC_SEQ_CST); }
+	inline uint64_t atomic_load_64(volatile uint64_t *a) { return __atomic_load_n(a, __ATOMIC_SEQ_CST); }
+	
+	inline void atomic_store_relaxed_32(volatile uint32_t *a, uint32_t x) { __atomic_store_n(a, x, __ATOMIC_RELAXED); }
+	inline void atomic_store_relaxed_64(volatile uint64_t *a, uint64_t x) { __atomic_store_n(a, x, __ATOMIC_RELAXED); }
+	inline void atomic_store_release_32(volatile uint32_t *a, uint32_t x) { __atomic_store_n(a, x, __ATOMIC_RELEASE); }
+	inline void atomic_store_release_64(volatile uint64_t *a, uint64_t x) { __atomic_store_n(a, x, __ATOMIC_RELEASE); }
+	inline void atomic_store_32(volatile uint32_t *a, uint32_t x) { __atomic_store_n(a, x, __ATOMIC_SEQ_CST); }
+	inline void atomic_store_64(volatile uint64_t *a, uint64_t x) { __atomic_store_n(a, x, __ATOMIC_SEQ_CST); }
+	
+	// Full fence, orders stores before later loads too
+	inline void atomic_thread_fence() { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+	
+	// Index of lowest/highest set bit. x must not be 0.
+	inline u64 
+	bit_scan_forward_64(u64 x) {
+		return (u64)__builtin_ctzll(x);
+	}
+	inline u64 
+	bit_scan_reverse_64(u64 x) {
+		return (u64)(63 - __builtin_clzll(x));
+	}
 	
 	#define thread_local __thread
 	
@@ -239,7 +351,9 @@ typedef struct Cpu_Capabilities {
 	
 #else
 	#define inline inline
+	#define NO_INLINE
     #define COMPILER_HAS_MEMCPY_INTRINSICS 0
+    #define get_return_address() ((void*)0)
     
     inline u64 
     rdtsc() { return 0; }
@@ -253,6 +367,11 @@ typedef struct Cpu_Capabilities {
     
     #define MEMORY_BARRIER
     
+    inline u64 
+    bit_scan_forward_64(u64 x) { u64 i = 0; while (!(x & 1)) { x >>= 1; i += 1; } return i; }
+    inline u64 
+    bit_scan_reverse_64(u64 x) { u64 i = 0; while (x >>= 1) i += 1; return i; }
+    
     #warning "Compiler is not explicitly supported, some things will probably not work as expected"
 #endif
 
@@ -0,0 +1,364 @@
+
+/*
+
+	Structure of arrays entity storage.
+
+	Entities are generational ids. Component types are registered with one or more columns
+	(fields), and each component type is a sparse set: a dense array per column plus a
+	dense array of the entities which have the component, with a sparse array from entity
+	index to dense index.
+	Systems iterate the dense columns directly, so they stream through exactly the fields
+	they touch. Adding & removing a component is O(1): removing moves the last item of every
+	column into the hole, so dense indices change on remove.
+
+	components_align() puts two component types in the same order, so a system that needs
+	both (movement needs position & velocity) can iterate both columns by the same index.
+
+	Columns are 16 byte aligned and always have room for the count rounded up to
+	ENTITY_COLUMN_PADDING items, so 4 or 8 wide loops don't need a scalar tail. Whatever is
+	past the count is garbage.
+
+	Not thread safe. Columns can be processed on several threads (parallel_for) as long as
+	nothing is created, destroyed, added or removed meanwhile.
+
+	Full API:
+
+		void         entity_storage_init(Entity_Storage *s, Allocator allocator);
+		void         entity_storage_deinit(Entity_Storage *s);
+		Component_Id entity_storage_register_component(Entity_Storage *s, u64 column_count, const u64 *column_sizes);
+
+		Entity_Id entity_create(Entity_Storage *s);
+		// Removes all components. Returns false if the entity was already destroyed.
+		bool      entity_destroy(Entity_Storage *s, Entity_Id e);
+		bool      entity_is_alive(Entity_Storage *s, Entity_Id e);
+		u64       entity_get_count(Entity_Storage *s);
+
+		// Fields are zeroed. Returns the dense index.
+		u64   entity_add_component(Entity_Storage *s, Entity_Id e, Component_Id c);
+		bool  entity_remove_component(Entity_Storage *s, Entity_Id e, Component_Id c);
+		bool  entity_has_component(Entity_Storage *s, Entity_Id e, Component_Id c);
+		// Returns -1 if e doesn't have c
+		s64   entity_get_component_index(Entity_Storage *s, Entity_Id e, Component_Id c);
+		// Returns 0 if e doesn't have c
+		void *entity_get_field(Entity_Storage *s, Entity_Id e, Component_Id c, u64 column);
+
+		// Dense iteration
+		u64        component_get_count(Entity_Storage *s, Component_Id c);
+		void      *component_get_column(Entity_Storage *s, Component_Id c, u64 column);
+		Entity_Id *component_get_entities(Entity_Storage *s, Component_Id c);
+		// Entities with both a & b go first in both, in the same order. Returns how many.
+		// O(1) when nothing was added to or removed from a or b since the last call.
+		u64        components_align(Entity_Storage *s, Component_Id a, Component_Id b);
+
+	Usage:
+
+		Entity_Storage world;
+		entity_storage_init(&world, get_heap_allocator());
+
+		u64 position_columns[] = { sizeof(float32), sizeof(float32) }; // x, y
+		Component_Id position = entity_storage_register_component(&world, 2, position_columns);
+		u64 velocity_columns[] = { sizeof(float32), sizeof(float32) };
+		Component_Id velocity = entity_storage_register_component(&world, 2, velocity_columns);
+
+		Entity_Id e = entity_create(&world);
+		entity_add_component(&world, e, position);
+		entity_add_component(&world, e, velocity);
+		*(float32*)entity_get_field(&world, e, velocity, 0) = 100;
+
+		u64 count = components_align(&world, velocity, position);
+		float32 *x  = component_get_column(&world, position, 0);
+		float32 *y  = component_get_column(&world, position, 1);
+		float32 *vx = component_get_column(&world, velocity, 0);
+		float32 *vy = component_get_column(&world, velocity, 1);
+		for (u64 i = 0; i < count; i += 1) {
+			x[i] += vx[i]*delta_time;
+			y[i] += vy[i]*delta_time;
+		}
+
+		entity_destroy(&world, e);
+		entity_storage_deinit(&world);
+*/
+
+#define ENTITY_MAX_COMPONENT_TYPES 64
+#define ENTITY_COMPONENT_MAX_COLUMNS 8
+#define ENTITY_COLUMN_PADDING 8
+
+typedef struct Entity_Id {
+	u32 index;
+	u32 generation; // 0 is never valid
+} Entity_Id;
+
+typedef u32 Component_Id;
+
+typedef struct Component_Storage {
+	u64 column_count;
+	u64 column_sizes[ENTITY_COMPONENT_MAX_COLUMNS];
+	u8 *columns[ENTITY_COMPONENT_MAX_COLUMNS];
+	Entity_Id *entities; // Same order as the columns
+	u64 count;
+	u64 capacity;
+
+	u32 *sparse; // Entity index -> dense index+1, 0 if the entity doesn't have the component
+	u64 sparse_capacity;
+
+	u64 change_count; // Bumped whenever dense indices change
+	// Last components_align() with this as a
+	Component_Id aligned_with; // b+1, 0 for none
+	u64 aligned_change_counts[2];
+	u64 aligned_count;
+} Component_Storage;
+
+typedef struct Entity_Storage {
+	Allocator allocator;
+
+	u32 *generations; // Per entity slot
+	u64 slot_count;
+	u64 slot_capacity;
+	u32 *free_slots; // Growing array
+	u64 alive_count;
+
+	Component_Storage components[ENTITY_MAX_COMPONENT_TYPES];
+	u64 component_type_count;
+} Entity_Storage;
+
+void*
+entity_storage_grow(Allocator allocator, void *p, u64 size) {
+	if (!p) return alloc(allocator, size);
+	return reallocate(allocator, p, size);
+}
+
+void
+entity_storage_init(Entity_Storage *s, Allocator allocator) {
+	*s = ZERO(Entity_Storage);
+	s->allocator = allocator;
+	growing_array_init((void**)&s->free_slots, sizeof(u32), allocator);
+}
+void
+entity_storage_deinit(Entity_Storage *s) {
+	for (u64 i = 0; i < s->component_type_count; i += 1) {
+		Component_Storage *c = &s->components[i];
+		for (u64 j = 0; j < c->column_count; j += 1) {
+			if (c->columns[j]) dealloc(s->allocator, c->columns[j]);
+		}
+		if (c->entities) dealloc(s->allocator, c->entities);
+		if (c->sparse)   dealloc(s->allocator, c->sparse);
+	}
+	if (s->generations) dealloc(s->allocator, s->generations);
+	growing_array_deinit((void**)&s->free_slots);
+	*s = ZERO(Entity_Storage);
+}
+
+Component_Id
+entity_storage_register_component(Entity_Storage *s, u64 column_count, const u64 *column_sizes) {
+	assert(s->component_type_count < ENTITY_MAX_COMPONENT_TYPES, "Registered more than ENTITY_MAX_COMPONENT_TYPES component types");
+	assert(column_count > 0 && column_count <= ENTITY_COMPONENT_MAX_COLUMNS, "Component types need 1 to ENTITY_COMPONENT_MAX_COLUMNS columns, got %llu", column_count);
+
+	Component_Id id = (Component_Id)s->component_type_count;
+	Component_Storage *c = &s->components[id];
+	c->column_count = column_count;
+	for (u64 i = 0; i < column_count; i += 1) {
+		assert(column_sizes[i] > 0, "Component column size must be more than 0");
+		c->column_sizes[i] = column_sizes[i];
+	}
+	s->component_type_count += 1;
+	return id;
+}
+
+inline Component_Storage*
+entity_storage_get_component(Entity_Storage *s, Component_Id c) {
+	assert(c < s->component_type_count, "Invalid component id %u", c);
+	return &s->components[c];
+}
+
+bool
+entity_is_alive(Entity_Storage *s, Entity_Id e) {
+	return e.generation != 0 && e.index < s->slot_count && s->generations[e.index] == e.generation;
+}
+u64
+entity_get_count(Entity_Storage *s) {
+	return s->alive_count;
+}
+
+Entity_Id
+entity_create(Entity_Storage *s) {
+	Entity_Id e;
+	u32 free_count = growing_array_get_valid_count(s->free_slots);
+	if (free_count) {
+		e.index = s->free_slots[free_count-1];
+		growing_array_pop((void**)&s->free_slots);
+	} else {
+		if (s->slot_count == s->slot_capacity) {
+			s->slot_capacity = max(s->slot_capacity*2, 64);
+			s->generations = (u32*)entity_storage_grow(s->allocator, s->generations, s->slot_capacity*sizeof(u32));
+		}
+		e.index = (u32)s->slot_count;
+		s->generations[e.index] = 1;
+		s->slot_count += 1;
+	}
+	e.generation = s->generations[e.index];
+	s->alive_count += 1;
+	return e;
+}
+
+inline bool
+component_storage_has(Component_Storage *c, u32 index) {
+	return index < c->sparse_capacity && c->sparse[index] != 0;
+}
+
+// Moves the last item into the hole
+void
+component_storage_remove_at(Component_Storage *c, u64 i) {
+	u64 last = c->count-1;
+	c->change_count += 1;
+	c->sparse[c->entities[i].index] = 0;
+	if (i != last) {
+		for (u64 j = 0; j < c->column_count; j += 1) {
+			u64 size = c->column_sizes[j];
+			memcpy(c->columns[j] + i*size, c->columns[j] + last*size, size);
+		}
+		c->entities[i] = c->entities[last];
+		c->sparse[c->entities[i].index] = (u32)(i+1);
+	}
+	c->count -= 1;
+}
+
+bool
+entity_destroy(Entity_Storage *s, Entity_Id e) {
+	if (!entity_is_alive(s, e)) return false;
+
+	for (u64 i = 0; i < s->component_type_count; i += 1) {
+		Component_Storage *c = &s->components[i];
+		if (component_storage_has(c, e.index)) component_storage_remove_at(c, c->sparse[e.index]-1);
+	}
+
+	s->generations[e.index] += 1;
+	if (s->generations[e.index] == 0) s->generations[e.index] = 1;
+	growing_array_add((void**)&s->free_slots, &e.index);
+	s->alive_count -= 1;
+	return true;
+}
+
+u64
+entity_add_component(Entity_Storage *s, Entity_Id e, Component_Id id) {
+	assert(entity_is_alive(s, e), "Adding a component to a destroyed entity");
+	Component_Storage *c = entity_storage_get_component(s, id);
+	if (component_storage_has(c, e.index)) return c->sparse[e.index]-1;
+
+	if (e.index >= c->sparse_capacity) {
+		u64 new_capacity = s->slot_capacity;
+		c->sparse = (u32*)entity_storage_grow(s->allocator, c->sparse, new_capacity*sizeof(u32));
+		memset(c->sparse + c->sparse_capacity, 0, (new_capacity-c->sparse_capacity)*sizeof(u32));
+		c->sparse_capacity = new_capacity;
+	}
+
+	// +PADDING so a vector loop over the count rounded up stays inside the column
+	if (c->count + ENTITY_COLUMN_PADDING > c->capacity) {
+		u64 new_capacity = align_next(max(c->capacity*2, 64), ENTITY_COLUMN_PADDING);
+		for (u64 j = 0; j < c->column_count; j += 1) {
+			c->columns[j] = (u8*)entity_storage_grow(s->allocator, c->columns[j], new_capacity*c->column_sizes[j]);
+		}
+		c->entities = (Entity_Id*)entity_storage_grow(s->allocator, c->entities, new_capacity*sizeof(Entity_Id));
+		c->capacity = new_capacity;
+	}
+
+	u64 i = c->count;
+	c->change_count += 1;
+	for (u64 j = 0; j < c->column_count; j += 1) {
+		memset(c->columns[j] + i*c->column_sizes[j], 0, c->column_sizes[j]);
+	}
+	c->entities[i] = e;
+	c->sparse[e.index] = (u32)(i+1);
+	c->count += 1;
+	return i;
+}
+
+bool
+entity_remove_component(Entity_Storage *s, Entity_Id e, Component_Id id) {
+	if (!entity_is_alive(s, e)) return false;
+	Component_Storage *c = entity_storage_get_component(s, id);
+	if (!component_storage_has(c, e.index)) return false;
+	component_storage_remove_at(c, c->sparse[e.index]-1);
+	return true;
+}
+
+bool
+entity_has_component(Entity_Storage *s, Entity_Id e, Component_Id id) {
+	return entity_is_alive(s, e) && component_storage_has(entity_storage_get_component(s, id), e.index);
+}
+
+s64
+entity_get_component_index(Entity_Storage *s, Entity_Id e, Component_Id id) {
+	if (!entity_has_component(s, e, id)) return -1;
+	return (s64)s->components[id].sparse[e.index]-1;
+}
+
+void*
+entity_get_field(Entity_Storage *s, Entity_Id e, Component_Id id, u64 column) {
+	s64 i = entity_get_component_index(s, e, id);
+	if (i == -1) return 0;
+	Component_Storage *c = &s->components[id];
+	assert(column < c->column_count, "Component column %llu out of range", column);
+	return c->columns[column] + (u64)i*c->column_sizes[column];
+}
+
+u64
+component_get_count(Entity_Storage *s, Component_Id id) {
+	return entity_storage_get_component(s, id)->count;
+}
+void*
+component_get_column(Entity_Storage *s, Component_Id id, u64 column) {
+	Component_Storage *c = entity_storage_get_component(s, id);
+	assert(column < c->column_count, "Component column %llu out of range", column);
+	return c->columns[column];
+}
+Entity_Id*
+component_get_entities(Entity_Storage *s, Component_Id id) {
+	return entity_storage_get_component(s, id)->entities;
+}
+
+void
+component_storage_swap(Component_Storage *c, u64 a, u64 b) {
+	c->change_count += 1;
+	for (u64 j = 0; j < c->column_count; j += 1) {
+		u64 size = c->column_sizes[j];
+		u8 *pa = c->columns[j] + a*size;
+		u8 *pb = c->columns[j] + b*size;
+		for (u64 k = 0; k < size; k += 1) {
+			u8 t = pa[k];
+			pa[k] = pb[k];
+			pb[k] = t;
+		}
+	}
+	swap(c->entities[a], c->entities[b], Entity_Id);
+	c->sparse[c->entities[a].index] = (u32)(a+1);
+	c->sparse[c->entities[b].index] = (u32)(b+1);
+}
+
+// O(1) if neither changed since the last call with the same a & b
+u64
+components_align(Entity_Storage *s, Component_Id a, Component_Id b) {
+	Component_Storage *ca = entity_storage_get_component(s, a);
+	Component_Storage *cb = entity_storage_get_component(s, b);
+	if (ca == cb) return ca->count;
+	if (ca->aligned_with == b+1 && ca->aligned_change_counts[0] == ca->change_count && ca->aligned_change_counts[1] == cb->change_count) {
+		return ca->aligned_count;
+	}
+
+	u64 n = 0;
+	for (u64 i = 0; i < ca->count; i += 1) {
+		if (!component_storage_has(cb, ca->entities[i].index)) continue;
+		if (i != n) component_storage_swap(ca, i, n);
+		n += 1;
+	}
+	// b[0, i) already holds a[0, i), so a[i] is at i or later in b
+	for (u64 i = 0; i < n; i += 1) {
+		u64 j = cb->sparse[ca->entities[i].index]-1;
+		if (j != i) component_storage_swap(cb, i, j);
+	}
+
+	ca->aligned_with = b+1;
+	ca->aligned_change_counts[0] = ca->change_count;
+	ca->aligned_change_counts[1] = cb->change_count;
+	ca->aligned_count = n;
+	return n;
+}
@@ -158,20 +158,18 @@ typedef struct Emission_Instance {
 	Emission_Config config;
 	Vector2 pos;
 	float32 start_time;
-	bool allocated;
-	u32 generation;
 } Emission_Instance;
 
-typedef struct Emission_Handle {
-	u32 index;
-	u32 generation;
-} Emission_Handle;
+typedef Object_Handle Emission_Handle;
 
 // #Global
 #if OOGABOOGA_LINK_EXTERNAL_INSTANCE
-ogb_instance Emission_Instance *emissions;
+ogb_instance Object_Pool emission_pool;
+ogb_instance Emission_Handle *emission_draw_order;
 #else
-Emission_Instance *emissions;
+Object_Pool emission_pool;
+// Growing array. Emissions draw in the order they were emitted, stale handles are dropped in particles_draw()
+Emission_Handle *emission_draw_order;
 #endif
 
 float32 sample_interp_one(Emission_Interpolation_Kind interp, float32 min, float32 max, float t) {
@@ -268,64 +266,46 @@ Emission_Handle emit_particles(Emission_Config config, Vector2 pos) {
 	config.emissions_per_second = max(config.emissions_per_second, 1);
 	if (config.seed == 0) config.seed = get_random();
 
-	for (u64 i = 0; i < growing_array_get_valid_count(emissions); i += 1) {
-		if (!emissions[i].allocated) {
-			emissions[i] = ZERO(Emission_Instance);
-			emissions[i].config = config;
-			emissions[i].pos = pos;
-			emissions[i].start_time = os_get_elapsed_seconds();
-			emissions[i].allocated = true;
-			emissions[i].generation += 1;
-			
-			return (Emission_Handle) { i, emissions[i].generation };
-		}
-	}
-
-	Emission_Instance inst = ZERO(Emission_Instance);
-	inst.config = config;
-	inst.pos = pos;
-	inst.start_time = os_get_elapsed_seconds();
-	inst.allocated = true;	
-	inst.generation = 0;	
-	growing_array_add((void**)&emissions, &inst);
+	Emission_Handle h;
+	Emission_Instance *e = (Emission_Instance*)object_pool_acquire(&emission_pool, &h);
+	e->config = config;
+	e->pos = pos;
+	e->start_time = os_get_elapsed_seconds();
+	
+	growing_array_add((void**)&emission_draw_order, &h);
 	
-	return (Emission_Handle){ growing_array_get_valid_count(emissions) - 1, 0 };
+	return h;
+}
+
+Emission_Instance *get_emission(Emission_Handle h) {
+	Emission_Instance *e = (Emission_Instance*)object_pool_get(&emission_pool, h);
+	assert(e, "Invalid Emission_Handle; emission has been released");
+	return e;
 }
 
 void emission_reset(Emission_Handle h) {
-	assert(h.index < growing_array_get_valid_count(emissions), "Invalid Emission_Handle");
-	assert(h.generation == emissions[h.index].generation, "Invalid Emission_Handle; emission has been released");
-	
-	Emission_Instance *e = &emissions[h.index];
+	Emission_Instance *e = get_emission(h);
 	e->start_time = os_get_elapsed_seconds();
 }
 
 void emission_set_config(Emission_Handle h, Emission_Config config) {
-	assert(h.index < growing_array_get_valid_count(emissions), "Invalid Emission_Handle");
-	assert(h.generation == emissions[h.index].generation, "Invalid Emission_Handle; emission has been released");
-	
-	Emission_Instance *e = &emissions[h.index];
+	Emission_Instance *e = get_emission(h);
 	
 	e->config = config;
 }
 void emission_set_position(Emission_Handle h, Vector2 pos) {
-	assert(h.index < growing_array_get_valid_count(emissions), "Invalid Emission_Handle");
-	assert(h.generation == emissions[h.index].generation, "Invalid Emission_Handle; emission has been released");
-	
-	Emission_Instance *e = &emissions[h.index];
+	Emission_Instance *e = get_emission(h);
 	
 	e->pos = pos;
 }
 void emission_release(Emission_Handle h) {
-	assert(h.index < growing_array_get_valid_count(emissions), "Invalid Emission_Handle");
-	
-	Emission_Instance *e = &emissions[h.index];
-	
-	if (e->generation == h.generation) e->allocated = false;
+	// Releasing a stale handle is fine, the emission might have died on its own
+	object_pool_release(&emission_pool, h);
 }
 
 void particles_init() {
-	growing_array_init_reserve((void**)&emissions, sizeof(Emission_Instance), 16, get_heap_allocator());
+	object_pool_init(&emission_pool, sizeof(Emission_Instance), 16, get_heap_allocator());
+	growing_array_init((void**)&emission_draw_order, sizeof(Emission_Handle), get_heap_allocator());
 }
 
 void particles_update() {
@@ -340,9 +320,12 @@ void particles_draw() {
 
 	u64 backup_seed = seed_for_random;
 	
-	for (u64 i = 0; i < growing_array_get_valid_count(emissions); i += 1) {
-		Emission_Instance *e = &emissions[i];
-		if (!e->allocated) continue;
+	// Emissions which are released are dropped from the draw order as we go, keeping the rest in order
+	u64 kept_count = 0;
+	for (u64 i = 0; i < growing_array_get_valid_count(emission_draw_order); i += 1) {
+		Emission_Handle h = emission_draw_order[i];
+		Emission_Instance *e = (Emission_Instance*)object_pool_get(&emission_pool, h);
+		if (!e) continue;
 		
 		float32 passed = now - e->start_time;
 		
@@ -359,10 +342,13 @@ void particles_draw() {
 		max_emitted = min(max_emitted, e->config.number_of_particles);
 		
 		if (!e->config.persist && !e->config.loop && passed > last_death_duration) {
-			e->allocated = false;
+			object_pool_release(&emission_pool, h);
 			continue;
 		}
 		
+		emission_draw_order[kept_count] = h;
+		kept_count += 1;
+		
 		seed_for_random = e->config.seed;
 			
 		for (u64 j = 0; j < max_emitted; j += 1) {
@@ -446,6 +432,7 @@ void particles_draw() {
 		
 		
 	}
+	growing_array_resize((void**)&emission_draw_order, kept_count);
 	
 	seed_for_random = backup_seed;
 }
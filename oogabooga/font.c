@@ -115,12 +115,8 @@ typedef struct Gfx_Font {
 	Allocator allocator;
 } Gfx_Font;
 
-Gfx_Font *load_font_from_disk(string path, Allocator allocator) {
-	
-	string font_data;
-	bool read_ok = os_read_entire_file(path, &font_data, allocator);
-	
-	if (!read_ok) return 0;
+// The font keeps font_data and frees it in destroy_font(), so it must be from allocator
+Gfx_Font *load_font_from_memory(string font_data, Allocator allocator) {
 	
 	third_party_allocator = allocator;
 	
@@ -139,6 +135,25 @@ Gfx_Font *load_font_from_disk(string path, Allocator allocator) {
 	
 	return font;
 }
+Gfx_Font *load_font_from_disk(string path, Allocator allocator) {
+	
+	string font_data;
+	bool read_ok = os_read_entire_file(path, &font_data, allocator);
+	
+	if (!read_ok) return 0;
+	
+	return load_font_from_memory(font_data, allocator);
+}
+// Only from inside a task (task.c). The file is read on the job system while the task waits.
+Gfx_Font *task_load_font_from_disk(string path, Allocator allocator) {
+	
+	string font_data;
+	bool read_ok = task_read_entire_file(path, &font_data, allocator);
+	
+	if (!read_ok) return 0;
+	
+	return load_font_from_memory(font_data, allocator);
+}
 void destroy_font(Gfx_Font *font) {
 
 	third_party_allocator = font->allocator;
@@ -58,8 +58,9 @@ ID3D11Buffer *d3d11_quad_ibo = 0;
 u32 d3d11_quad_vbo_size = 0;
 void *d3d11_staging_quad_buffer = 0;
 
-Draw_Quad *d3d11_sort_quad_buffer = 0;
-u64 d3d11_sort_quad_buffer_size = 0;
+// Sort keys for z sorting, and the radix sort's help buffer right after them
+u64 *d3d11_sort_keys = 0;
+u64 d3d11_sort_keys_capacity = 0;
 
 u64 d3d11_thread_id = 0;
 
@@ -729,19 +730,26 @@ void gfx_render_draw_frame(Draw_Frame *frame, Gfx_Image *render_target) {
 		// here on the main thread.
 		//
 		{
+			// Sort (z, index) keys instead of the quads themselves, and read the quads in
+			// sorted order through the indices
 			if (frame->enable_z_sorting) {
-				if (!d3d11_sort_quad_buffer || (d3d11_sort_quad_buffer_size < number_of_quads*sizeof(Draw_Quad))) {
+				if (d3d11_sort_keys_capacity < number_of_quads) {
 					// #Memory #Heapalloc
-					if (d3d11_sort_quad_buffer) dealloc(get_heap_allocator(), d3d11_sort_quad_buffer);
-					d3d11_sort_quad_buffer = alloc(get_heap_allocator(), number_of_quads*sizeof(Draw_Quad));
-					d3d11_sort_quad_buffer_size = number_of_quads*sizeof(Draw_Quad);
+					if (d3d11_sort_keys) dealloc(get_heap_allocator(), d3d11_sort_keys);
+					d3d11_sort_keys = (u64*)alloc(get_heap_allocator(), number_of_quads*2*sizeof(u64));
+					d3d11_sort_keys_capacity = number_of_quads;
 				}
-				radix_sort(frame->quad_buffer, d3d11_sort_quad_buffer, number_of_quads, sizeof(Draw_Quad), offsetof(Draw_Quad, z), MAX_Z_BITS);
+				for (u64 i = 0; i < number_of_quads; i++) {
+					// z is in [-MAX_Z+1, MAX_Z], so biased by MAX_Z it's at most 2*MAX_Z which takes one more bit
+					d3d11_sort_keys[i] = make_sort_key((u32)(frame->quad_buffer[i].z + MAX_Z), (u32)i);
+				}
+				parallel_radix_sort_keys(d3d11_sort_keys, d3d11_sort_keys + number_of_quads, number_of_quads, MAX_Z_BITS+1);
 			}
 		
 			for (u64 i = 0; i < number_of_quads; i++)  {
 				
-				Draw_Quad *q = &frame->quad_buffer[i];
+				u64 quad_index = frame->enable_z_sorting ? sort_key_get_index(d3d11_sort_keys[i]) : i;
+				Draw_Quad *q = &frame->quad_buffer[quad_index];
 				
 				assert(q->z <= MAX_Z, "Z is too high. Z is %d, Max is %d.", q->z, MAX_Z);
 				assert(q->z >= (-MAX_Z+1), "Z is too low. Z is %d, Min is %d.", q->z, -MAX_Z+1);
@@ -118,11 +118,8 @@ Gfx_Image *make_image_render_target(u32 width, u32 height, u32 channels, void *i
     return image;
 }
 
-Gfx_Image *load_image_from_disk(string path, Allocator allocator) {
-    string png;
-    bool ok = os_read_entire_file(path, &png, allocator);
-    if (!ok) return 0;
-
+// png is any format stb_image reads, and isn't kept
+Gfx_Image *load_image_from_memory(string png, Allocator allocator) {
     Gfx_Image *image = alloc(allocator, sizeof(Gfx_Image));
     
     int width, height, channels;
@@ -133,7 +130,7 @@ Gfx_Image *load_image_from_disk(string path, Allocator allocator) {
     
     if (!stb_data) {
         dealloc(allocator, image);
-        dealloc_string(allocator, png);
+        third_party_allocator = ZERO(Allocator);
         return 0;
     }
     
@@ -142,8 +139,6 @@ Gfx_Image *load_image_from_disk(string path, Allocator allocator) {
     image->gfx_handle = GFX_INVALID_HANDLE;  // This is handled in gfx
     image->allocator = allocator;
     image->channels = 4;
-
-    dealloc_string(allocator, png);
     
     gfx_init_image(image, stb_data, false);
     
@@ -154,6 +149,28 @@ Gfx_Image *load_image_from_disk(string path, Allocator allocator) {
     return image;
 }
 
+Gfx_Image *load_image_from_disk(string path, Allocator allocator) {
+    string png;
+    bool ok = os_read_entire_file(path, &png, allocator);
+    if (!ok) return 0;
+
+    Gfx_Image *image = load_image_from_memory(png, allocator);
+    dealloc_string(allocator, png);
+    return image;
+}
+
+// Only from inside a task (task.c). The file is read on the job system while the task
+// waits, decoding & uploading happen on the task's thread.
+Gfx_Image *task_load_image_from_disk(string path, Allocator allocator) {
+    string png;
+    bool ok = task_read_entire_file(path, &png, allocator);
+    if (!ok) return 0;
+
+    Gfx_Image *image = load_image_from_memory(png, allocator);
+    dealloc_string(allocator, png);
+    return image;
+}
+
 void 
 delete_image(Gfx_Image *image) {
       // Free the image data allocated by stb_image
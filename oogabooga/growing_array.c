@@ -120,16 +120,17 @@ growing_array_reserve(void **array, u64 count_to_reserve) {
     u64 old_allocated_bytes = header->allocated_count*header->block_size_in_bytes+sizeof(Growing_Array_Header);
     count_to_reserve = get_next_power_of_two(count_to_reserve);
     u64 bytes_to_allocate = count_to_reserve*header->block_size_in_bytes+sizeof(Growing_Array_Header);
-    Growing_Array_Header *new_header = (Growing_Array_Header*)alloc(header->allocator, bytes_to_allocate);
     
-    memcpy(new_header, header, old_allocated_bytes);
+    // Allocator might be able to grow it in place
+    Growing_Array_Header *new_header = (Growing_Array_Header*)reallocate(header->allocator, header, bytes_to_allocate);
     
+#if DO_ZERO_INITIALIZATION
+    memset((u8*)new_header + old_allocated_bytes, 0, bytes_to_allocate - old_allocated_bytes);
+#endif
     
     *array = new_header+1;
     
     new_header->allocated_count = count_to_reserve;
-    
-    dealloc(header->allocator, header);
 }
 
 void*
@@ -25,7 +25,11 @@ static inline u64 city_hash(string s) {
     u64 c = 9;
     u64 d = b;
 
-    if (s.count <= 16) {
+    if (s.count < 8) {
+        // Don't read outside of the string
+        a = 0;
+        memcpy(&a, s.data, s.count);
+    } else if (s.count <= 16) {
         memcpy(&a, s.data, sizeof(u64));
         memcpy(&b, s.data + s.count - 8, sizeof(u64));
     } else {
@@ -54,9 +58,185 @@ u64 djb2_hash(string s) {
     return hash;
 }
 
+///
+// hash_bytes
+// Hashes all of the input. Short inputs are mixed with 64x64->128 bit multiplies (like
+// wyhash), long inputs go through 8 lanes of 64-byte stripes (like xxh3) which are done
+// with SSE2 or AVX2 when enabled. All paths give the same hash.
+
+#define HASH_STRIPE_SIZE 64
+#define HASH_STRIPES_PER_SCRAMBLE 8
+// Inputs longer than this go through the stripe loop
+#define HASH_BULK_THRESHOLD 256
+
+#define PRIME32_1 0x9E3779B1ULL
+#define PRIME32_2 0x85EBCA77ULL
+#define PRIME32_3 0xC2B2AE3DULL
+
+// Stripe n is keyed with hash_secret[n % 8 .. n % 8 + 8], scrambles use hash_secret[8 .. 16]
+alignat(32) static const u64 hash_secret[16] = {
+	0x80023a41b9eb08fbULL, 0x2bac4bd0507c31d9ULL, 0xac33576cba14ab53ULL, 0x66404e36155a0cddULL,
+	0xdc60739d8b003695ULL, 0x3e2e593b79c1db6bULL, 0xd9479db4f01f2a23ULL, 0x4d1fbf02f007b101ULL,
+	0xe0b3ebf48515850fULL, 0x7936eecb58dca07bULL, 0x4668d89176d955ddULL, 0xec6f89fd354de2abULL,
+	0xe03e5903e1e8d6fdULL, 0xa5abbd69b96320afULL, 0xe28b1071cf82cfdbULL, 0x1fc70884aa384b3bULL,
+};
+
+static inline u64 hash_read64(u8 *p) { u64 v; memcpy(&v, p, sizeof(u64)); return v; }
+static inline u64 hash_read32(u8 *p) { u32 v; memcpy(&v, p, sizeof(u32)); return v; }
+
+static inline void hash_mul_128(u64 *a, u64 *b) {
+#if COMPILER_MSVC
+	u64 hi;
+	*a = _umul128(*a, *b, &hi);
+	*b = hi;
+#else
+	__uint128_t r = (__uint128_t)*a * *b;
+	*a = (u64)r;
+	*b = (u64)(r >> 64);
+#endif
+}
+static inline u64 hash_mix(u64 a, u64 b) {
+	hash_mul_128(&a, &b);
+	return a ^ b;
+}
+
+// Lane i: acc[i^1] += data, acc[i] += lo32(data^key) * hi32(data^key)
+static inline void hash_accumulate_stripe(u64 *acc, u8 *p, const u64 *key) {
+#if ENABLE_SIMD && SIMD_ENABLE_AVX2
+	for (u64 i = 0; i < 8; i += 4) {
+		__m256i a = _mm256_load_si256((__m256i*)(acc+i));
+		__m256i d = _mm256_loadu_si256((__m256i*)(p+i*8));
+		__m256i k = _mm256_xor_si256(d, _mm256_loadu_si256((__m256i*)(key+i)));
+		__m256i product = _mm256_mul_epu32(k, _mm256_shuffle_epi32(k, _MM_SHUFFLE(0, 3, 0, 1)));
+		a = _mm256_add_epi64(a, _mm256_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2)));
+		_mm256_store_si256((__m256i*)(acc+i), _mm256_add_epi64(a, product));
+	}
+#elif ENABLE_SIMD && SIMD_ENABLE_SSE2
+	for (u64 i = 0; i < 8; i += 2) {
+		__m128i a = _mm_load_si128((__m128i*)(acc+i));
+		__m128i d = _mm_loadu_si128((__m128i*)(p+i*8));
+		__m128i k = _mm_xor_si128(d, _mm_loadu_si128((__m128i*)(key+i)));
+		__m128i product = _mm_mul_epu32(k, _mm_shuffle_epi32(k, _MM_SHUFFLE(0, 3, 0, 1)));
+		a = _mm_add_epi64(a, _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2)));
+		_mm_store_si128((__m128i*)(acc+i), _mm_add_epi64(a, product));
+	}
+#else
+	for (u64 i = 0; i < 8; i += 1) {
+		u64 d = hash_read64(p+i*8);
+		u64 k = d ^ key[i];
+		acc[i^1] += d;
+		acc[i] += (k & 0xFFFFFFFF) * (k >> 32);
+	}
+#endif
+}
+
+// acc = (acc ^ (acc >> 47) ^ key) * PRIME32_1
+static inline void hash_scramble(u64 *acc, const u64 *key) {
+#if ENABLE_SIMD && SIMD_ENABLE_AVX2
+	__m256i prime = _mm256_set1_epi32((int)PRIME32_1);
+	for (u64 i = 0; i < 8; i += 4) {
+		__m256i a = _mm256_load_si256((__m256i*)(acc+i));
+		a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+		a = _mm256_xor_si256(a, _mm256_loadu_si256((__m256i*)(key+i)));
+		__m256i lo = _mm256_mul_epu32(a, prime);
+		__m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), prime);
+		_mm256_store_si256((__m256i*)(acc+i), _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32)));
+	}
+#elif ENABLE_SIMD && SIMD_ENABLE_SSE2
+	__m128i prime = _mm_set1_epi32((int)PRIME32_1);
+	for (u64 i = 0; i < 8; i += 2) {
+		__m128i a = _mm_load_si128((__m128i*)(acc+i));
+		a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+		a = _mm_xor_si128(a, _mm_loadu_si128((__m128i*)(key+i)));
+		__m128i lo = _mm_mul_epu32(a, prime);
+		__m128i hi = _mm_mul_epu32(_mm_srli_epi64(a, 32), prime);
+		_mm_store_si128((__m128i*)(acc+i), _mm_add_epi64(lo, _mm_slli_epi64(hi, 32)));
+	}
+#else
+	for (u64 i = 0; i < 8; i += 1) {
+		u64 a = acc[i];
+		a ^= a >> 47;
+		a ^= key[i];
+		acc[i] = a * PRIME32_1;
+	}
+#endif
+}
+
+u64 hash_bulk(u8 *p, u64 count) {
+	alignat(32) u64 acc[8] = {
+		PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3, PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1
+	};
+
+	// The last stripe is always hashed separately, overlapping if it's partial
+	u64 stripe_count = (count-1)/HASH_STRIPE_SIZE;
+	for (u64 n = 0; n < stripe_count; n += 1) {
+		hash_accumulate_stripe(acc, p + n*HASH_STRIPE_SIZE, hash_secret + n%HASH_STRIPES_PER_SCRAMBLE);
+		if (n%HASH_STRIPES_PER_SCRAMBLE == HASH_STRIPES_PER_SCRAMBLE-1) {
+			hash_scramble(acc, hash_secret + 8);
+		}
+	}
+	hash_accumulate_stripe(acc, p + count - HASH_STRIPE_SIZE, hash_secret + 7);
+
+	u64 result = count*PRIME64_1;
+	for (u64 i = 0; i < 8; i += 2) {
+		result += hash_mix(acc[i] ^ hash_secret[i], acc[i+1] ^ hash_secret[i+1]);
+	}
+	return result;
+}
+
+u64 hash_bytes(void *data, u64 count, u64 seed) {
+	u8 *p = (u8*)data;
+	seed ^= hash_secret[0];
+
+	u64 a, b;
+	if (count <= 16) {
+		if (count >= 4) {
+			// Two overlapping reads from each end covers every byte
+			u64 middle = (count >> 3) << 2;
+			a = (hash_read32(p) << 32) | hash_read32(p + middle);
+			b = (hash_read32(p + count - 4) << 32) | hash_read32(p + count - 4 - middle);
+		} else if (count > 0) {
+			a = ((u64)p[0] << 16) | ((u64)p[count >> 1] << 8) | p[count-1];
+			b = 0;
+		} else {
+			a = 0;
+			b = 0;
+		}
+	} else if (count <= HASH_BULK_THRESHOLD) {
+		u64 i = count;
+		if (i > 48) {
+			u64 seed1 = seed;
+			u64 seed2 = seed;
+			do {
+				seed  = hash_mix(hash_read64(p)    ^ hash_secret[1], hash_read64(p+8)  ^ seed);
+				seed1 = hash_mix(hash_read64(p+16) ^ hash_secret[2], hash_read64(p+24) ^ seed1);
+				seed2 = hash_mix(hash_read64(p+32) ^ hash_secret[3], hash_read64(p+40) ^ seed2);
+				p += 48;
+				i -= 48;
+			} while (i > 48);
+			seed ^= seed1 ^ seed2;
+		}
+		while (i > 16) {
+			seed = hash_mix(hash_read64(p) ^ hash_secret[1], hash_read64(p+8) ^ seed);
+			p += 16;
+			i -= 16;
+		}
+		a = hash_read64(p + i - 16);
+		b = hash_read64(p + i - 8);
+	} else {
+		seed ^= hash_bulk(p, count);
+		a = hash_read64(p + count - 16);
+		b = hash_read64(p + count - 8);
+	}
+
+	a ^= hash_secret[1];
+	b ^= seed;
+	hash_mul_128(&a, &b);
+	return hash_mix(a ^ hash_secret[0] ^ count, b ^ hash_secret[1]);
+}
+
 u64 string_get_hash(string s) {
-    if (s.count > 32) return djb2_hash(s);
-    return city_hash(s);
+    return hash_bytes(s.data, s.count, 0);
 }
 u64 pointer_get_hash(void *p) {
 	return xx_hash((u64)p);
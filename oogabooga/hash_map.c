@@ -0,0 +1,334 @@
+
+// Hash map for hot lookup tables, in the style of Swiss tables.
+// Next to each slot there's a control byte which is either empty, deleted, or the low 7
+// bits of the slot's hash. Lookups compare a whole group of 16 control bytes at once
+// (one SSE2 compare when SIMD_ENABLE_SSE2), so most lookups touch one cache line of
+// control bytes and then the one slot that actually matches, even when the map is
+// 7/8 full.
+// Unlike Hash_Table, entries are not kept dense and are not in insertion order. Iterate
+// with hash_map_iterate().
+
+/*
+
+	Example Usage:
+
+	Hash_Map map = make_hash_map(u64, Entity*, get_heap_allocator());
+
+	u64 id = 1234;
+	Entity *e = ...;
+	hash_map_set(&map, id, e);
+
+	Entity **found = hash_map_find(&map, id);
+
+	hash_map_remove(&map, id);
+
+	u64 iterator = 0;
+	u64 *key;
+	Entity **value;
+	while (hash_map_iterate(&map, &iterator, (void**)&key, (void**)&value)) {
+
+	}
+
+	hash_map_destroy(&map);
+
+	Limitations are the same as Hash_Table's (keys and values passed to the macros need to be lvalues).
+*/
+
+typedef struct Hash_Map Hash_Map;
+
+// API:
+#define make_hash_map_reserve(Key_Type, Value_Type, capacity_count, allocator) \
+	make_hash_map_raw(sizeof(Key_Type), sizeof(Value_Type), capacity_count, hash_table_get_key_equals_proc(Key_Type), allocator)
+
+#define make_hash_map(Key_Type, Value_Type, allocator) \
+	make_hash_map_raw(sizeof(Key_Type), sizeof(Value_Type), 0, hash_table_get_key_equals_proc(Key_Type), allocator)
+
+#define hash_map_set(map_ptr, key, value) \
+	hash_map_set_raw((map_ptr), get_hash(key), &(key), &(value), sizeof(key), sizeof(value))
+
+#define hash_map_find(map_ptr, key) \
+	hash_map_find_raw((map_ptr), get_hash(key), &(key), sizeof(key))
+
+#define hash_map_contains(map_ptr, key) \
+	(hash_map_find_raw((map_ptr), get_hash(key), &(key), sizeof(key)) != 0)
+
+#define hash_map_remove(map_ptr, key) \
+	hash_map_remove_raw((map_ptr), get_hash(key), &(key), sizeof(key))
+
+#define HASH_MAP_GROUP_WIDTH 16
+#define HASH_MAP_CTRL_EMPTY   ((u8)0x80)
+#define HASH_MAP_CTRL_DELETED ((u8)0xFE)
+// Anything else is a full slot, with the low 7 bits of its hash
+
+typedef struct Hash_Map {
+	// capacity + HASH_MAP_GROUP_WIDTH control bytes. The last group mirrors the first
+	// one, so a group can be loaded at any slot index without wrapping around.
+	u8 *ctrl;
+	// Each slot is hash-key-value, each aligned to 8 bytes
+	u8 *slots;
+
+	u64 count;
+	u64 capacity; // Power of two, 0 until something is added
+	u64 growth_left; // Inserts until we need to rehash, counting deleted slots as used
+
+	u64 _key_size;
+	u64 _value_size;
+	u64 _slot_size;
+	u64 _value_offset;
+
+	Hash_Table_Key_Equals_Proc key_equals;
+
+	Allocator allocator;
+} Hash_Map;
+
+#define HASH_MAP_KEY_OFFSET sizeof(u64)
+
+void hash_map_rehash(Hash_Map *map, u64 new_capacity);
+
+Hash_Map make_hash_map_raw(u64 key_size, u64 value_size, u64 capacity_count, Hash_Table_Key_Equals_Proc key_equals, Allocator allocator) {
+	Hash_Map map = ZERO(Hash_Map);
+
+	map._key_size = key_size;
+	map._value_size = value_size;
+	map._value_offset = HASH_MAP_KEY_OFFSET + align_next(key_size, 8);
+	map._slot_size = map._value_offset + align_next(value_size, 8);
+	map.key_equals = key_equals ? key_equals : hash_table_bytes_match;
+	map.allocator = allocator;
+
+	if (capacity_count) {
+		hash_map_rehash(&map, max(get_next_power_of_two(capacity_count*8/7 + 1), HASH_MAP_GROUP_WIDTH));
+	}
+
+	return map;
+}
+
+void hash_map_destroy(Hash_Map *map) {
+	if (map->ctrl) {
+		dealloc(map->allocator, map->ctrl);
+		dealloc(map->allocator, map->slots);
+	}
+	map->ctrl = 0;
+	map->slots = 0;
+	map->count = 0;
+	map->capacity = 0;
+	map->growth_left = 0;
+}
+
+void hash_map_reset(Hash_Map *map) {
+	if (map->ctrl) memset(map->ctrl, HASH_MAP_CTRL_EMPTY, map->capacity + HASH_MAP_GROUP_WIDTH);
+	map->count = 0;
+	map->growth_left = map->capacity - map->capacity/8;
+}
+
+inline u8 *hash_map_get_slot(Hash_Map *map, u64 index) {
+	return map->slots + index*map->_slot_size;
+}
+inline u8 hash_map_get_h2(u64 hash) {
+	return (u8)(hash & 0x7F);
+}
+inline u64 hash_map_get_h1(u64 hash) {
+	return hash >> 7;
+}
+
+inline void hash_map_set_ctrl(Hash_Map *map, u64 index, u8 ctrl) {
+	map->ctrl[index] = ctrl;
+	// Keep the mirrored group in sync
+	if (index < HASH_MAP_GROUP_WIDTH) map->ctrl[map->capacity + index] = ctrl;
+}
+
+// Bit i is set if control byte i in the group at ctrl equals h2
+inline u32 hash_map_group_match(u8 *ctrl, u8 h2) {
+#if ENABLE_SIMD && SIMD_ENABLE_SSE2
+	__m128i group = _mm_loadu_si128((__m128i*)ctrl);
+	return (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)h2)));
+#else
+	u32 mask = 0;
+	for (u32 i = 0; i < HASH_MAP_GROUP_WIDTH; i += 1) {
+		if (ctrl[i] == h2) mask |= 1u << i;
+	}
+	return mask;
+#endif
+}
+// Bit i is set if control byte i in the group at ctrl is empty or deleted (high bit is set)
+inline u32 hash_map_group_match_empty_or_deleted(u8 *ctrl) {
+#if ENABLE_SIMD && SIMD_ENABLE_SSE2
+	return (u32)_mm_movemask_epi8(_mm_loadu_si128((__m128i*)ctrl));
+#else
+	u32 mask = 0;
+	for (u32 i = 0; i < HASH_MAP_GROUP_WIDTH; i += 1) {
+		if (ctrl[i] & 0x80) mask |= 1u << i;
+	}
+	return mask;
+#endif
+}
+
+// Groups are probed quadratically (triangular numbers), which visits every group
+// when the capacity is a power of two.
+// Returns the slot index, or -1 if the key is not in the map.
+s64 hash_map_find_index(Hash_Map *map, u64 hash, void *k) {
+	if (!map->capacity) return -1;
+
+	u64 mask = map->capacity-1;
+	u8 h2 = hash_map_get_h2(hash);
+	u64 pos = hash_map_get_h1(hash) & mask;
+
+	for (u64 probe = 0; probe <= map->capacity/HASH_MAP_GROUP_WIDTH; probe += 1) {
+		u8 *group = map->ctrl + pos;
+
+		u32 matches = hash_map_group_match(group, h2);
+		while (matches) {
+			u64 index = (pos + bit_scan_forward_64(matches)) & mask;
+			u8 *slot = hash_map_get_slot(map, index);
+			if (*(u64*)slot == hash && map->key_equals(slot+HASH_MAP_KEY_OFFSET, k, map->_key_size)) {
+				return (s64)index;
+			}
+			matches &= matches-1;
+		}
+
+		if (hash_map_group_match(group, HASH_MAP_CTRL_EMPTY)) return -1;
+
+		pos = (pos + (probe+1)*HASH_MAP_GROUP_WIDTH) & mask;
+	}
+	return -1;
+}
+
+// First empty or deleted slot on the probe sequence for hash
+u64 hash_map_find_insert_index(Hash_Map *map, u64 hash) {
+	u64 mask = map->capacity-1;
+	u64 pos = hash_map_get_h1(hash) & mask;
+
+	for (u64 probe = 0;; probe += 1) {
+		u32 available = hash_map_group_match_empty_or_deleted(map->ctrl + pos);
+		if (available) return (pos + bit_scan_forward_64(available)) & mask;
+
+		pos = (pos + (probe+1)*HASH_MAP_GROUP_WIDTH) & mask;
+	}
+}
+
+void hash_map_rehash(Hash_Map *map, u64 new_capacity) {
+	assert(new_capacity >= HASH_MAP_GROUP_WIDTH && (new_capacity & (new_capacity-1)) == 0, "Hash map capacity must be a power of two of at least HASH_MAP_GROUP_WIDTH");
+
+	u8 *old_ctrl = map->ctrl;
+	u8 *old_slots = map->slots;
+	u64 old_capacity = map->capacity;
+
+	map->ctrl = (u8*)alloc(map->allocator, new_capacity + HASH_MAP_GROUP_WIDTH);
+	map->slots = (u8*)alloc(map->allocator, new_capacity*map->_slot_size);
+	map->capacity = new_capacity;
+	memset(map->ctrl, HASH_MAP_CTRL_EMPTY, new_capacity + HASH_MAP_GROUP_WIDTH);
+	map->growth_left = new_capacity - new_capacity/8 - map->count;
+
+	// Hashes are stored, so nothing needs to be hashed again
+	for (u64 i = 0; i < old_capacity; i += 1) {
+		if (old_ctrl[i] & 0x80) continue;
+
+		u8 *old_slot = old_slots + i*map->_slot_size;
+		u64 hash = *(u64*)old_slot;
+		u64 index = hash_map_find_insert_index(map, hash);
+		hash_map_set_ctrl(map, index, hash_map_get_h2(hash));
+		memcpy(hash_map_get_slot(map, index), old_slot, map->_slot_size);
+	}
+
+	if (old_ctrl) {
+		dealloc(map->allocator, old_ctrl);
+		dealloc(map->allocator, old_slots);
+	}
+}
+
+void hash_map_reserve(Hash_Map *map, u64 required_count) {
+	if (required_count <= map->count + map->growth_left) return;
+	hash_map_rehash(map, max(get_next_power_of_two(required_count*8/7 + 1), HASH_MAP_GROUP_WIDTH));
+}
+
+// Claims a slot for a key which is not in the map and stores the hash in it.
+// Returns the slot, the caller writes the key & value.
+u8 *hash_map_insert_new(Hash_Map *map, u64 hash) {
+	if (!map->growth_left) {
+		// If it's mostly deleted slots, a rehash at the same size is enough to clean them up
+		u64 new_capacity = map->capacity;
+		if (!new_capacity) new_capacity = HASH_MAP_GROUP_WIDTH;
+		else if (map->count*16 > map->capacity*7) new_capacity *= 2;
+		hash_map_rehash(map, new_capacity);
+	}
+
+	u64 index = hash_map_find_insert_index(map, hash);
+	if (map->ctrl[index] == HASH_MAP_CTRL_EMPTY) map->growth_left -= 1;
+	hash_map_set_ctrl(map, index, hash_map_get_h2(hash));
+	map->count += 1;
+
+	u8 *slot = hash_map_get_slot(map, index);
+	memcpy(slot, &hash, sizeof(u64));
+	return slot;
+}
+
+// Returns true if key was newly added or false if it already existed
+bool hash_map_set_raw(Hash_Map *map, u64 hash, void *k, void *v, u64 key_size, u64 value_size) {
+	assert(map->_key_size == key_size, "Key type size does not match hash map initted key type size");
+	assert(map->_value_size == value_size, "Value type size does not match hash map initted value type size");
+
+	s64 existing = hash_map_find_index(map, hash, k);
+	if (existing != -1) {
+		memcpy(hash_map_get_slot(map, (u64)existing) + map->_value_offset, v, value_size);
+		return false;
+	}
+
+	u8 *slot = hash_map_insert_new(map, hash);
+	memcpy(slot+HASH_MAP_KEY_OFFSET, k, key_size);
+	memcpy(slot+map->_value_offset,  v, value_size);
+
+	return true;
+}
+
+void *hash_map_find_raw(Hash_Map *map, u64 hash, void *k, u64 key_size) {
+	assert(map->_key_size == key_size, "Key type size does not match hash map initted key type size");
+
+	s64 index = hash_map_find_index(map, hash, k);
+	if (index == -1) return 0;
+	return hash_map_get_slot(map, (u64)index) + map->_value_offset;
+}
+
+void hash_map_erase_index(Hash_Map *map, u64 index) {
+	assert(index < map->capacity && !(map->ctrl[index] & 0x80), "Hash map slot is not full");
+
+	// If the run of non-empty slots through this one is shorter than a group, no group a
+	// probe has loaded over this slot was ever without an empty slot, so no probe went past
+	// it. Then it can be empty again instead of a tombstone.
+	u32 empty_after  = hash_map_group_match(map->ctrl + index, HASH_MAP_CTRL_EMPTY);
+	u32 empty_before = hash_map_group_match(map->ctrl + ((index - HASH_MAP_GROUP_WIDTH) & (map->capacity-1)), HASH_MAP_CTRL_EMPTY);
+	u64 full_after  = empty_after  ? bit_scan_forward_64(empty_after) : HASH_MAP_GROUP_WIDTH;
+	u64 full_before = empty_before ? HASH_MAP_GROUP_WIDTH-1 - bit_scan_reverse_64(empty_before) : HASH_MAP_GROUP_WIDTH;
+	if (full_after + full_before < HASH_MAP_GROUP_WIDTH) {
+		hash_map_set_ctrl(map, index, HASH_MAP_CTRL_EMPTY);
+		map->growth_left += 1;
+	} else {
+		hash_map_set_ctrl(map, index, HASH_MAP_CTRL_DELETED);
+	}
+	map->count -= 1;
+}
+
+// Returns false if the key was not in the map
+bool hash_map_remove_raw(Hash_Map *map, u64 hash, void *k, u64 key_size) {
+	assert(map->_key_size == key_size, "Key type size does not match hash map initted key type size");
+
+	s64 index = hash_map_find_index(map, hash, k);
+	if (index == -1) return false;
+
+	hash_map_erase_index(map, (u64)index);
+
+	return true;
+}
+
+// Start with *iterator = 0. key and value may be 0.
+bool hash_map_iterate(Hash_Map *map, u64 *iterator, void **key, void **value) {
+	for (u64 i = *iterator; i < map->capacity; i += 1) {
+		if (map->ctrl[i] & 0x80) continue;
+
+		u8 *slot = hash_map_get_slot(map, i);
+		if (key)   *key   = slot + HASH_MAP_KEY_OFFSET;
+		if (value) *value = slot + map->_value_offset;
+		*iterator = i+1;
+		return true;
+	}
+	*iterator = map->capacity;
+	return false;
+}
@@ -1,218 +1,342 @@
 
-// Very naive implementation but it should be very cache efficient so it's alright
-// for non-excessive use for now.
+// Open addressing hash table.
+// Entries (hash, key, value) are kept in one dense array so they can be iterated with
+// hash_table_get_nth_value(). A separate power of two array of slots indexes into them
+// with linear probing, and is rebuilt bigger when it gets more than 3/4 full.
+// Removing moves the last entry into the removed entry's place, and shifts back the slots
+// after it so there are no tombstones.
 
 /*
 
 	Example Usage:
-	
-	
+
+
 	// Make a table with key type 'string' and value type 'int', allocated on the heap
 	Hash_Table table = make_hash_table(string, int, get_heap_allocator());
-	
+
 	// Set key "Key string" to integer value 69. This returns whether or not key was newly added.
 	string key = STR("Key string");
 	bool newly_added = hash_table_set(&table, key, 69);
-	
+
 	// Find value associated with given key. Returns pointer to that value.
 	string other_key = STR("Some other key");
 	int* value = hash_table_find(&table, other_key);
-	
+
 	if (value) {
 		// Pointer is OK, item with key exists
 	} else {
 		// Pointer is null, item with key does NOT exist
 	}
-	
+
 	// Same as hash_table_find() != NULL
 	string another_key = STR("Another key");
 	if (hash_table_contains(&table, another_key)) {
-		
+
+	}
+
+	// Remove the entry with the key. Returns false if there was none.
+	hash_table_remove(&table, key);
+
+	// Iterate all entries
+	for (u64 i = 0; i < table.count; i += 1) {
+		string *k = hash_table_get_nth_key(&table, i);
+		int *v = hash_table_get_nth_value(&table, i);
 	}
-	
+
 	// Reset all entries (but keep allocated memory)
 	hash_table_reset(&table);
-	
+
 	// Free allocated entries in hash table
 	hash_table_destroy(&table);
-	
-	
+
+
 	Limitations:
-		- Key can only be a base type or pointer
+		- Key can only be a base type, pointer or string.
+		  Keys are compared byte for byte, except strings which are compared with strings_match.
+		  Set table.key_equals for anything else.
+		- Keys are stored by value, so the memory a string key points to must outlive the entry.
+		- Pointers from hash_table_find() & hash_table_get_nth_value() are invalidated by
+		  adding or removing entries.
 		- Key and value passed to the following function needs to be lvalues (we need to be able to take their addresses with '&'):
 			- hash_table_add
 			- hash_table_find
 			- hash_table_contains
 			- hash_table_set
-			
+			- hash_table_remove
+
 			Example:
-			
+
 			hash_table_set(&table, my_key+5, my_value+3); // ERROR
-			
+
 			int key = my_key+5;
 			int value = my_value+3;
 			hash_table_set(&table, key, value); // OK
-			
+
 
 */
 
 typedef struct Hash_Table Hash_Table;
 
+typedef bool(*Hash_Table_Key_Equals_Proc)(void *a, void *b, u64 key_size);
+
 // API:
 #define make_hash_table_reserve(Key_Type, Value_Type, capacity_count, allocator) \
-	make_hash_table_reserve(sizeof(Key_Type), sizeof(Value_Type), capacity_count, allocator)
-	
+	make_hash_table_reserve_with_equals(sizeof(Key_Type), sizeof(Value_Type), capacity_count, hash_table_get_key_equals_proc(Key_Type), allocator)
+
 #define make_hash_table(Key_Type, Value_Type, allocator) \
-	make_hash_table_raw(sizeof(Key_Type), sizeof(Value_Type), allocator)
+	make_hash_table_reserve_with_equals(sizeof(Key_Type), sizeof(Value_Type), 128, hash_table_get_key_equals_proc(Key_Type), allocator)
 
 #define hash_table_add(table_ptr, key, value) \
 	hash_table_add_raw((table_ptr), get_hash(key), &(key), &(value), sizeof(key), sizeof(value))
 
 #define hash_table_find(table_ptr, key) \
-	hash_table_find_raw((table_ptr), get_hash(key))
-	
+	hash_table_find_raw((table_ptr), get_hash(key), &(key), sizeof(key))
+
 #define hash_table_contains(table_ptr, key) \
-	hash_table_contains_raw((table_ptr), get_hash(key))
-	
+	hash_table_contains_raw((table_ptr), get_hash(key), &(key), sizeof(key))
+
 #define hash_table_set(table_ptr, key, value) \
 	hash_table_set_raw((table_ptr), get_hash(key), &key, &value, sizeof(key), sizeof(value))
 
+#define hash_table_remove(table_ptr, key) \
+	hash_table_remove_raw((table_ptr), get_hash(key), &(key), sizeof(key))
+
 void hash_table_reserve(Hash_Table *t, u64 required_count);
 
+bool hash_table_bytes_match(void *a, void *b, u64 key_size) {
+	return memcmp(a, b, key_size) == 0;
+}
+bool hash_table_strings_match(void *a, void *b, u64 key_size) {
+	return strings_match(*(string*)a, *(string*)b);
+}
+// The expression is never evaluated, _Generic only looks at its type
+#define hash_table_get_key_equals_proc(Key_Type) _Generic(*(Key_Type*)0, \
+		string: hash_table_strings_match, \
+		default: hash_table_bytes_match \
+	)
+
+#define HASH_TABLE_MIN_SLOT_COUNT 16
 
 typedef struct Hash_Table {
-	
+
 	// Each entry is hash-key-value
-	// Hash is sizeof(u64) bytes, key is _key_size bytes and value is _value_size bytes
-	void *entries; 
-	
+	// Hash is sizeof(u64) bytes, key is _key_size bytes and value is _value_size bytes,
+	// each aligned to 8 bytes.
+	void *entries;
+
 	u64 count; // Number of valid entries
 	u64 capacity_count; // Number of allocated entries
-	
+
+	// (entry index+1) << 32 | high 32 bits of the hash. 0 for an empty slot.
+	u64 *slots;
+	u64 slot_count; // Power of two
+
 	u64 _key_size;
 	u64 _value_size;
-	
+	u64 _entry_size;
+	u64 _value_offset;
+
+	Hash_Table_Key_Equals_Proc key_equals;
+
 	Allocator allocator;
 } Hash_Table;
 
-Hash_Table make_hash_table_reserve_raw(u64 key_size, u64 value_size, u64 capacity_count, Allocator allocator) {
+#define HASH_TABLE_KEY_OFFSET sizeof(u64)
 
-	capacity_count = min(capacity_count, 8);
+Hash_Table make_hash_table_reserve_with_equals(u64 key_size, u64 value_size, u64 capacity_count, Hash_Table_Key_Equals_Proc key_equals, Allocator allocator) {
+
+	capacity_count = max(capacity_count, 8);
 
 	Hash_Table t = ZERO(Hash_Table);
-	
+
 	t._key_size = key_size;
 	t._value_size = value_size;
+	t._value_offset = HASH_TABLE_KEY_OFFSET + align_next(key_size, 8);
+	t._entry_size = t._value_offset + align_next(value_size, 8);
+	t.key_equals = key_equals ? key_equals : hash_table_bytes_match;
 	t.allocator = allocator;
-	
-	u64 entry_size = value_size+sizeof(u64);
-	t.entries = alloc(t.allocator, entry_size*capacity_count);
-	memset(t.entries, 0, entry_size*capacity_count);
-	t.capacity_count = capacity_count;
-	
+
+	hash_table_reserve(&t, capacity_count);
+
 	return t;
 }
+Hash_Table make_hash_table_reserve_raw(u64 key_size, u64 value_size, u64 capacity_count, Allocator allocator) {
+	return make_hash_table_reserve_with_equals(key_size, value_size, capacity_count, hash_table_bytes_match, allocator);
+}
 inline Hash_Table make_hash_table_raw(u64 key_size, u64 value_size, Allocator allocator) {
 	return make_hash_table_reserve_raw(key_size, value_size, 128, allocator);
 }
 
 void hash_table_reset(Hash_Table *t) {
 	t->count = 0;
+	if (t->slots) memset(t->slots, 0, t->slot_count*sizeof(u64));
 }
 void hash_table_destroy(Hash_Table *t) {
-	dealloc(t->allocator, t->entries);
-	
+	if (t->entries) dealloc(t->allocator, t->entries);
+	if (t->slots)   dealloc(t->allocator, t->slots);
+
 	t->entries = 0;
+	t->slots = 0;
 	t->count = 0;
 	t->capacity_count = 0;
+	t->slot_count = 0;
+}
+
+inline u8 *hash_table_get_entry(Hash_Table *t, u64 index) {
+	return (u8*)t->entries + index*t->_entry_size;
+}
+inline u64 hash_table_make_slot(u64 hash, u64 entry_index) {
+	return ((entry_index+1) << 32) | (hash >> 32);
+}
+inline u64 hash_table_get_slot_entry_index(u64 slot) {
+	return (slot >> 32) - 1;
+}
+
+// Puts an entry that is known not to be in the table into the slots
+void hash_table_insert_slot(Hash_Table *t, u64 hash, u64 entry_index) {
+	u64 mask = t->slot_count-1;
+	u64 i = hash & mask;
+	while (t->slots[i]) i = (i+1) & mask;
+	t->slots[i] = hash_table_make_slot(hash, entry_index);
 }
 
 void hash_table_reserve(Hash_Table *t, u64 required_count) {
-	u64 entry_size = t->_value_size+sizeof(u64);
-	
-	u64 required_size = required_count*entry_size;
-	
-	u64 current_size = t->capacity_count*entry_size;
-	
-	if (current_size >= required_size) return;
-	
-	u64 new_count = get_next_power_of_two(required_count);
-	u64 new_size = new_count*entry_size;
-	
-	void *new_entries = alloc(t->allocator, new_size);
-	memcpy(new_entries, t->entries, current_size);
-	
-	dealloc(t->allocator, t->entries);
-	
-	t->entries = new_entries;
-	t->capacity_count = new_count;
-}
-
-// This can add multiple entries of same hash, beware!
+
+	if (t->capacity_count < required_count) {
+		u64 new_count = get_next_power_of_two(required_count);
+		t->entries = reallocate(t->allocator, t->entries, new_count*t->_entry_size);
+		t->capacity_count = new_count;
+	}
+
+	// Keep the slots at most 3/4 full
+	if (required_count*4 > t->slot_count*3) {
+		u64 new_slot_count = max(get_next_power_of_two(required_count*4/3 + 1), HASH_TABLE_MIN_SLOT_COUNT);
+
+		if (t->slots) dealloc(t->allocator, t->slots);
+		t->slots = (u64*)alloc(t->allocator, new_slot_count*sizeof(u64));
+		memset(t->slots, 0, new_slot_count*sizeof(u64));
+		t->slot_count = new_slot_count;
+
+		for (u64 i = 0; i < t->count; i += 1) {
+			hash_table_insert_slot(t, *(u64*)hash_table_get_entry(t, i), i);
+		}
+	}
+}
+
+// Returns the index of the slot for the key, or -1 if it's not in the table
+s64 hash_table_find_slot(Hash_Table *t, u64 hash, void *k) {
+	if (!t->slot_count) return -1;
+
+	u64 mask = t->slot_count-1;
+	u64 tag = hash >> 32;
+
+	for (u64 i = hash & mask;; i = (i+1) & mask) {
+		u64 slot = t->slots[i];
+		if (!slot) return -1;
+		if ((slot & 0xFFFFFFFFull) != tag) continue;
+
+		u8 *entry = hash_table_get_entry(t, hash_table_get_slot_entry_index(slot));
+		if (*(u64*)entry == hash && t->key_equals(entry+HASH_TABLE_KEY_OFFSET, k, t->_key_size)) {
+			return (s64)i;
+		}
+	}
+}
+
 void hash_table_add_raw(Hash_Table *t, u64 hash, void *k, void *v, u64 key_size, u64 value_size) {
 
 	assert(t->_key_size == key_size, "Key type size does not match hash table initted key type size");
 	assert(t->_value_size == value_size, "Value type size does not match hash table initted value type size");
+	assert(t->count < 0xFFFFFFFFull, "Hash table is full");
+#if CONFIGURATION == DEBUG
+	assert(hash_table_find_slot(t, hash, k) == -1, "Key is already in the hash table, use hash_table_set() to overwrite it");
+#endif
 
 	hash_table_reserve(t, t->count+1);
-	
-	u64 entry_size = t->_value_size+sizeof(u64);
-	
-	u64 index = entry_size*t->count;
+
+	u64 index = t->count;
 	t->count += 1;
-	
-	u64 hash_offset = 0;
-	u64 value_offset = hash_offset + sizeof(u64);
-	
-	memcpy((u8*)t->entries+index+hash_offset,  &hash, sizeof(u64));
-	memcpy((u8*)t->entries+index+value_offset, v,     value_size);
-}
-
-void *hash_table_find_raw(Hash_Table *t, u64 hash) {
-
-	// #Speed #Incomplete
-	// Do quadratic probe 'triangular numbers'
-
-	u64 entry_size = t->_value_size+sizeof(u64);
-	u64 hash_offset = 0;
-	u64 value_offset = hash_offset + sizeof(u64);
-	
-	for (u64 i = 0; i < t->count; i += 1) {
-		u64 existing_hash = *(u64*)((u8*)t->entries+i*entry_size+hash_offset);
-		if (existing_hash == hash) {
-			void *value = ((u8*)t->entries+i*entry_size+value_offset);
-			return value;
-		}
-	}
-	return 0;
+
+	u8 *entry = hash_table_get_entry(t, index);
+	memcpy(entry,                      &hash, sizeof(u64));
+	memcpy(entry+HASH_TABLE_KEY_OFFSET, k,     key_size);
+	memcpy(entry+t->_value_offset,      v,     value_size);
+
+	hash_table_insert_slot(t, hash, index);
+}
+
+void *hash_table_find_raw(Hash_Table *t, u64 hash, void *k, u64 key_size) {
+	assert(t->_key_size == key_size, "Key type size does not match hash table initted key type size");
+
+	s64 slot = hash_table_find_slot(t, hash, k);
+	if (slot == -1) return 0;
+
+	return hash_table_get_entry(t, hash_table_get_slot_entry_index(t->slots[slot])) + t->_value_offset;
 }
 
 void *hash_table_get_nth_value(Hash_Table *t, u64 n) {
 	assert(n < t->count, "Hash table n is out of range");
-	
-	u64 entry_size = t->_value_size+sizeof(u64);
-	u64 hash_offset = 0;
-	u64 value_offset = hash_offset + sizeof(u64);
-	
-	return (u8*)t->entries+entry_size*n+value_offset;
+
+	return hash_table_get_entry(t, n) + t->_value_offset;
+}
+void *hash_table_get_nth_key(Hash_Table *t, u64 n) {
+	assert(n < t->count, "Hash table n is out of range");
+
+	return hash_table_get_entry(t, n) + HASH_TABLE_KEY_OFFSET;
 }
 
-bool hash_table_contains_raw(Hash_Table *t, u64 hash) {
-	return hash_table_find_raw(t, hash) != 0;
+bool hash_table_contains_raw(Hash_Table *t, u64 hash, void *k, u64 key_size) {
+	return hash_table_find_raw(t, hash, k, key_size) != 0;
 }
 
 // Returns true if key was newly added or false if it already existed
 bool hash_table_set_raw(Hash_Table *t, u64 hash, void *k, void *v, u64 key_size, u64 value_size) {
-	bool newly_added = true;
-	
-	if (hash_table_contains_raw(t, hash)) newly_added = false;
-	
-	if (newly_added) {
-		hash_table_add_raw(t, hash, k, v, key_size, value_size);
-	} else {
-		memcpy(hash_table_find_raw(t, hash), v, value_size);
+	assert(t->_value_size == value_size, "Value type size does not match hash table initted value type size");
+
+	void *existing = hash_table_find_raw(t, hash, k, key_size);
+
+	if (existing) {
+		memcpy(existing, v, value_size);
+		return false;
 	}
-	
-	return newly_added;
+
+	hash_table_add_raw(t, hash, k, v, key_size, value_size);
+	return true;
 }
 
+// Returns false if the key was not in the table
+bool hash_table_remove_raw(Hash_Table *t, u64 hash, void *k, u64 key_size) {
+	assert(t->_key_size == key_size, "Key type size does not match hash table initted key type size");
+
+	s64 found = hash_table_find_slot(t, hash, k);
+	if (found == -1) return false;
+
+	u64 mask = t->slot_count-1;
+	u64 entry_index = hash_table_get_slot_entry_index(t->slots[found]);
+
+	// Shift back following slots that would otherwise be cut off from where they hash to
+	u64 hole = (u64)found;
+	for (u64 i = (hole+1) & mask; t->slots[i]; i = (i+1) & mask) {
+		u64 ideal = *(u64*)hash_table_get_entry(t, hash_table_get_slot_entry_index(t->slots[i])) & mask;
+		if (((i - ideal) & mask) >= ((i - hole) & mask)) {
+			t->slots[hole] = t->slots[i];
+			hole = i;
+		}
+	}
+	t->slots[hole] = 0;
+
+	// Move the last entry into the removed one's place, and point its slot there
+	u64 last = t->count-1;
+	if (entry_index != last) {
+		u8 *last_entry = hash_table_get_entry(t, last);
+		u64 last_hash = *(u64*)last_entry;
+
+		u64 i = last_hash & mask;
+		while (hash_table_get_slot_entry_index(t->slots[i]) != last) i = (i+1) & mask;
+		t->slots[i] = hash_table_make_slot(last_hash, entry_index);
+
+		memcpy(hash_table_get_entry(t, entry_index), last_entry, t->_entry_size);
+	}
+	t->count -= 1;
+
+	return true;
+}
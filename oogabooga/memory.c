@@ -29,7 +29,12 @@ void* initialization_allocator_proc(u64 size, void *p, Allocator_Message message
 			return 0;
 		}
 		case ALLOCATOR_REALLOCATE: {
-			return 0;
+			void *new = initialization_allocator_proc(size, 0, ALLOCATOR_ALLOCATE, data);
+			if (p) {
+				// We don't know the old size, but it can't be more than what was allocated after p
+				memcpy(new, p, min(size, (u64)((u8*)new - (u8*)p)));
+			}
+			return new;
 		}
 	}
 	return 0;
@@ -43,43 +48,79 @@ Allocator get_initialization_allocator() {
 
 ///
 ///
-// Basic general heap allocator, free list
+// Basic general heap allocator, segregated free lists
 ///
-// Technically thread safe but synchronization is horrible.
-// Fragmentation is catastrophic.
-// We could fix it by merging free nodes every now and then
-// BUT: We aren't really supposed to allocate/deallocate directly on the heap too much anyways...
+// Memory is carved out of Heap_Block's which are reserved from program memory.
+// Each block is a run of chunks which are either allocated (starting with a
+// Heap_Allocation_Metadata) or free (starting with a Heap_Free_Node), ended by a
+// zero-sized fence chunk header.
+//
+// Free chunks are kept in size bins: exact bins (one per HEAP_ALIGNMENT step) for
+// small sizes, then HEAP_BIN_SUBDIVISIONS bins per power of two. A bitmap keeps track
+// of which bins are non-empty, so finding a free chunk is a bit scan + list pop
+// no matter what the heap looks like.
+//
+// Each chunk header holds the size of the physically previous chunk if that one is free,
+// which lets us coalesce neighbours in O(1). Only large chunks are coalesced when freed;
+// small chunks go straight back into their bin.
 
 #define MAX_HEAP_BLOCK_SIZE align_next(MB(500), os.page_size)
 #define DEFAULT_HEAP_BLOCK_SIZE (min(MAX_HEAP_BLOCK_SIZE, program_memory_capacity))
-#define HEAP_ALIGNMENT (sizeof(Heap_Free_Node))
+#define HEAP_ALIGNMENT 16
+#define HEAP_MIN_CHUNK_SIZE (sizeof(Heap_Free_Node))
+
+// Chunks below this size are binned by exact size and not coalesced on dealloc
+#define HEAP_EXACT_BIN_LIMIT 256
+#define HEAP_EXACT_BIN_COUNT (HEAP_EXACT_BIN_LIMIT/HEAP_ALIGNMENT)
+#define HEAP_BIN_SUBDIVISIONS_LOG2 2
+#define HEAP_BIN_SUBDIVISIONS (1 << HEAP_BIN_SUBDIVISIONS_LOG2)
+#define HEAP_EXACT_BIN_LIMIT_LOG2 8
+#define HEAP_MAX_CHUNK_SIZE_LOG2 48
+#define HEAP_BIN_COUNT (HEAP_EXACT_BIN_COUNT + (HEAP_MAX_CHUNK_SIZE_LOG2-HEAP_EXACT_BIN_LIMIT_LOG2)*HEAP_BIN_SUBDIVISIONS)
+#define HEAP_BIN_BITMAP_COUNT ((HEAP_BIN_COUNT+63)/64)
+
 typedef struct Heap_Free_Node Heap_Free_Node;
 typedef struct Heap_Block Heap_Block;
 
+// Shared start of every chunk, free or allocated
+typedef struct Heap_Chunk_Header {
+	u64 size; // Including header. 0 for the fence at the end of a block.
+	u64 prev_size; // Size of the physically previous chunk if it is free, otherwise 0
+} Heap_Chunk_Header;
+
 typedef struct Heap_Free_Node {
 	u64 size;
-	Heap_Free_Node *next;
+	u64 prev_size;
+	Heap_Free_Node *next; // Next/previous in bin
+	Heap_Free_Node *prev;
 } Heap_Free_Node;
 
 typedef struct Heap_Block {
 	u64 size;
-	Heap_Free_Node *free_head;
 	void* start;
 	Heap_Block *next;
-	// 32 bytes !!
-#if CONFIGURATION == DEBUG
-	u64 total_allocated;
 	u64 padding;
-#endif
+	// 32 bytes !!
 } Heap_Block;
 
-#define HEAP_META_SIGNATURE 6969694206942069ull
+typedef struct Heap_Thread_Cache Heap_Thread_Cache;
+
+#define HEAP_META_SIGNATURE 696942069ul
 typedef alignat(16) struct Heap_Allocation_Metadata {
 	u64 size;
-	Heap_Block *block;
+	u64 prev_size;
+	Heap_Thread_Cache *cache; // Set if this allocation is a slot owned by a thread cache
+	u16 size_class; // Thread cache size class, only valid if cache is set
+	bool is_huge; // Set if this allocation has its own pages, see heap_huge_alloc()
+	u8 reserved;
 #if CONFIGURATION == DEBUG
-	u64 signature;
-	u64 padding;
+	u32 signature;
+#else
+	u32 padding;
+#endif
+#if ENABLE_HEAP_PROFILING
+	u32 profile_site; // Index in heap_profile_sites
+	u32 profile_padding[3];
 #endif
 } Heap_Allocation_Metadata;
 
@@ -87,11 +128,23 @@ typedef alignat(16) struct Heap_Allocation_Metadata {
 ogb_instance Heap_Block *heap_head;
 ogb_instance bool heap_initted;
 ogb_instance Spinlock heap_lock;
+ogb_instance Heap_Free_Node *heap_bins[HEAP_BIN_COUNT];
+ogb_instance u64 heap_bin_bitmap[HEAP_BIN_BITMAP_COUNT];
+ogb_instance u64 heap_free_bytes;
+ogb_instance u64 heap_free_node_count;
+ogb_instance u64 heap_block_count;
+ogb_instance u64 heap_block_bytes;
 
 #if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
 Heap_Block *heap_head;
 bool heap_initted = false;
 Spinlock heap_lock;
+Heap_Free_Node *heap_bins[HEAP_BIN_COUNT];
+u64 heap_bin_bitmap[HEAP_BIN_BITMAP_COUNT];
+u64 heap_free_bytes = 0;
+u64 heap_free_node_count = 0;
+u64 heap_block_count = 0;
+u64 heap_block_bytes = 0;
 #endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
 	
 
@@ -117,6 +170,104 @@ bool is_pointer_valid(void *p) {
 	return is_pointer_in_program_memory(p) || is_pointer_in_stack(p) || is_pointer_in_static_memory(p);
 }
 
+inline Heap_Chunk_Header *heap_get_next_chunk(void *chunk) {
+	return (Heap_Chunk_Header*)((u8*)chunk + ((Heap_Chunk_Header*)chunk)->size);
+}
+inline bool heap_is_chunk_free(Heap_Chunk_Header *chunk) {
+	if (chunk->size == 0) return false; // Fence
+	return heap_get_next_chunk(chunk)->prev_size != 0;
+}
+
+// Bin whose range contains size
+u64 heap_get_bin_index(u64 size) {
+	if (size < HEAP_EXACT_BIN_LIMIT) return size/HEAP_ALIGNMENT;
+	
+	u64 log2 = bit_scan_reverse_64(size);
+	u64 subdivision = (size >> (log2-HEAP_BIN_SUBDIVISIONS_LOG2)) & (HEAP_BIN_SUBDIVISIONS-1);
+	
+	return HEAP_EXACT_BIN_COUNT + (log2-HEAP_EXACT_BIN_LIMIT_LOG2)*HEAP_BIN_SUBDIVISIONS + subdivision;
+}
+// First bin in which every free node is large enough for size
+u64 heap_get_bin_index_for_request(u64 size) {
+	if (size < HEAP_EXACT_BIN_LIMIT) return size/HEAP_ALIGNMENT;
+	
+	u64 log2 = bit_scan_reverse_64(size);
+	u64 bin_range = 1ULL << (log2-HEAP_BIN_SUBDIVISIONS_LOG2);
+	
+	return heap_get_bin_index(size + bin_range - 1);
+}
+
+// In debug, free memory is locked so we crash on use-after-free and heap overruns.
+// The page holding the free node header is never locked.
+void heap_lock_free_node_pages(Heap_Free_Node *node, void *from, void *to) {
+	u8 *interior_start = (u8*)node + sizeof(Heap_Free_Node);
+	u8 *interior_end   = (u8*)node + node->size;
+	u8 *first_page = (u8*)align_next(max((u8*)from, interior_start), os.page_size);
+	u8 *last_page_end = (u8*)align_previous(min((u8*)to, interior_end), os.page_size);
+	if (last_page_end > first_page) {
+		os_lock_program_memory_pages(first_page, (u64)(last_page_end-first_page));
+	}
+}
+void heap_unlock_chunk_pages(void *start, u64 size) {
+	u8 *first_page = (u8*)align_previous(start, os.page_size);
+	u8 *last_page_end = (u8*)align_next((u8*)start+size, os.page_size);
+	if (last_page_end > first_page) {
+		os_unlock_program_memory_pages(first_page, (u64)(last_page_end-first_page));
+	}
+}
+
+void heap_insert_free_node(Heap_Free_Node *node) {
+	u64 bin = heap_get_bin_index(node->size);
+	
+	node->prev = 0;
+	node->next = heap_bins[bin];
+	if (node->next) node->next->prev = node;
+	heap_bins[bin] = node;
+	heap_bin_bitmap[bin/64] |= 1ULL << (bin%64);
+	
+	heap_free_bytes += node->size;
+	heap_free_node_count += 1;
+	
+	heap_get_next_chunk(node)->prev_size = node->size;
+}
+void heap_remove_free_node(Heap_Free_Node *node) {
+	u64 bin = heap_get_bin_index(node->size);
+	
+	if (node->prev) node->prev->next = node->next;
+	else            heap_bins[bin] = node->next;
+	if (node->next) node->next->prev = node->prev;
+	
+	if (!heap_bins[bin]) heap_bin_bitmap[bin/64] &= ~(1ULL << (bin%64));
+	
+	heap_free_bytes -= node->size;
+	heap_free_node_count -= 1;
+	
+	heap_get_next_chunk(node)->prev_size = 0;
+}
+
+// Returns a free node of at least size bytes, or 0 if there is none
+Heap_Free_Node *heap_find_free_node(u64 size) {
+	u64 bin = heap_get_bin_index_for_request(size);
+	
+	// The bin that size falls into may also have a node that fits, which
+	// saves us from splitting a bigger chunk.
+	u64 own_bin = heap_get_bin_index(size);
+	if (own_bin != bin) {
+		Heap_Free_Node *node = heap_bins[own_bin];
+		if (node && node->size >= size) return node;
+	}
+	
+	for (u64 word = bin/64; word < HEAP_BIN_BITMAP_COUNT; word += 1) {
+		u64 bits = heap_bin_bitmap[word];
+		if (word == bin/64) bits &= ~0ULL << (bin%64);
+		if (bits) {
+			u64 found_bin = word*64 + bit_scan_forward_64(bits);
+			return heap_bins[found_bin];
+		}
+	}
+	return 0;
+}
+
 // Meant for debug
 void sanity_check_block(Heap_Block *block) {
 #if CONFIGURATION == DEBUG
@@ -124,31 +275,46 @@ void sanity_check_block(Heap_Block *block) {
 	assert(is_pointer_in_program_memory(block->start), "Heap_Block pointer is corrupt");
 	if(block->next) { assert(is_pointer_in_program_memory(block->next), "Heap_Block next pointer is corrupt"); }
 	assert(block->size < GB(256), "A heap block is corrupt.");
-	assert(block->size >= INITIAL_PROGRAM_MEMORY_SIZE, "A heap block is corrupt.");
 	assert((u64)block->start == (u64)block + sizeof(Heap_Block), "A heap block is corrupt.");
 	
-
-	Heap_Free_Node *node = block->free_head;	
-	
-	u64 total_free = 0;
-	while (node != 0) {
-		Heap_Free_Node *other_node = node->next;
+	// Walk the chunks in address order and make sure they add up to the block
+	Heap_Chunk_Header *chunk = (Heap_Chunk_Header*)block->start;
+	u64 previous_size = 0;
+	bool previous_free = false;
+	u64 total = sizeof(Heap_Block);
+	while (chunk->size != 0) {
+		assert(is_pointer_in_program_memory(chunk), "Heap is corrupt");
+		assert(chunk->size % HEAP_ALIGNMENT == 0 && chunk->size >= HEAP_MIN_CHUNK_SIZE, "Heap is corrupt: bad chunk size");
+		assert(chunk->prev_size == (previous_free ? previous_size : 0), "Heap is corrupt: chunk does not agree with its previous chunk. This might be a heap underrun.");
 		
-		assert(node->size < GB(256), "Heap is corrupt");
-		assert(is_pointer_in_program_memory(node), "Heap is corrupt");
+		previous_free = heap_is_chunk_free(chunk);
+		previous_size = chunk->size;
+		total += chunk->size;
+		assert(total < block->size, "Heap is corrupt: chunks run past the end of the heap block. This might be a heap overrun.");
 		
-		while (other_node != 0) {
-			assert(is_pointer_in_program_memory(other_node), "Heap is corrupt");
-			assert(other_node != node, "Circular reference in heap free node tree. This is probably an internal error, or an extremely unlucky result from heap corruption.");
-			other_node = other_node->next;
+		chunk = heap_get_next_chunk(chunk);
+	}
+	assert(chunk->prev_size == (previous_free ? previous_size : 0), "Heap is corrupt: fence does not agree with last chunk. This might be a heap overrun.");
+	assert(total + sizeof(Heap_Chunk_Header) <= block->size, "Heap is corrupt");
+#endif
+}
+void sanity_check_bins() {
+#if CONFIGURATION == DEBUG
+	for (u64 bin = 0; bin < HEAP_BIN_COUNT; bin += 1) {
+		bool bit = (heap_bin_bitmap[bin/64] & (1ULL << (bin%64))) != 0;
+		assert(bit == (heap_bins[bin] != 0), "Heap is corrupt: bin bitmap out of sync");
+		
+		Heap_Free_Node *node = heap_bins[bin];
+		Heap_Free_Node *prev = 0;
+		while (node) {
+			assert(is_pointer_in_program_memory(node), "Heap is corrupt");
+			assert(node->prev == prev, "Heap is corrupt: broken free list");
+			assert(heap_get_bin_index(node->size) == bin, "Heap is corrupt: free node in wrong bin");
+			assert(heap_is_chunk_free((Heap_Chunk_Header*)node), "Heap is corrupt: free node is not marked free");
+			prev = node;
+			node = node->next;
 		}
-		total_free += node->size;
-		assert(total_free <= block->size, "Free nodes are fucky wucky. This might be heap corruption, or possibly an internal error.");
-		node = node->next;
 	}
-	
-	u64 expected_size = get_heap_block_size_excluding_metadata(block);
-	assert(block->total_allocated+total_free == expected_size, "Heap is corrupt.")
 #endif
 }
 inline void check_meta(Heap_Allocation_Metadata *meta) {
@@ -157,378 +323,884 @@ inline void check_meta(Heap_Allocation_Metadata *meta) {
 #endif
 // If > 256GB then prolly not legit lol
 	assert(meta->size < 1024ULL*1024ULL*1024ULL*256ULL, "Heap error. Either 1) You passed a bad pointer to dealloc or 2) You corrupted the heap.");	
-	assert(is_pointer_in_program_memory(meta->block), "Heap error. Either 1) You passed a bad pointer to dealloc or 2) You corrupted the heap."); 
-
-	assert((u64)meta >= (u64)meta->block->start && (u64)meta < (u64)meta->block->start+meta->block->size, "Heap error: Pointer is not in it's metadata block. This could be heap corruption but it's more likely an internal error. That's not good.");
+	assert(meta->size >= HEAP_MIN_CHUNK_SIZE && meta->size % HEAP_ALIGNMENT == 0, "Heap error. Either 1) You passed a bad pointer to dealloc or 2) You corrupted the heap.");
+	assert(is_pointer_in_program_memory(meta), "Heap error. Either 1) You passed a bad pointer to dealloc or 2) You corrupted the heap."); 
 }
 
-typedef struct {
-	Heap_Free_Node *best_fit;
-	Heap_Free_Node *previous;
-	u64 delta;
-} Heap_Search_Result;
-Heap_Search_Result search_heap_block(Heap_Block *block, u64 size) {
+void *heap_huge_take_released_range(u64 size);
+
+// VERY_DEBUG heap validation.
+// Walking the whole heap on every allocation is too slow to be usable, so instead each
+// allocation checks the next HEAP_VALIDATION_CHUNKS_PER_STEP chunks (round-robin over all
+// heap blocks) and one bin, and each dealloc checks the chunks around what was freed.
+// Set heap_full_validation_frame_interval to also check the entire heap on a background
+// thread every that many frames (os_update() calls).
+#if VERY_DEBUG
+
+#ifndef HEAP_VALIDATION_CHUNKS_PER_STEP
+	#define HEAP_VALIDATION_CHUNKS_PER_STEP 64
+#endif
+
+// #Global
+ogb_instance Heap_Block *heap_validation_block;
+ogb_instance Heap_Chunk_Header *heap_validation_cursor;
+ogb_instance u64 heap_validation_bin;
+ogb_instance u64 heap_full_validation_frame_interval;
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+Heap_Block *heap_validation_block = 0;
+Heap_Chunk_Header *heap_validation_cursor = 0; // 0 for the start of heap_validation_block
+u64 heap_validation_bin = 0;
+u64 heap_full_validation_frame_interval = 0; // 0 to disable
+#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
+
+// Expects heap_lock to be held. block may be 0 if it's not known.
+void heap_validate_chunk(Heap_Block *block, Heap_Chunk_Header *chunk) {
+	assert(is_pointer_in_program_memory(chunk), "Heap is corrupt");
 	
-	if (block->free_head == 0)  return (Heap_Search_Result){0, 0, 0};
-		
-	Heap_Free_Node *node = block->free_head;
-	Heap_Free_Node *previous = 0;
+	u8 *block_end = block ? (u8*)block + block->size : 0;
+	if (block) {
+		assert((u8*)chunk >= (u8*)block->start && (u8*)chunk + sizeof(Heap_Chunk_Header) <= block_end, "Heap is corrupt: chunk is outside of its heap block");
+	}
 	
-	Heap_Free_Node *best_fit = 0;
-	Heap_Free_Node *before_best_fit = 0;
-	u64 best_fit_delta = 0;
+	if (chunk->prev_size) {
+		Heap_Chunk_Header *prev = (Heap_Chunk_Header*)((u8*)chunk - chunk->prev_size);
+		assert(!block || (u8*)prev >= (u8*)block->start, "Heap is corrupt: chunk does not agree with its previous chunk. This might be a heap underrun.");
+		assert(prev->size == chunk->prev_size, "Heap is corrupt: chunk does not agree with its previous chunk. This might be a heap underrun.");
+	}
 	
-	while (node != 0) {
-		
-		if (node->size == size) {
-			Heap_Search_Result result;
-			result.best_fit = node;
-			result.previous = previous;
-			result.delta = 0;
-			assert(result.previous != result.best_fit, "Internal goof");
-			return result;
+	if (chunk->size == 0) return; // Fence
+	
+	assert(chunk->size % HEAP_ALIGNMENT == 0 && chunk->size >= HEAP_MIN_CHUNK_SIZE, "Heap is corrupt: bad chunk size");
+	if (block) {
+		assert((u8*)chunk + chunk->size + sizeof(Heap_Chunk_Header) <= block_end, "Heap is corrupt: chunk runs past the end of the heap block. This might be a heap overrun.");
+	}
+	
+	if (heap_is_chunk_free(chunk)) {
+		Heap_Free_Node *node = (Heap_Free_Node*)chunk;
+		u64 bin = heap_get_bin_index(node->size);
+		assert(heap_bin_bitmap[bin/64] & (1ULL << (bin%64)), "Heap is corrupt: free node's bin is marked empty");
+		Heap_Free_Node *expected_self = node->prev ? node->prev->next : heap_bins[bin];
+		assert(expected_self == node, "Heap is corrupt: broken free list");
+		assert(!node->next || node->next->prev == node, "Heap is corrupt: broken free list");
+	} else {
+#if CONFIGURATION == DEBUG
+		assert(((Heap_Allocation_Metadata*)chunk)->signature == HEAP_META_SIGNATURE, "Heap is corrupt: allocation metadata was overwritten. This might be a heap overrun.");
+#endif
+	}
+}
+
+// Expects heap_lock to be held
+void heap_validate_step_locked() {
+	if (!heap_validation_block) {
+		heap_validation_block = heap_head;
+		heap_validation_cursor = 0;
+	}
+	
+	for (u64 i = 0; i < HEAP_VALIDATION_CHUNKS_PER_STEP; i += 1) {
+		Heap_Block *block = heap_validation_block;
+		Heap_Chunk_Header *chunk = heap_validation_cursor;
+		if (!chunk) {
+			assert(is_pointer_in_program_memory(block), "Heap_Block pointer is corrupt");
+			assert((u64)block->start == (u64)block + sizeof(Heap_Block), "A heap block is corrupt.");
+			chunk = (Heap_Chunk_Header*)block->start;
 		}
 		
-		if (node->size >= size) {
-			u64 delta = node->size - size;
-			
-			if (delta < best_fit_delta || !best_fit) {
-				before_best_fit = previous;
-				best_fit = node;
-				best_fit_delta = delta;
-			}
-		}
+		heap_validate_chunk(block, chunk);
 		
-		if (node->next) previous = node;
-		node = node->next;
+		if (chunk->size == 0) {
+			heap_validation_block = block->next ? block->next : heap_head;
+			heap_validation_cursor = 0;
+		} else {
+			heap_validation_cursor = heap_get_next_chunk(chunk);
+		}
 	}
 	
-	if (!best_fit)  return (Heap_Search_Result){0, 0, 0};
+	u64 bin = heap_validation_bin;
+	heap_validation_bin = (bin + 1) % HEAP_BIN_COUNT;
+	bool bit = (heap_bin_bitmap[bin/64] & (1ULL << (bin%64))) != 0;
+	assert(bit == (heap_bins[bin] != 0), "Heap is corrupt: bin bitmap out of sync");
+	if (heap_bins[bin]) {
+		assert(heap_bins[bin]->prev == 0, "Heap is corrupt: broken free list");
+		assert(heap_get_bin_index(heap_bins[bin]->size) == bin, "Heap is corrupt: free node in wrong bin");
+	}
+}
+
+// Expects heap_lock to be held.
+// The validation cursor must never point into the middle of a chunk, so this must be
+// called when a chunk stops existing because it was merged into the one before it.
+inline void heap_validation_forget_chunk(void *chunk, void *merged_into) {
+	if ((void*)heap_validation_cursor == chunk) heap_validation_cursor = (Heap_Chunk_Header*)merged_into;
+}
+// Expects heap_lock to be held
+inline void heap_validation_forget_block(Heap_Block *block) {
+	if (heap_validation_block == block) {
+		heap_validation_block = 0;
+		heap_validation_cursor = 0;
+	}
+}
+
+// Expects heap_lock to be held
+void heap_validate_full_locked() {
+	for (Heap_Block *block = heap_head; block; block = block->next) {
+		sanity_check_block(block);
+		Heap_Chunk_Header *chunk = (Heap_Chunk_Header*)block->start;
+		while (true) {
+			heap_validate_chunk(block, chunk);
+			if (chunk->size == 0) break;
+			chunk = heap_get_next_chunk(chunk);
+		}
+	}
+	sanity_check_bins();
+}
+
+// #Global
+ogb_instance Thread heap_full_validation_thread;
+ogb_instance Binary_Semaphore heap_full_validation_semaphore;
+ogb_instance u64 heap_full_validation_frame;
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+Thread heap_full_validation_thread = {0};
+Binary_Semaphore heap_full_validation_semaphore;
+u64 heap_full_validation_frame = 0;
+#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
+
+void heap_full_validation_thread_proc(Thread *t) {
+	while (true) {
+		os_binary_semaphore_wait(&heap_full_validation_semaphore);
+		
+		spinlock_acquire_or_wait(&heap_lock);
+		heap_validate_full_locked();
+		spinlock_release(&heap_lock);
+	}
+}
 
-	Heap_Search_Result result;
-	result.best_fit = best_fit;
-	result.previous = before_best_fit;
-	result.delta = best_fit_delta;
-	assert(result.previous != result.best_fit, "Internal goof");
-	return result;
+// Called each frame by os_update()
+void heap_validation_frame() {
+	if (!heap_full_validation_frame_interval) return;
+	
+	heap_full_validation_frame += 1;
+	if (heap_full_validation_frame % heap_full_validation_frame_interval != 0) return;
+	
+	if (!heap_full_validation_thread.proc) {
+		os_binary_semaphore_init(&heap_full_validation_semaphore, false);
+		os_thread_init(&heap_full_validation_thread, heap_full_validation_thread_proc);
+		os_thread_start(&heap_full_validation_thread);
+	}
+	os_binary_semaphore_signal(&heap_full_validation_semaphore);
 }
 
+#else
+	#define heap_validation_forget_chunk(...)
+	#define heap_validation_forget_block(...)
+#endif // VERY_DEBUG
+
 Heap_Block *make_heap_block(Heap_Block *parent, u64 size) {
 
-	size += sizeof(Heap_Block);
+	size += sizeof(Heap_Block) + sizeof(Heap_Chunk_Header);
 
 	size = align_next(size, os.page_size);
 
-	Heap_Block *block = (Heap_Block*)os_reserve_next_memory_pages(size);
+	// Address space given back by heap_trim() or huge allocations is reused first
+	Heap_Block *block = (Heap_Block*)heap_huge_take_released_range(size);
+	if (block) {
+		os_commit_memory_pages(block, size);
+	} else {
+		block = (Heap_Block*)os_reserve_next_memory_pages(size);
+	}
 		
 	assert((u64)block % os.page_size == 0, "Heap block not aligned to page size");
 	
 	if (parent) parent->next = block;
 	os_unlock_program_memory_pages(block, size);
 	
-#if CONFIGURATION == DEBUG
-	block->total_allocated = 0;
-#endif
-	
 	block->start = ((u8*)block)+sizeof(Heap_Block);
 	block->size = size;
 	block->next = 0;
-	block->free_head = (Heap_Free_Node*)block->start;
-	block->free_head->size = get_heap_block_size_excluding_metadata(block);
-	block->free_head->next = 0;
+	
+	heap_block_count += 1;
+	heap_block_bytes += size;
+	
+	Heap_Free_Node *node = (Heap_Free_Node*)block->start;
+	node->size = size - sizeof(Heap_Block) - sizeof(Heap_Chunk_Header);
+	node->prev_size = 0;
+	
+	Heap_Chunk_Header *fence = heap_get_next_chunk(node);
+	fence->size = 0;
+	fence->prev_size = 0;
+	
+	heap_insert_free_node(node);
+	heap_lock_free_node_pages(node, node, fence);
 	
 	return block;
 }
 
 void heap_init() {
 	if (heap_initted) return;
-	assert(HEAP_ALIGNMENT == 16);
-	assert(sizeof(Heap_Allocation_Metadata) % HEAP_ALIGNMENT == 0);
+	assert(sizeof(Heap_Allocation_Metadata) % HEAP_ALIGNMENT == 0, "Heap_Allocation_Metadata must be aligned to HEAP_ALIGNMENT");
+	assert(sizeof(Heap_Free_Node) <= sizeof(Heap_Allocation_Metadata), "Heap_Free_Node must fit in any allocated chunk");
+	assert(sizeof(Heap_Block) % HEAP_ALIGNMENT == 0, "Heap_Block must be aligned to HEAP_ALIGNMENT");
+	assert(HEAP_EXACT_BIN_LIMIT == 1 << HEAP_EXACT_BIN_LIMIT_LOG2, "HEAP_EXACT_BIN_LIMIT_LOG2 is wrong");
 	heap_initted = true;
+	memset(heap_bins, 0, sizeof(heap_bins));
+	memset(heap_bin_bitmap, 0, sizeof(heap_bin_bitmap));
+	heap_free_bytes = 0;
+	heap_free_node_count = 0;
+	heap_block_count = 0;
+	heap_block_bytes = 0;
 	heap_head = make_heap_block(0, DEFAULT_HEAP_BLOCK_SIZE);
 	spinlock_init(&heap_lock);
 }
 
-void *heap_alloc(u64 size) {
-
-	if (!heap_initted) heap_init();
-
-	// #Sync #Speed oof
-	spinlock_acquire_or_wait(&heap_lock);
-	
-
-
-
+// Expects heap_lock to be held
+void *heap_alloc_locked(u64 size) {
 	
 	size += sizeof(Heap_Allocation_Metadata);
 	
-	size = (size+HEAP_ALIGNMENT) & ~(HEAP_ALIGNMENT-1);
+	size = align_next(size, HEAP_ALIGNMENT);
 	
-	assert(size < MAX_HEAP_BLOCK_SIZE, "Past Charlie has been lazy and did not handle large allocations like this. I apologize on behalf of past Charlie. A quick fix could be to increase the heap block size for now. #Incomplete #Limitation");
+	assert(size < MAX_HEAP_BLOCK_SIZE, "Internal heap error: allocations this large should go through heap_huge_alloc()");
 	
 	
 #if VERY_DEBUG
-	{
-		Heap_Block *block = heap_head;
+	heap_validate_step_locked();
+#endif
+	
+	Heap_Free_Node *node = heap_find_free_node(size);
+	
+	if (!node) {
+		Heap_Block *last_block = heap_head;
+		while (last_block->next) last_block = last_block->next;
+		make_heap_block(last_block, max(DEFAULT_HEAP_BLOCK_SIZE, size));
+		node = heap_find_free_node(size);
+	}
+	
+	assert(node != 0, "Internal heap error");
+	assert(node->size >= size, "Internal heap error");
+	
+	heap_remove_free_node(node);
+	
+	u64 remainder = node->size - size;
+	if (remainder >= HEAP_MIN_CHUNK_SIZE) {
+		// Split. The remainder's interior pages are still locked from before.
+		heap_unlock_chunk_pages(node, size + sizeof(Heap_Free_Node));
 		
-		while (block != 0) {
-			sanity_check_block(block);
-			block = block->next;
-		}
+		Heap_Free_Node *remainder_node = (Heap_Free_Node*)((u8*)node + size);
+		remainder_node->size = remainder;
+		remainder_node->prev_size = 0;
+		heap_insert_free_node(remainder_node);
+	} else {
+		size = node->size;
+		heap_unlock_chunk_pages(node, size);
 	}
+	
+	Heap_Allocation_Metadata *meta = (Heap_Allocation_Metadata*)node;
+	meta->size = size;
+	// meta->prev_size is left as is, the previous chunk might be a free small chunk
+	meta->cache = 0;
+	meta->size_class = 0;
+	meta->is_huge = false;
+	meta->reserved = 0;
+#if CONFIGURATION == DEBUG
+	meta->signature = HEAP_META_SIGNATURE;
 #endif
+
+	check_meta(meta);
+	
+	void *p = ((u8*)meta)+sizeof(Heap_Allocation_Metadata);
+	assert((u64)p % HEAP_ALIGNMENT == 0, "Internal heap error. Result pointer is not aligned to HEAP_ALIGNMENT");
+	return p;
+}
+// Expects heap_lock to be held
+void heap_dealloc_locked(void *p) {
+	
+	assert(is_pointer_in_program_memory(p), "A bad pointer was passed tp heap_dealloc: it is out of program memory bounds!"); 
+	p = (u8*)p-sizeof(Heap_Allocation_Metadata);
+	Heap_Allocation_Metadata *meta = (Heap_Allocation_Metadata*)(p);
+	check_meta(meta);
+	
+	// Yoink meta data before we start overwriting it
+	u64 size = meta->size;
+	u64 prev_size = meta->prev_size;
+	
+	assert(!heap_is_chunk_free((Heap_Chunk_Header*)meta), "Heap error: double free, or the heap is corrupt.");
+	
+#if CONFIGURATION == DEBUG
+	memset(p, 0x69, size);
+#endif
+	
+	Heap_Free_Node *node = (Heap_Free_Node*)p;
+	node->size = size;
+	node->prev_size = prev_size;
+	
+	u8 *freed_start = (u8*)node;
+	u8 *freed_end   = (u8*)node + size;
 	
-	Heap_Block *block = heap_head;
-	Heap_Block *last_block = 0;
-	Heap_Free_Node *best_fit = 0;
-	Heap_Block *best_fit_block = 0;
-	Heap_Free_Node *previous = 0;
-	u64 best_fit_delta = 0;
 	// #Speed
-	// Maybe instead of going through EVERY free node to find best fit we do a good-enough fit
-	while (block != 0) {
-
-		if (get_heap_block_size_excluding_metadata(block) < size) {
-			last_block = block;
-			block = block->next;
-			continue;
-		}
-	
-		Heap_Search_Result result = search_heap_block(block, size);
-		Heap_Free_Node *node = result.best_fit;
-		if (node) {
-			if (node->size < size) continue;
-			if (node->size == size) {
-				best_fit = node;
-				best_fit_block = block;
-				previous = result.previous;
-				best_fit_delta = 0;
-				break;
-			}
-			
-			u64 delta = node->size-size;
-			if (delta < best_fit_delta || !best_fit) {
-				best_fit = node;
-				best_fit_block = block;
-				previous = result.previous;
-				best_fit_delta = delta;
-			}
+	// Small chunks are not coalesced, they are likely to be reused for the same size soon.
+	if (size >= HEAP_EXACT_BIN_LIMIT) {
+		Heap_Chunk_Header *next = heap_get_next_chunk(node);
+		if (heap_is_chunk_free(next)) {
+			heap_remove_free_node((Heap_Free_Node*)next);
+			heap_validation_forget_chunk(next, node);
+			node->size += next->size;
+			freed_end = (u8*)align_next(freed_end + sizeof(Heap_Free_Node), os.page_size);
+		}
+		if (node->prev_size) {
+			Heap_Free_Node *prev = (Heap_Free_Node*)((u8*)node - node->prev_size);
+			heap_remove_free_node(prev);
+			heap_validation_forget_chunk(node, prev);
+			prev->size += node->size;
+			node = prev;
 		}
-		
-		last_block = block;
-		block = block->next;
 	}
 	
-	if (!best_fit) {
-		block = make_heap_block(last_block, max(DEFAULT_HEAP_BLOCK_SIZE, size));
-		previous = 0;
-		best_fit = block->free_head;
-		best_fit_block = block;
+	heap_insert_free_node(node);
+	heap_lock_free_node_pages(node, (void*)align_previous(freed_start, os.page_size), freed_end);
+
+#if VERY_DEBUG
+	// Check the neighbours of what we freed
+	heap_validate_chunk(0, (Heap_Chunk_Header*)node);
+	heap_validate_chunk(0, heap_get_next_chunk(node));
+	if (node->prev_size) {
+		heap_validate_chunk(0, (Heap_Chunk_Header*)((u8*)node - node->prev_size));
 	}
-		
+#endif
+}
+
+///
+///
+// Thread heap caches
+///
+// Small allocations are served from a per-thread cache of free slots with one list per
+// size class, so the common alloc/dealloc path never touches heap_lock.
+// Caches refill from and flush back to the heap in batches (one lock per batch).
+// A slot freed by another thread than the one owning it is pushed onto the owning cache's
+// remote free list with compare_and_swap, and the owner takes the whole list back on its
+// next refill.
+// When a thread exits its cache is flushed and abandoned, and the next new thread adopts it.
+
+#define HEAP_CACHE_SIZE_CLASS_COUNT 8
+#define HEAP_CACHE_MIN_SIZE 16
+#define HEAP_CACHE_MAX_SIZE (HEAP_CACHE_MIN_SIZE << (HEAP_CACHE_SIZE_CLASS_COUNT-1))
+#define HEAP_CACHE_BATCH_SIZE KB(16)
+#define HEAP_CACHE_MAX_BATCH_COUNT 64
+
+typedef struct Heap_Cache_Slot Heap_Cache_Slot;
+typedef struct Heap_Cache_Slot {
+	Heap_Cache_Slot *next;
+} Heap_Cache_Slot;
+
+typedef struct Heap_Thread_Cache {
+	Heap_Cache_Slot *bins[HEAP_CACHE_SIZE_CLASS_COUNT];
+	u64 bin_counts[HEAP_CACHE_SIZE_CLASS_COUNT];
+	bool in_use;
+	Heap_Thread_Cache *next;
+	
+	// Keep remote frees off the cache line the owning thread writes to
+	u8 _padding[64];
+	volatile u64 remote_free_head; // Heap_Cache_Slot*
+} Heap_Thread_Cache;
+
+// #Global
+ogb_instance Heap_Thread_Cache *heap_thread_caches;
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+Heap_Thread_Cache *heap_thread_caches = 0;
+thread_local Heap_Thread_Cache *heap_thread_cache = 0;
+#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
+
+u64 heap_cache_get_size_class(u64 size) {
+	u64 size_class = 0;
+	u64 class_size = HEAP_CACHE_MIN_SIZE;
+	while (class_size < size) {
+		class_size <<= 1;
+		size_class += 1;
+	}
+	return size_class;
+}
+u64 heap_cache_get_batch_count(u64 size_class) {
+	u64 class_size = HEAP_CACHE_MIN_SIZE << size_class;
+	return clamp(HEAP_CACHE_BATCH_SIZE/class_size, 1, HEAP_CACHE_MAX_BATCH_COUNT);
+}
+
+Heap_Thread_Cache *heap_get_thread_cache() {
+	if (heap_thread_cache) return heap_thread_cache;
+	
+	spinlock_acquire_or_wait(&heap_lock);
+	
+	Heap_Thread_Cache *cache = heap_thread_caches;
+	while (cache && cache->in_use) cache = cache->next;
 	
-	assert(best_fit != 0, "Internal heap error");
+	if (!cache) {
+		cache = (Heap_Thread_Cache*)heap_alloc_locked(sizeof(Heap_Thread_Cache));
+		memset(cache, 0, sizeof(Heap_Thread_Cache));
+		cache->next = heap_thread_caches;
+		heap_thread_caches = cache;
+	}
+	cache->in_use = true;
+	
+	spinlock_release(&heap_lock);
 	
-	// Unlock best fit
+	heap_thread_cache = cache;
+	return cache;
+}
+
+void heap_cache_push(Heap_Thread_Cache *cache, Heap_Cache_Slot *slot, u64 size_class) {
+	slot->next = cache->bins[size_class];
+	cache->bins[size_class] = slot;
+	cache->bin_counts[size_class] += 1;
+}
+
+// Moves all slots freed by other threads into the bins
+void heap_cache_reclaim_remote_frees(Heap_Thread_Cache *cache) {
+	u64 head;
+	do {
+		head = cache->remote_free_head;
+		if (!head) return;
+	} while (!compare_and_swap_64(&cache->remote_free_head, 0, head));
 	
-	// #Copypaste
-	void *free_tail = (u8*)best_fit + best_fit->size;
-	void *first_page = (void*)align_previous(best_fit, os.page_size);
-	void *last_page_end = (void*)align_previous(free_tail, os.page_size);
-	if ((u8*)last_page_end > (u8*)first_page) {
-		os_unlock_program_memory_pages(first_page, (u64)last_page_end-(u64)first_page);
+	Heap_Cache_Slot *slot = (Heap_Cache_Slot*)head;
+	while (slot) {
+		Heap_Cache_Slot *next = slot->next;
+		Heap_Allocation_Metadata *meta = (Heap_Allocation_Metadata*)((u8*)slot-sizeof(Heap_Allocation_Metadata));
+		check_meta(meta);
+		assert(meta->cache == cache, "Internal heap error: slot on the wrong remote free list");
+		heap_cache_push(cache, slot, meta->size_class);
+		slot = next;
 	}
+}
+
+void heap_cache_refill(Heap_Thread_Cache *cache, u64 size_class) {
+	heap_cache_reclaim_remote_frees(cache);
+	if (cache->bins[size_class]) return;
+	
+	u64 class_size = HEAP_CACHE_MIN_SIZE << size_class;
+	u64 count = heap_cache_get_batch_count(size_class);
 	
-	Heap_Free_Node *new_free_node = 0;
-	if (size != best_fit->size) {
-		u64 remainder = best_fit->size - size;
-		new_free_node = (Heap_Free_Node*)(((u8*)best_fit)+size);
-		new_free_node->size = remainder;
-		new_free_node->next = best_fit->next;
+	spinlock_acquire_or_wait(&heap_lock);
+	for (u64 i = 0; i < count; i += 1) {
+		void *p = heap_alloc_locked(class_size);
+		Heap_Allocation_Metadata *meta = (Heap_Allocation_Metadata*)((u8*)p-sizeof(Heap_Allocation_Metadata));
+		meta->cache = cache;
+		meta->size_class = (u16)size_class;
+		heap_cache_push(cache, (Heap_Cache_Slot*)p, size_class);
+	}
+	spinlock_release(&heap_lock);
+}
+
+// Returns up to count slots of a size class to the heap
+void heap_cache_flush(Heap_Thread_Cache *cache, u64 size_class, u64 count) {
+	spinlock_acquire_or_wait(&heap_lock);
+	for (u64 i = 0; i < count && cache->bins[size_class]; i += 1) {
+		Heap_Cache_Slot *slot = cache->bins[size_class];
+		cache->bins[size_class] = slot->next;
+		cache->bin_counts[size_class] -= 1;
 		
-		// Lock remaining free node
-		// #Copypaste
-		void *free_tail = (u8*)new_free_node + new_free_node->size;
-		void *next_page = (void*)align_next(new_free_node, os.page_size);
-		void *last_page_end = (void*)align_previous(free_tail, os.page_size);
-		if ((u8*)last_page_end > (u8*)next_page) {
-			os_lock_program_memory_pages(next_page, (u64)last_page_end-(u64)next_page);
+		Heap_Allocation_Metadata *meta = (Heap_Allocation_Metadata*)((u8*)slot-sizeof(Heap_Allocation_Metadata));
+		meta->cache = 0;
+		heap_dealloc_locked(slot);
+	}
+	spinlock_release(&heap_lock);
+}
+
+void *heap_cache_alloc(u64 size) {
+	Heap_Thread_Cache *cache = heap_get_thread_cache();
+	u64 size_class = heap_cache_get_size_class(size);
+	
+	if (!cache->bins[size_class]) heap_cache_refill(cache, size_class);
+	
+	Heap_Cache_Slot *slot = cache->bins[size_class];
+	cache->bins[size_class] = slot->next;
+	cache->bin_counts[size_class] -= 1;
+	
+	return slot;
+}
+
+void heap_cache_dealloc(Heap_Allocation_Metadata *meta, void *p) {
+	Heap_Thread_Cache *cache = meta->cache;
+	u64 size_class = meta->size_class;
+	assert(size_class < HEAP_CACHE_SIZE_CLASS_COUNT, "Heap error. Either 1) You passed a bad pointer to dealloc or 2) You corrupted the heap.");
+	
+#if CONFIGURATION == DEBUG
+	memset(p, 0x69, HEAP_CACHE_MIN_SIZE << size_class);
+#endif
+
+	Heap_Cache_Slot *slot = (Heap_Cache_Slot*)p;
+	
+	if (cache != heap_thread_cache) {
+		u64 head;
+		do {
+			head = cache->remote_free_head;
+			slot->next = (Heap_Cache_Slot*)head;
+		} while (!compare_and_swap_64(&cache->remote_free_head, (u64)slot, head));
+		return;
+	}
+	
+	heap_cache_push(cache, slot, size_class);
+	
+	u64 batch_count = heap_cache_get_batch_count(size_class);
+	if (cache->bin_counts[size_class] > batch_count*2) {
+		heap_cache_flush(cache, size_class, batch_count);
+	}
+}
+
+// Flushes & abandons the calling thread's cache. Called when a thread exits.
+void heap_thread_cache_release() {
+	Heap_Thread_Cache *cache = heap_thread_cache;
+	if (!cache) return;
+	
+	heap_cache_reclaim_remote_frees(cache);
+	for (u64 i = 0; i < HEAP_CACHE_SIZE_CLASS_COUNT; i += 1) {
+		heap_cache_flush(cache, i, cache->bin_counts[i]);
+	}
+	
+	// Anything freed to this cache from now on waits on the remote list until it is adopted
+	spinlock_acquire_or_wait(&heap_lock);
+	cache->in_use = false;
+	spinlock_release(&heap_lock);
+	
+	heap_thread_cache = 0;
+}
+
+///
+///
+// Huge allocations
+///
+// Allocations of HEAP_HUGE_THRESHOLD or more get their own pages instead of living in a
+// heap block, so they don't fragment the heap and aren't limited by the heap block size.
+// The pages are decommitted (given back to the OS) when freed. The address range is kept
+// in a side table and committed again for a later huge allocation that fits in it.
+
+#define HEAP_HUGE_THRESHOLD MB(1)
+#define HEAP_HUGE_TABLE_CAPACITY 128
+
+typedef struct Heap_Huge_Range {
+	void *start; // 0 if this slot in the table is unused
+	u64 size;
+	bool in_use; // false if the pages are decommitted and can be reused
+} Heap_Huge_Range;
+
+typedef struct Heap_Huge_Table Heap_Huge_Table;
+typedef struct Heap_Huge_Table {
+	Heap_Huge_Range ranges[HEAP_HUGE_TABLE_CAPACITY];
+	Heap_Huge_Table *next;
+} Heap_Huge_Table;
+
+// #Global
+ogb_instance Heap_Huge_Table *heap_huge_table;
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+Heap_Huge_Table *heap_huge_table = 0;
+#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
+
+// Expects heap_lock to be held
+Heap_Huge_Range *heap_huge_find_range(void *start) {
+	for (Heap_Huge_Table *table = heap_huge_table; table; table = table->next) {
+		for (u64 i = 0; i < HEAP_HUGE_TABLE_CAPACITY; i += 1) {
+			if (table->ranges[i].start == start) return &table->ranges[i];
+		}
+	}
+	return 0;
+}
+// Expects heap_lock to be held
+Heap_Huge_Range *heap_huge_add_range(void *start, u64 size, bool in_use) {
+	Heap_Huge_Range *range = heap_huge_find_range(0);
+	if (!range) {
+		Heap_Huge_Table *table = (Heap_Huge_Table*)heap_alloc_locked(sizeof(Heap_Huge_Table));
+		memset(table, 0, sizeof(Heap_Huge_Table));
+		table->next = heap_huge_table;
+		heap_huge_table = table;
+		range = &table->ranges[0];
+	}
+	range->start = start;
+	range->size = size;
+	range->in_use = in_use;
+	return range;
+}
+
+// Expects heap_lock to be held.
+// Takes size bytes from the smallest released range that fits, or returns 0. The pages are
+// still decommitted, and no longer tracked in the table.
+void *heap_huge_take_released_range(u64 size) {
+	Heap_Huge_Range *best = 0;
+	for (Heap_Huge_Table *table = heap_huge_table; table; table = table->next) {
+		for (u64 i = 0; i < HEAP_HUGE_TABLE_CAPACITY; i += 1) {
+			Heap_Huge_Range *range = &table->ranges[i];
+			if (range->start && !range->in_use && range->size >= size && (!best || range->size < best->size)) {
+				best = range;
+			}
 		}
 	}
+	if (!best) return 0;
 	
+	void *start = best->start;
+	if (best->size > size) {
+		best->start = (u8*)start + size;
+		best->size -= size;
+	} else {
+		best->start = 0;
+	}
+	return start;
+}
+// Expects heap_lock to be held.
+// Adds a decommitted range to the table, merged with released neighbours so the address
+// space can be reused for bigger allocations.
+void heap_huge_release_range(void *start, u64 size) {
+	Heap_Huge_Range *range = heap_huge_find_range(start);
+	if (!range) range = heap_huge_add_range(start, size, false);
+	range->in_use = false;
 	
-	if (previous && new_free_node) {
-		assert(previous->next == best_fit, "Internal heap error");
-		previous->next = new_free_node;
-	} else if (previous) {
-		assert(previous->next == best_fit, "Internal heap error");
-		previous->next = best_fit->next;
+	for (Heap_Huge_Table *table = heap_huge_table; table; table = table->next) {
+		for (u64 i = 0; i < HEAP_HUGE_TABLE_CAPACITY; i += 1) {
+			Heap_Huge_Range *other = &table->ranges[i];
+			if (other == range || !other->start || other->in_use) continue;
+			
+			if ((u8*)other->start + other->size == (u8*)range->start) {
+				other->size += range->size;
+				range->start = 0;
+				range = other;
+			} else if ((u8*)range->start + range->size == (u8*)other->start) {
+				range->size += other->size;
+				other->start = 0;
+			}
+		}
 	}
+}
+
+void *heap_huge_alloc(u64 size) {
+	size = align_next(size + sizeof(Heap_Allocation_Metadata), os.page_size);
 	
-	if (best_fit_block->free_head == best_fit) {
-		// If we allocated the first free node then replace with new free node or just
-		// remove it if perfect fit.
-		if (new_free_node) {
-			new_free_node->next = best_fit_block->free_head->next;
-			best_fit_block->free_head = new_free_node;
-		} else best_fit_block->free_head = best_fit_block->free_head->next;
+	spinlock_acquire_or_wait(&heap_lock);
+	
+	void *start = heap_huge_take_released_range(size);
+	if (start) {
+		os_commit_memory_pages(start, size);
+		heap_huge_add_range(start, size, true);
+	} else {
+		start = os_reserve_next_memory_pages(size);
+		assert((u64)start % os.page_size == 0, "Huge allocation not aligned to page size");
+		os_unlock_program_memory_pages(start, size);
+		heap_huge_add_range(start, size, true);
 	}
 	
-	Heap_Allocation_Metadata *meta = (Heap_Allocation_Metadata*)best_fit;
+	spinlock_release(&heap_lock);
+	
+	Heap_Allocation_Metadata *meta = (Heap_Allocation_Metadata*)start;
 	meta->size = size;
-	meta->block = best_fit_block;
+	meta->prev_size = 0;
+	meta->cache = 0;
+	meta->size_class = 0;
+	meta->is_huge = true;
+	meta->reserved = 0;
 #if CONFIGURATION == DEBUG
 	meta->signature = HEAP_META_SIGNATURE;
-	meta->block->total_allocated += size;
 #endif
+	
+	return (u8*)start + sizeof(Heap_Allocation_Metadata);
+}
 
-	check_meta(meta);
-
-#if VERY_DEBUG
-	sanity_check_block(meta->block);
-#endif
+void heap_huge_dealloc(Heap_Allocation_Metadata *meta) {
+	spinlock_acquire_or_wait(&heap_lock);
+	
+	Heap_Huge_Range *range = heap_huge_find_range(meta);
+	assert(range && range->in_use, "Heap error: double free of a huge allocation, or the heap is corrupt.");
+	assert(range->size == meta->size, "Heap error: huge allocation metadata is corrupt.");
+	
+	os_decommit_memory_pages(range->start, range->size);
+	heap_huge_release_range(range->start, range->size);
 	
-	// #Sync #Speed oof
 	spinlock_release(&heap_lock);
+}
+
+// What the caller can actually use, which may be more than what was asked for
+inline u64 heap_get_usable_size(Heap_Allocation_Metadata *meta) {
+	if (meta->cache) return HEAP_CACHE_MIN_SIZE << meta->size_class;
+	return meta->size - sizeof(Heap_Allocation_Metadata);
+}
+
+void *heap_alloc(u64 size) {
+
+	if (!heap_initted) heap_init();
 	
+	void *p;
+	if (size <= HEAP_CACHE_MAX_SIZE) {
+		p = heap_cache_alloc(size);
+	} else if (size >= HEAP_HUGE_THRESHOLD) {
+		p = heap_huge_alloc(size);
+	} else {
+		spinlock_acquire_or_wait(&heap_lock);
+		p = heap_alloc_locked(size);
+		spinlock_release(&heap_lock);
+	}
+	
+#if ENABLE_HEAP_PROFILING
+	Heap_Allocation_Metadata *meta = (Heap_Allocation_Metadata*)((u8*)p-sizeof(Heap_Allocation_Metadata));
+	meta->profile_site = heap_profile_track_alloc(alloc_call_site, heap_get_usable_size(meta));
+#endif
 	
-	void *p = ((u8*)meta)+sizeof(Heap_Allocation_Metadata);
-	assert((u64)p % HEAP_ALIGNMENT == 0, "Internal heap error. Result pointer is not aligned to HEAP_ALIGNMENT");
 	return p;
 }
 void heap_dealloc(void *p) {
-	// #Sync #Speed oof
 	
 	if (!heap_initted) heap_init();
-
-	spinlock_acquire_or_wait(&heap_lock);
 	
 	assert(is_pointer_in_program_memory(p), "A bad pointer was passed tp heap_dealloc: it is out of program memory bounds!"); 
-	p = (u8*)p-sizeof(Heap_Allocation_Metadata);
-	Heap_Allocation_Metadata *meta = (Heap_Allocation_Metadata*)(p);
+	Heap_Allocation_Metadata *meta = (Heap_Allocation_Metadata*)((u8*)p-sizeof(Heap_Allocation_Metadata));
 	check_meta(meta);
 	
-	// Yoink meta data before we start overwriting it
-	Heap_Block *block = meta->block;
-	u64 size = meta->size;
+#if ENABLE_HEAP_PROFILING
+	heap_profile_track_dealloc(meta->profile_site, heap_get_usable_size(meta));
+#endif
 	
+	if (meta->cache) {
+		heap_cache_dealloc(meta, p);
+		return;
+	}
+	if (meta->is_huge) {
+		heap_huge_dealloc(meta);
+		return;
+	}
+
+	spinlock_acquire_or_wait(&heap_lock);
+	heap_dealloc_locked(p);
+	spinlock_release(&heap_lock);
+}
+
+// Expects heap_lock to be held. Returns false if there is no room to grow in place.
+bool heap_resize_chunk_in_place_locked(Heap_Allocation_Metadata *meta, u64 new_size) {
+	
+	if (new_size <= meta->size) {
+		// Only bother splitting off the tail if it's big enough to be useful
+		u64 remainder = meta->size - new_size;
+		if (remainder < HEAP_EXACT_BIN_LIMIT) return true;
+		
+		Heap_Free_Node *tail = (Heap_Free_Node*)((u8*)meta + new_size);
 #if CONFIGURATION == DEBUG
-	memset(p, 0x69696969, size);
+		memset(tail, 0x69, remainder);
 #endif
+		tail->size = remainder;
+		tail->prev_size = 0;
+		meta->size = new_size;
+		
+		u8 *freed_end = (u8*)tail + remainder;
+		Heap_Chunk_Header *next = heap_get_next_chunk(tail);
+		if (heap_is_chunk_free(next)) {
+			heap_remove_free_node((Heap_Free_Node*)next);
+			heap_validation_forget_chunk(next, tail);
+			tail->size += next->size;
+			freed_end = (u8*)align_next(freed_end + sizeof(Heap_Free_Node), os.page_size);
+		}
+		heap_insert_free_node(tail);
+		heap_lock_free_node_pages(tail, (void*)align_previous(tail, os.page_size), freed_end);
+		return true;
+	}
 	
-	#if VERY_DEBUG
-		sanity_check_block(block);
-	#endif
+	Heap_Chunk_Header *next = heap_get_next_chunk(meta);
+	if (!heap_is_chunk_free(next)) return false;
 	
-	Heap_Free_Node *new_node = cast(Heap_Free_Node*)p;
-	new_node->size = size;
+	u64 combined = meta->size + next->size;
+	if (combined < new_size) return false;
 	
-	if (new_node < block->free_head) {
-		// #Copypaste
-		void *free_tail = (u8*)new_node + new_node->size;
-		void *next_page = (void*)align_next(new_node, os.page_size);
-		void *last_page_end = (void*)align_previous(free_tail, os.page_size);
-		if ((u8*)last_page_end > (u8*)next_page) {
-			os_lock_program_memory_pages(next_page, (u64)last_page_end-(u64)next_page);
-		}
-		
-		if ((u8*)new_node+size == (u8*)block->free_head) {
-			new_node->size = size + block->free_head->size;
-			new_node->next = block->free_head->next;
-			block->free_head = new_node;
-		} else {
-			new_node->next = block->free_head;
-			block->free_head = new_node;
-		}
+	heap_remove_free_node((Heap_Free_Node*)next);
+	heap_validation_forget_chunk(next, meta);
+	
+	u64 remainder = combined - new_size;
+	if (remainder >= HEAP_MIN_CHUNK_SIZE) {
+		u8 *new_end = (u8*)meta + new_size;
+		heap_unlock_chunk_pages(next, (u64)(new_end + sizeof(Heap_Free_Node) - (u8*)next));
 		
+		Heap_Free_Node *rest = (Heap_Free_Node*)new_end;
+		rest->size = remainder;
+		rest->prev_size = 0;
+		meta->size = new_size;
+		heap_insert_free_node(rest);
 	} else {
+		heap_unlock_chunk_pages(next, next->size);
+		meta->size = combined;
+	}
 	
-		if (!block->free_head) {
-			block->free_head = new_node;
-			new_node->next = 0;
-			
-			// #Copypaste
-			void *free_tail = (u8*)new_node + new_node->size;
-			void *next_page = (void*)align_next(new_node, os.page_size);
-			void *last_page_end = (void*)align_previous(free_tail, os.page_size);
-			if ((u8*)last_page_end > (u8*)next_page) {
-				os_lock_program_memory_pages(next_page, (u64)last_page_end-(u64)next_page);
+	return true;
+}
+
+// Expects heap_lock to be held. Returns false if there is no room to grow in place.
+bool heap_huge_resize_in_place_locked(Heap_Allocation_Metadata *meta, u64 new_size) {
+	new_size = align_next(new_size, os.page_size);
+	if (new_size <= meta->size) return true;
+	
+	Heap_Huge_Range *range = heap_huge_find_range(meta);
+	assert(range && range->in_use, "Heap error: huge allocation metadata is corrupt.");
+	u8 *end = (u8*)range->start + range->size;
+	u64 needed = new_size - range->size;
+	
+	// Adjacent released range
+	Heap_Huge_Range *next = 0;
+	for (Heap_Huge_Table *table = heap_huge_table; table && !next; table = table->next) {
+		for (u64 i = 0; i < HEAP_HUGE_TABLE_CAPACITY; i += 1) {
+			Heap_Huge_Range *other = &table->ranges[i];
+			if (other->start == end && !other->in_use) {
+				next = other;
+				break;
 			}
-			
+		}
+	}
+	if (next && next->size >= needed) {
+		os_commit_memory_pages(end, needed);
+		if (next->size > needed) {
+			next->start = end + needed;
+			next->size -= needed;
 		} else {
-			Heap_Free_Node *node = block->free_head;
-		
-			while (true) {
-			
-				assert(node != 0, "We didn't find where the free node should be! This is likely heap corruption (or, hopefully not, an internal error)");
-				
-				// In retrospect, I don't remember a good reason to care about where the
-				// free nodes are... maybe I'm just dumb right now? #Speed #Memory
-				// ... ACtually, it's probably to easily know when to merge free nodes.
-				// BUT. Maybe it's not worth the performance hit? Then again, if the heap
-				// allocator slows down your program you should rethink your memory management
-				// anyways...
-				
-				if (new_node >= node) {
-					u8* node_tail = (u8*)node + node->size;
-					if (cast(u8*)new_node == node_tail) {
-						
-						// We need to account for the cases where we coalesce free blocks with start/end in the middle
-						// of a page.
-						
-						u64 new_node_size = new_node->size;
-						
-						// #Copypaste
-						void *free_tail = (u8*)new_node + new_node->size;
-						void *next_page = (void*)align_previous(node_tail, os.page_size);
-						void *last_page_end = (void*)align_previous(free_tail, os.page_size);
-
-						if ((u8*)next_page < (u8*)node) next_page = (u8*)next_page + os.page_size;
-						
-						if ((u8*)last_page_end > (u8*)next_page) {
-							os_lock_program_memory_pages(next_page, (u64)last_page_end-(u64)next_page);
-						}
-						
-						node->size += new_node_size;
-						
-						break;
-					} else {
-						new_node->next = node->next;
-						node->next = new_node;
-						
-						u8* new_node_tail = (u8*)new_node + new_node->size;
-						if (new_node->next && (u8*)new_node->next == new_node_tail) {
-							new_node->size += new_node->next->size;
-							new_node->next = new_node->next->next;
-						}
-						
-						// #Copypaste
-						void *free_tail = (u8*)new_node + new_node->size;
-						void *next_page = (void*)align_next(new_node, os.page_size);
-						void *last_page_end = (void*)align_previous(free_tail, os.page_size);
-						if ((u8*)last_page_end > (u8*)next_page) {
-							os_lock_program_memory_pages(next_page, (u64)last_page_end-(u64)next_page);
-						}
-						
-						break;
-					}
-				}
-				
-				node = node->next;
-			}
+			next->start = 0;
 		}
+	} else if (!next && end == (u8*)program_memory_next) {
+		// We're the last thing in program memory, so we can just keep going
+		void *more = os_reserve_next_memory_pages(needed);
+		assert(more == end, "Internal heap error: program memory was reserved outside of heap_lock");
+		os_unlock_program_memory_pages(more, needed);
+	} else {
+		return false;
 	}
 	
+	range->size = new_size;
+	meta->size = new_size;
+	return true;
+}
 
-#if CONFIGURATION == DEBUG
-	block->total_allocated -= size;
-#endif
-
-#if VERY_DEBUG
-	sanity_check_block(block);
+// Grows or shrinks in place if it can, otherwise moves.
+void *heap_realloc(void *p, u64 size) {
+	if (!p) return heap_alloc(size);
+	
+	if (!heap_initted) heap_init();
+	
+	assert(is_pointer_in_program_memory(p), "A bad pointer was passed to heap_realloc: it is out of program memory bounds!"); 
+	Heap_Allocation_Metadata *meta = (Heap_Allocation_Metadata*)((u8*)p-sizeof(Heap_Allocation_Metadata));
+	check_meta(meta);
+	
+	u64 old_size = heap_get_usable_size(meta);
+	if (meta->cache) {
+		if (size <= old_size) return p;
+	} else {
+		u64 new_chunk_size = align_next(size + sizeof(Heap_Allocation_Metadata), HEAP_ALIGNMENT);
+		
+		spinlock_acquire_or_wait(&heap_lock);
+		bool resized;
+		if (meta->is_huge) resized = heap_huge_resize_in_place_locked(meta, new_chunk_size);
+		else               resized = heap_resize_chunk_in_place_locked(meta, new_chunk_size);
+		spinlock_release(&heap_lock);
+		
+		if (resized) {
+#if ENABLE_HEAP_PROFILING
+			heap_profile_track_dealloc(meta->profile_site, old_size);
+			meta->profile_site = heap_profile_track_alloc(alloc_call_site, heap_get_usable_size(meta));
 #endif
-	// #Sync #Speed oof
-	spinlock_release(&heap_lock);
+			return p;
+		}
+	}
+	
+	void *new = heap_alloc(size);
+	memcpy(new, p, min(size, old_size));
+	heap_dealloc(p);
+	return new;
 }
 
 void* heap_allocator_proc(u64 size, void *p, Allocator_Message message, void* data) {
@@ -542,16 +1214,7 @@ void* heap_allocator_proc(u64 size, void *p, Allocator_Message message, void* da
 			return 0;
 		}
 		case ALLOCATOR_REALLOCATE: {
-			if (!p) {
-				return heap_alloc(size);
-			}
-			assert(is_pointer_valid(p), "Invalid pointer passed to heap allocator reallocate");
-			Heap_Allocation_Metadata *meta = (Heap_Allocation_Metadata*)(((u64)p)-sizeof(Heap_Allocation_Metadata));
-			check_meta(meta);
-			void *new = heap_alloc(size);
-			memcpy(new, p, min(size, meta->size));
-			heap_dealloc(p);
-			return new;
+			return heap_realloc(p, size);
 		}
 	}
 	return 0;
@@ -566,6 +1229,203 @@ Allocator get_heap_allocator() {
 	return heap_allocator;
 }
 
+///
+///
+// Heap stats & trimming
+///
+
+typedef struct Heap_Stats {
+	u64 block_count;
+	u64 block_bytes; // Reserved for heap blocks, including their own overhead
+	u64 used_bytes; // In allocated chunks, including metadata and slots held by thread caches
+	u64 free_bytes;
+	u64 free_node_count;
+	u64 largest_free_node;
+	
+	u64 huge_count;
+	u64 huge_bytes;
+	
+	// 1 - largest_free_node/free_bytes.
+	// 0 means all free memory is in one piece, close to 1 means it's in lots of small pieces.
+	float64 fragmentation;
+} Heap_Stats;
+
+typedef struct Heap_Block_Stats {
+	void *start;
+	u64 size;
+	u64 used_bytes;
+	u64 free_bytes;
+	u64 free_node_count;
+	u64 largest_free_node;
+	float64 occupancy; // used_bytes / usable size of the block
+} Heap_Block_Stats;
+
+// Expects heap_lock to be held
+u64 heap_get_largest_free_node_size_locked() {
+	for (s64 word = HEAP_BIN_BITMAP_COUNT-1; word >= 0; word -= 1) {
+		if (!heap_bin_bitmap[word]) continue;
+		
+		u64 bin = (u64)word*64 + bit_scan_reverse_64(heap_bin_bitmap[word]);
+		u64 largest = 0;
+		for (Heap_Free_Node *node = heap_bins[bin]; node; node = node->next) {
+			largest = max(largest, node->size);
+		}
+		return largest;
+	}
+	return 0;
+}
+
+// Cheap, doesn't walk the heap
+Heap_Stats get_heap_stats() {
+	if (!heap_initted) heap_init();
+	
+	Heap_Stats stats = ZERO(Heap_Stats);
+	
+	spinlock_acquire_or_wait(&heap_lock);
+	
+	stats.block_count = heap_block_count;
+	stats.block_bytes = heap_block_bytes;
+	stats.free_bytes = heap_free_bytes;
+	stats.free_node_count = heap_free_node_count;
+	stats.largest_free_node = heap_get_largest_free_node_size_locked();
+	stats.used_bytes = heap_block_bytes - heap_block_count*(sizeof(Heap_Block) + sizeof(Heap_Chunk_Header)) - heap_free_bytes;
+	
+	for (Heap_Huge_Table *table = heap_huge_table; table; table = table->next) {
+		for (u64 i = 0; i < HEAP_HUGE_TABLE_CAPACITY; i += 1) {
+			Heap_Huge_Range *range = &table->ranges[i];
+			if (range->start && range->in_use) {
+				stats.huge_count += 1;
+				stats.huge_bytes += range->size;
+			}
+		}
+	}
+	
+	spinlock_release(&heap_lock);
+	
+	if (stats.free_bytes) {
+		stats.fragmentation = 1.0 - (float64)stats.largest_free_node/(float64)stats.free_bytes;
+	}
+	
+	return stats;
+}
+
+u64 get_heap_block_count() {
+	if (!heap_initted) heap_init();
+	return heap_block_count;
+}
+// Walks every chunk in the block, so it's not something to do every frame
+Heap_Block_Stats get_heap_block_stats(u64 block_index) {
+	if (!heap_initted) heap_init();
+	
+	Heap_Block_Stats stats = ZERO(Heap_Block_Stats);
+	
+	spinlock_acquire_or_wait(&heap_lock);
+	
+	Heap_Block *block = heap_head;
+	for (u64 i = 0; i < block_index && block; i += 1) block = block->next;
+	assert(block, "Heap block index out of range");
+	
+	stats.start = block;
+	stats.size = block->size;
+	
+	Heap_Chunk_Header *chunk = (Heap_Chunk_Header*)block->start;
+	while (chunk->size != 0) {
+		if (heap_is_chunk_free(chunk)) {
+			stats.free_bytes += chunk->size;
+			stats.free_node_count += 1;
+			stats.largest_free_node = max(stats.largest_free_node, chunk->size);
+		} else {
+			stats.used_bytes += chunk->size;
+		}
+		chunk = heap_get_next_chunk(chunk);
+	}
+	
+	spinlock_release(&heap_lock);
+	
+	stats.occupancy = (float64)stats.used_bytes/(float64)(stats.used_bytes + stats.free_bytes);
+	
+	return stats;
+}
+
+// Expects heap_lock to be held.
+// Merges runs of free chunks, which small chunks are left as by heap_dealloc().
+void heap_coalesce_block_locked(Heap_Block *block) {
+	Heap_Chunk_Header *chunk = (Heap_Chunk_Header*)block->start;
+	while (chunk->size != 0) {
+		Heap_Chunk_Header *next = heap_get_next_chunk(chunk);
+		
+		if (heap_is_chunk_free(chunk) && heap_is_chunk_free(next)) {
+			Heap_Free_Node *node = (Heap_Free_Node*)chunk;
+			heap_remove_free_node(node);
+			while (heap_is_chunk_free(next)) {
+				heap_remove_free_node((Heap_Free_Node*)next);
+				heap_validation_forget_chunk(next, node);
+				node->size += next->size;
+				next = heap_get_next_chunk(node);
+			}
+			heap_insert_free_node(node);
+			heap_lock_free_node_pages(node, node, next);
+		}
+		
+		chunk = next;
+	}
+}
+
+//
+// Coalesces free memory in the heap and gives heap blocks that are completely free back
+// to the OS (except the first one). The address space is reused for new heap blocks and
+// huge allocations.
+// The calling thread's cached slots are returned to the heap first. Slots cached by other
+// threads stay where they are.
+// This walks the whole heap, so call it at a quiet time like a loading screen.
+//
+void heap_trim() {
+	if (!heap_initted) return;
+	
+	Heap_Thread_Cache *cache = heap_thread_cache;
+	if (cache) {
+		heap_cache_reclaim_remote_frees(cache);
+		for (u64 i = 0; i < HEAP_CACHE_SIZE_CLASS_COUNT; i += 1) {
+			heap_cache_flush(cache, i, cache->bin_counts[i]);
+		}
+	}
+	
+	spinlock_acquire_or_wait(&heap_lock);
+	
+	Heap_Block *prev_block = 0;
+	Heap_Block *block = heap_head;
+	while (block) {
+		Heap_Block *next_block = block->next;
+		
+		heap_coalesce_block_locked(block);
+		
+		Heap_Chunk_Header *first = (Heap_Chunk_Header*)block->start;
+		bool empty = heap_is_chunk_free(first) && heap_get_next_chunk(first)->size == 0;
+		
+		if (empty && block != heap_head) {
+			heap_remove_free_node((Heap_Free_Node*)first);
+			heap_validation_forget_block(block);
+			prev_block->next = next_block;
+			heap_block_count -= 1;
+			heap_block_bytes -= block->size;
+			
+			u64 size = block->size;
+			os_decommit_memory_pages(block, size);
+			heap_huge_release_range(block, size);
+		} else {
+			prev_block = block;
+		}
+		
+		block = next_block;
+	}
+	
+#if VERY_DEBUG
+	heap_validate_full_locked();
+#endif
+	
+	spinlock_release(&heap_lock);
+}
+
 ///
 ///
 // Temporary storage
@@ -575,6 +1435,23 @@ Allocator get_heap_allocator() {
 	#define TEMPORARY_STORAGE_SIZE (1024ULL*1024ULL*2ULL) // 2mb
 #endif
 
+// Each thread has its own temporary storage, pointed to by context.temporary_storage, so
+// resetting it on one thread (f.ex the audio thread) doesn't clobber another thread's frame.
+// If it overflows, it wraps around to the start.
+//
+// Each storage keeps a high water mark (most bytes in use between two resets) so you can
+// tune TEMPORARY_STORAGE_SIZE / Thread.temporary_storage_size from real numbers.
+
+typedef struct Temporary_Storage {
+	u8 *start;
+	u8 *next;
+	u64 size;
+	u64 high_water_mark;
+	u64 overflow_count;
+	u8 *last; // Start of the latest talloc, which can be reallocated in place
+	bool has_warned_overflow;
+} Temporary_Storage;
+
 ogb_instance void* talloc(u64);
 ogb_instance void* temp_allocator_proc(u64 size, void *p, Allocator_Message message, void*);
 
@@ -583,14 +1460,11 @@ ogb_instance Allocator
 get_temporary_allocator();
 
 #if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
-thread_local void * temporary_storage = 0;
-thread_local void * temporary_storage_pointer = 0;
-thread_local bool   has_warned_temporary_storage_overflow = false;
 thread_local Allocator temp_allocator;
 
 ogb_instance Allocator 
 get_temporary_allocator() {
-	if (!temporary_storage) return get_initialization_allocator();
+	if (!context.temporary_storage) return get_initialization_allocator();
 	return temp_allocator;
 }
 #endif
@@ -601,14 +1475,30 @@ temp_allocator_proc(u64 size, void *p, Allocator_Message message, void* data);
 ogb_instance void 
 temporary_storage_init(u64 arena_size);
 
+ogb_instance void 
+temporary_storage_deinit();
+
 ogb_instance void* 
 talloc(u64 size);
 
 ogb_instance void 
 reset_temporary_storage();
 
+// Most bytes of this thread's temporary storage in use at once since init.
+// If it overflowed, this will be the full size and get_temporary_storage_overflow_count() > 0.
+ogb_instance u64 
+get_temporary_storage_high_water_mark();
+
+ogb_instance u64 
+get_temporary_storage_overflow_count();
+
 
 #if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+void temporary_storage_update_high_water_mark(Temporary_Storage *storage) {
+	u64 used = (u64)(storage->next - storage->start);
+	if (used > storage->high_water_mark) storage->high_water_mark = used;
+}
+
 void* temp_allocator_proc(u64 size, void *p, Allocator_Message message, void* data) {
 	switch (message) {
 		case ALLOCATOR_ALLOCATE: {
@@ -619,8 +1509,24 @@ void* temp_allocator_proc(u64 size, void *p, Allocator_Message message, void* da
 			return 0;
 		}
 		case ALLOCATOR_REALLOCATE: {
-			panic("Temporary allocator cannot 'reallocate'");
-			return 0;
+			if (!p) return talloc(size);
+			
+			Temporary_Storage *storage = context.temporary_storage;
+			assert(storage, "Temporary storage was not initialized on this thread");
+			
+			if ((u8*)p == storage->last && (u8*)p + size <= storage->start + storage->size) {
+				storage->next = (u8*)p + size;
+				temporary_storage_update_high_water_mark(storage);
+				return p;
+			}
+			
+			// We don't know the old size, but it can't be more than what's between p and next
+			// (or the end, if we wrapped around since)
+			u8 *end = (u8*)p < storage->next ? storage->next : storage->start + storage->size;
+			u64 available = (u64)(end - (u8*)p);
+			void *new = talloc(size);
+			memmove(new, p, min(size, available));
+			return new;
 		}
 	}
 	return 0;
@@ -628,56 +1534,103 @@ void* temp_allocator_proc(u64 size, void *p, Allocator_Message message, void* da
 
 void temporary_storage_init(u64 arena_size) {
 	
-	temporary_storage = heap_alloc(arena_size);
-	assert(temporary_storage, "Failed allocating temporary storage");
-	temporary_storage_pointer = temporary_storage;
+	Temporary_Storage *storage = (Temporary_Storage*)heap_alloc(sizeof(Temporary_Storage) + arena_size);
+	assert(storage, "Failed allocating temporary storage");
+	memset(storage, 0, sizeof(Temporary_Storage));
+	
+	storage->start = (u8*)storage + sizeof(Temporary_Storage);
+	storage->next = storage->start;
+	storage->size = arena_size;
+	
+	context.temporary_storage = storage;
 
 	temp_allocator.proc = temp_allocator_proc;
 	temp_allocator.data = 0;
-	
-	temp_allocator.proc = temp_allocator_proc;
+}
+
+void temporary_storage_deinit() {
+	if (!context.temporary_storage) return;
+	heap_dealloc(context.temporary_storage);
+	context.temporary_storage = 0;
 }
 
 void* talloc(u64 size) {
 	
-	assert(size < TEMPORARY_STORAGE_SIZE, "Bruddah this is too large for temp allocator");
+	Temporary_Storage *storage = context.temporary_storage;
+	assert(storage, "Temporary storage was not initialized on this thread");
+	assert(size < storage->size, "Bruddah this is too large for temp allocator");
 	
-	void* p = temporary_storage_pointer;
-	
-	temporary_storage_pointer = (u8*)temporary_storage_pointer + size;
-	
-	if ((u8*)temporary_storage_pointer >= (u8*)temporary_storage+TEMPORARY_STORAGE_SIZE) {
-		if (!has_warned_temporary_storage_overflow) {
+	if (storage->next + size > storage->start + storage->size) {
+		if (!storage->has_warned_overflow) {
 			os_write_string_to_stdout(STR("WARNING: temporary storage was overflown, we wrap around at the start.\n"));
-			has_warned_temporary_storage_overflow = true;
+			storage->has_warned_overflow = true;
 		}
-		temporary_storage_pointer = temporary_storage;
-		return talloc(size);;
+		storage->overflow_count += 1;
+		storage->high_water_mark = storage->size;
+		storage->next = storage->start;
 	}
 	
+	void* p = storage->next;
+	
+	storage->next += size;
+	storage->last = p;
+	
+	temporary_storage_update_high_water_mark(storage);
+	
 	return p;
 }
 
 void reset_temporary_storage() {
-	temporary_storage_pointer = temporary_storage;	
-	has_warned_temporary_storage_overflow = false;
+	Temporary_Storage *storage = context.temporary_storage;
+	if (!storage) return;
+	storage->next = storage->start;	
+	storage->last = 0;
+	storage->has_warned_overflow = false;
+}
+
+u64 get_temporary_storage_high_water_mark() {
+	if (!context.temporary_storage) return 0;
+	return context.temporary_storage->high_water_mark;
+}
+u64 get_temporary_storage_overflow_count() {
+	if (!context.temporary_storage) return 0;
+	return context.temporary_storage->overflow_count;
 }
 
 #endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
 
 
+///
+///
+// Arena
+///
+// Arenas from make_arena() are a fixed block of heap memory and assert when full.
+// Arenas from make_growing_arena() reserve address space up front and commit pages as
+// they are pushed into, so they can grow without ever moving.
+//
+// arena_mark()/arena_rewind() save and restore the push position, and the latest push
+// can be grown or shrunk in place with arena_realloc() / ALLOCATOR_REALLOCATE.
+
+#define ARENA_COMMIT_SIZE KB(64)
+
 typedef struct Arena {
 	void *start;
 	void *next;
-	u64 size;
+	u64 size; // Usable bytes. For growing arenas this is the committed size.
+	u64 reserved_size; // 0 for fixed arenas
+	void *last; // Start of the latest push
+	bool decommit_on_reset; // Growing arenas only. Give memory back to the OS on arena_reset().
 } Arena;
 
-
+typedef struct Arena_Mark {
+	void *next;
+	void *last;
+} Arena_Mark;
 
 // Allocates arena from heap
 Arena make_arena(u64 size) {
 	size = align_next(size, 8);
-	Arena arena;
+	Arena arena = ZERO(Arena);
 	
 	arena.start = alloc(get_heap_allocator(), size);
 	arena.next = arena.start;
@@ -686,13 +1639,93 @@ Arena make_arena(u64 size) {
 	return arena;
 }
 
+// Reserves reserve_size bytes of address space, commits as needed
+Arena make_growing_arena(u64 reserve_size) {
+	reserve_size = align_next(reserve_size, os.page_size);
+	Arena arena = ZERO(Arena);
+	
+	arena.start = os_reserve_memory(reserve_size);
+	assert(arena.start, "Failed reserving %llu bytes of address space for arena", reserve_size);
+	arena.next = arena.start;
+	arena.size = 0;
+	arena.reserved_size = reserve_size;
+	
+	return arena;
+}
+
+// For arenas made with make_arena() or make_growing_arena()
+void destroy_arena(Arena *arena) {
+	if (arena->reserved_size) {
+		os_release_memory(arena->start, arena->reserved_size);
+	} else {
+		dealloc(get_heap_allocator(), arena->start);
+	}
+	*arena = ZERO(Arena);
+}
+
+void arena_grow(Arena *arena, u64 min_size) {
+	assert(arena->reserved_size, "Arena overflow: pushed past the end of a fixed size arena (%llu bytes)", arena->size);
+	assert(min_size <= arena->reserved_size, "Arena overflow: pushed past the reserved size of a growing arena (%llu bytes)", arena->reserved_size);
+	
+	u64 new_size = min(align_next(min_size, ARENA_COMMIT_SIZE), arena->reserved_size);
+	os_commit_memory_pages((u8*)arena->start + arena->size, new_size - arena->size);
+	arena->size = new_size;
+}
+
 void *arena_push(Arena *arena, u64 size) {
-	void *p = arena->next;
-	arena->next = (u8*)arena->next + size;
+	u8 *p = (u8*)arena->next;
+	u64 end = (u64)(p - (u8*)arena->start) + size;
+	if (end > arena->size) arena_grow(arena, end);
+	
+	arena->next = p + size;
+	arena->last = p;
 	return p;
 }
 #define arena_push_struct(parena, type) arena_push((parena), sizeof(type))
 
+// The latest push is resized in place, anything else is copied to a new push
+void *arena_realloc(Arena *arena, void *p, u64 size) {
+	if (!p) return arena_push(arena, size);
+	
+	assert((u8*)p >= (u8*)arena->start && (u8*)p < (u8*)arena->next, "Pointer passed to arena_realloc was not pushed to this arena (or was rewound)");
+	
+	if (p == arena->last) {
+		u64 end = (u64)((u8*)p - (u8*)arena->start) + size;
+		if (end > arena->size) arena_grow(arena, end);
+		arena->next = (u8*)p + size;
+		return p;
+	}
+	
+	// We don't know the old size, but it can't be more than what's between p and next
+	u64 available = (u64)((u8*)arena->next - (u8*)p);
+	void *new = arena_push(arena, size);
+	memcpy(new, p, min(size, available));
+	return new;
+}
+
+Arena_Mark arena_mark(Arena *arena) {
+	Arena_Mark mark;
+	mark.next = arena->next;
+	mark.last = arena->last;
+	return mark;
+}
+// Pops everything pushed since the mark
+void arena_rewind(Arena *arena, Arena_Mark mark) {
+	assert((u8*)mark.next >= (u8*)arena->start && (u8*)mark.next <= (u8*)arena->next, "Bad arena mark. Was it already rewound past?");
+	arena->next = mark.next;
+	arena->last = mark.last;
+}
+
+void arena_reset(Arena *arena) {
+	arena->next = arena->start;
+	arena->last = 0;
+	
+	if (arena->reserved_size && arena->decommit_on_reset && arena->size > ARENA_COMMIT_SIZE) {
+		os_decommit_memory_pages((u8*)arena->start + ARENA_COMMIT_SIZE, arena->size - ARENA_COMMIT_SIZE);
+		arena->size = ARENA_COMMIT_SIZE;
+	}
+}
+
 void* arena_allocator_proc(u64 size, void *p, Allocator_Message message, void* data) {
 	if (size > 8) size = align_next(size, 8);
 	Arena *arena = (Arena*)data;
@@ -704,8 +1737,7 @@ void* arena_allocator_proc(u64 size, void *p, Allocator_Message message, void* d
 			return 0;
 		}
 		case ALLOCATOR_REALLOCATE: {
-			panic("Arena allocator cannot 'reallocate'");
-			return 0;
+			return arena_realloc(arena, p, size);
 		}
 	}
 	return 0;
@@ -716,6 +1748,7 @@ Allocator make_arena_allocator(u64 size) {
 	void *mem = alloc(get_heap_allocator(), size + sizeof(Arena));
 	
 	Arena *arena = (Arena*)mem;
+	*arena = ZERO(Arena);
 	
 	arena->start = (u8*)mem + sizeof(Arena);
 	arena->next = arena->start;
@@ -728,9 +1761,9 @@ Allocator make_arena_allocator(u64 size) {
 	return allocator;
 }
 Allocator make_arena_allocator_with_memory(u64 size, void *p) {
-	void *mem = alloc(get_heap_allocator(), size + sizeof(Arena));
 	
 	Arena *arena = (Arena*)alloc(get_heap_allocator(), sizeof(Arena));
+	*arena = ZERO(Arena);
 	
 	arena->start = p;
 	arena->next = arena->start;
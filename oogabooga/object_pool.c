@@ -0,0 +1,262 @@
+
+/*
+
+	Fixed size object pool with generational handles.
+
+	Items live in chunks that never move, so pointers to items stay valid until released.
+	Acquire & release are O(1) (intrusive free list), and live items are kept in a dense
+	list for iteration.
+	Handles carry a generation which is bumped on release, so using a handle to a released
+	(or released and reacquired) item is detected.
+
+	Not thread safe.
+
+	Full API:
+
+		void  object_pool_init(Object_Pool *pool, u64 item_size, u64 first_chunk_count, Allocator allocator);
+		void  object_pool_deinit(Object_Pool *pool);
+
+		// Returned item is zeroed. handle may be 0.
+		void *object_pool_acquire(Object_Pool *pool, Object_Handle *handle);
+		// Returns false if the handle is stale
+		bool  object_pool_release(Object_Pool *pool, Object_Handle handle);
+
+		// Returns 0 if the handle is stale
+		void *object_pool_get(Object_Pool *pool, Object_Handle handle);
+		bool  object_pool_is_valid(Object_Pool *pool, Object_Handle handle);
+		Object_Handle object_pool_get_handle(Object_Pool *pool, void *item);
+
+		// Any slot under pool->slot_count, live or not
+		void *object_pool_get_by_index(Object_Pool *pool, u32 index);
+
+		// Dense iteration. Releasing moves the last live item into the released position,
+		// so iterate backwards if you release while iterating.
+		u64   object_pool_get_live_count(Object_Pool *pool);
+		void *object_pool_get_live(Object_Pool *pool, u64 i, Object_Handle *handle);
+
+	Usage:
+
+		Object_Pool things;
+		object_pool_init(&things, sizeof(Thing), 64, get_heap_allocator());
+
+		Object_Handle h;
+		Thing *thing = object_pool_acquire(&things, &h);
+
+		Thing *same_thing = object_pool_get(&things, h);
+
+		for (s64 i = object_pool_get_live_count(&things)-1; i >= 0; i -= 1) {
+			Object_Handle h;
+			Thing *thing = object_pool_get_live(&things, i, &h);
+			if (thing->dead) object_pool_release(&things, h);
+		}
+
+		object_pool_release(&things, h);
+		assert(!object_pool_get(&things, h));
+
+		object_pool_deinit(&things);
+*/
+
+// Chunk n holds first_chunk_count << n items
+#define OBJECT_POOL_MAX_CHUNKS 32
+#define OBJECT_POOL_SLOT_FREE 0xFFFFFFFFu
+
+typedef struct Object_Handle {
+	u32 index;
+	u32 generation; // 0 is never valid
+} Object_Handle;
+
+typedef struct Object_Pool_Slot {
+	u32 generation;
+	u32 next_free; // Index+1 of the next free slot, 0 for none. Only valid when free.
+	u32 live_index; // OBJECT_POOL_SLOT_FREE if free
+} Object_Pool_Slot;
+
+typedef struct Object_Pool {
+	u64 item_size;
+	u64 first_chunk_count;
+	Allocator allocator;
+
+	u8 *chunks[OBJECT_POOL_MAX_CHUNKS]; // Items, followed by one Object_Pool_Slot per item
+	u32 chunk_count;
+	u32 slot_count;
+
+	u32 free_head; // Index+1, 0 for none
+	u32 *live; // Growing array of live slot indices
+} Object_Pool;
+
+void
+object_pool_init(Object_Pool *pool, u64 item_size, u64 first_chunk_count, Allocator allocator) {
+	assert(item_size > 0, "Object pool item size must be more than 0");
+	assert(first_chunk_count > 0, "Object pool chunk count must be more than 0");
+
+	*pool = ZERO(Object_Pool);
+	pool->item_size = align_next(item_size, 8);
+	pool->first_chunk_count = first_chunk_count;
+	pool->allocator = allocator;
+	growing_array_init((void**)&pool->live, sizeof(u32), allocator);
+}
+void
+object_pool_deinit(Object_Pool *pool) {
+	if (!pool->item_size) return;
+	for (u32 i = 0; i < pool->chunk_count; i += 1) {
+		dealloc(pool->allocator, pool->chunks[i]);
+	}
+	growing_array_deinit((void**)&pool->live);
+	*pool = ZERO(Object_Pool);
+}
+
+inline u64
+object_pool_get_chunk_capacity(Object_Pool *pool, u32 chunk) {
+	return pool->first_chunk_count << chunk;
+}
+
+// Where index is in the chunks. Chunk n starts at first_chunk_count*(2^n - 1).
+inline void
+object_pool_locate(Object_Pool *pool, u32 index, u32 *chunk, u64 *offset) {
+	u64 n = bit_scan_reverse_64((u64)index/pool->first_chunk_count + 1);
+	*chunk  = (u32)n;
+	*offset = (u64)index - pool->first_chunk_count*((1ULL << n) - 1);
+}
+
+inline Object_Pool_Slot*
+object_pool_get_slot(Object_Pool *pool, u32 index) {
+	u32 chunk;
+	u64 offset;
+	object_pool_locate(pool, index, &chunk, &offset);
+	Object_Pool_Slot *slots = (Object_Pool_Slot*)(pool->chunks[chunk] + pool->item_size*object_pool_get_chunk_capacity(pool, chunk));
+	return &slots[offset];
+}
+
+void*
+object_pool_get_by_index(Object_Pool *pool, u32 index) {
+	assert(index < pool->slot_count, "Object pool index out of range");
+	u32 chunk;
+	u64 offset;
+	object_pool_locate(pool, index, &chunk, &offset);
+	return pool->chunks[chunk] + pool->item_size*offset;
+}
+
+void
+object_pool_add_chunk(Object_Pool *pool) {
+	assert(pool->chunk_count < OBJECT_POOL_MAX_CHUNKS, "Object pool is full");
+
+	u32 chunk = pool->chunk_count;
+	u64 capacity = object_pool_get_chunk_capacity(pool, chunk);
+	assert((u64)pool->slot_count + capacity < OBJECT_POOL_SLOT_FREE, "Object pool is full");
+
+	u8 *memory = (u8*)alloc(pool->allocator, capacity*(pool->item_size + sizeof(Object_Pool_Slot)));
+	Object_Pool_Slot *slots = (Object_Pool_Slot*)(memory + pool->item_size*capacity);
+
+	// Chain the new slots onto the free list in order
+	u32 first_index = pool->slot_count;
+	for (u64 i = 0; i < capacity; i += 1) {
+		slots[i].generation = 0;
+		slots[i].live_index = OBJECT_POOL_SLOT_FREE;
+		slots[i].next_free = (i+1 < capacity) ? (u32)(first_index + i + 2) : pool->free_head;
+	}
+	pool->free_head = first_index + 1;
+
+	pool->chunks[chunk] = memory;
+
+	// Publish the chunk before its slots, for readers walking slots by index on another thread
+	MEMORY_BARRIER;
+
+	pool->chunk_count += 1;
+	pool->slot_count += (u32)capacity;
+}
+
+void*
+object_pool_acquire(Object_Pool *pool, Object_Handle *handle) {
+	assert(pool->item_size, "Object pool was not initialized");
+
+	if (!pool->free_head) object_pool_add_chunk(pool);
+
+	u32 index = pool->free_head - 1;
+	Object_Pool_Slot *slot = object_pool_get_slot(pool, index);
+	assert(slot->live_index == OBJECT_POOL_SLOT_FREE, "Object pool is corrupt");
+
+	pool->free_head = slot->next_free;
+
+	slot->generation += 1;
+	if (slot->generation == 0) slot->generation = 1;
+	slot->live_index = growing_array_get_valid_count(pool->live);
+	growing_array_add((void**)&pool->live, &index);
+
+	void *item = object_pool_get_by_index(pool, index);
+	memset(item, 0, pool->item_size);
+
+	if (handle) {
+		handle->index = index;
+		handle->generation = slot->generation;
+	}
+	return item;
+}
+
+bool
+object_pool_is_valid(Object_Pool *pool, Object_Handle handle) {
+	if (handle.index >= pool->slot_count || handle.generation == 0) return false;
+	Object_Pool_Slot *slot = object_pool_get_slot(pool, handle.index);
+	return slot->generation == handle.generation && slot->live_index != OBJECT_POOL_SLOT_FREE;
+}
+
+void*
+object_pool_get(Object_Pool *pool, Object_Handle handle) {
+	if (!object_pool_is_valid(pool, handle)) return 0;
+	return object_pool_get_by_index(pool, handle.index);
+}
+
+bool
+object_pool_release(Object_Pool *pool, Object_Handle handle) {
+	if (!object_pool_is_valid(pool, handle)) return false;
+
+	Object_Pool_Slot *slot = object_pool_get_slot(pool, handle.index);
+
+	// Move the last live index into the hole
+	u32 live_count = growing_array_get_valid_count(pool->live);
+	u32 last = pool->live[live_count-1];
+	pool->live[slot->live_index] = last;
+	object_pool_get_slot(pool, last)->live_index = slot->live_index;
+	growing_array_pop((void**)&pool->live);
+
+	// Bump generation so the handle goes stale
+	slot->generation += 1;
+	slot->live_index = OBJECT_POOL_SLOT_FREE;
+	slot->next_free = pool->free_head;
+	pool->free_head = handle.index + 1;
+
+	return true;
+}
+
+Object_Handle
+object_pool_get_handle(Object_Pool *pool, void *item) {
+	for (u32 chunk = 0; chunk < pool->chunk_count; chunk += 1) {
+		u8 *start = pool->chunks[chunk];
+		u64 capacity = object_pool_get_chunk_capacity(pool, chunk);
+		if ((u8*)item >= start && (u8*)item < start + capacity*pool->item_size) {
+			u64 offset = (u64)((u8*)item - start);
+			assert(offset % pool->item_size == 0, "Pointer is not at the start of an item in the object pool");
+
+			Object_Handle handle;
+			handle.index = (u32)(pool->first_chunk_count*((1ULL << chunk) - 1) + offset/pool->item_size);
+			handle.generation = object_pool_get_slot(pool, handle.index)->generation;
+			return handle;
+		}
+	}
+	assert(false, "Pointer is not in this object pool");
+	return ZERO(Object_Handle);
+}
+
+u64
+object_pool_get_live_count(Object_Pool *pool) {
+	return growing_array_get_valid_count(pool->live);
+}
+void*
+object_pool_get_live(Object_Pool *pool, u64 i, Object_Handle *handle) {
+	assert(i < growing_array_get_valid_count(pool->live), "Object pool live index out of range");
+	u32 index = pool->live[i];
+	if (handle) {
+		handle->index = index;
+		handle->generation = object_pool_get_slot(pool, index)->generation;
+	}
+	return object_pool_get_by_index(pool, index);
+}
@@ -110,6 +110,17 @@
 			
 				#define RUN_TESTS 1
 				
+		- RUN_TEST_BENCHMARKS
+			Run the tests' benchmarks with their full sizes (millions of entries), which
+			takes a while. Otherwise they run small so RUN_TESTS stays quick.
+		
+			0: Disable
+			1: Enable
+			
+			Example:
+			
+				#define RUN_TEST_BENCHMARKS 1
+				
 		- ENABLE_PROFILING
 			Enable time profiling which will be dumped to google_trace.json.
 		
@@ -126,6 +137,23 @@
 					tm_scope_var
 					tm_scope_accum
 					
+		- ENABLE_HEAP_PROFILING
+			Track live heap memory per allocation site (where alloc() was called from).
+			Cheap enough to leave on in playtest builds.
+		
+			0: Disable
+			1: Enable
+			
+			Example:
+			
+				#define ENABLE_HEAP_PROFILING 1
+				
+			Note:
+				See heap profiling in profiling.c
+					heap_profile_log_report
+					heap_profile_report_counter (Called each os_update() if ENABLE_PROFILING is on too)
+				Heap allocations take 16 more bytes of metadata when this is on.
+					
 		- OOGABOOGA_HEADLESS
             Run oogabooga in headless mode, i.e. no window, no graphics, no audio.
             Useful if you only need the oogabooga standard library for something like a game server.
@@ -219,6 +247,14 @@ typedef u8 bool;
 	#define ENABLE_SIMD 1
 #endif
 
+#ifndef ENABLE_HEAP_PROFILING
+	#define ENABLE_HEAP_PROFILING 0
+#endif
+
+#ifndef RUN_TEST_BENCHMARKS
+	#define RUN_TEST_BENCHMARKS 0
+#endif
+
 #ifndef INITIAL_PROGRAM_MEMORY_SIZE
     #define INITIAL_PROGRAM_MEMORY_SIZE MB(5)
 #endif
@@ -311,7 +347,13 @@ typedef u8 bool;
 #include "linmath.c"
 
 #include "hash_table.c"
+#include "hash_map.c"
 #include "growing_array.c"
+#include "object_pool.c"
+#include "chunked_array.c"
+#include "typed_containers.c"
+#include "entity_storage.c"
+#include "spatial_hash.c"
 
 #include "os_interface.c"
 
@@ -332,6 +374,8 @@ typedef u8 bool;
 #include "random.c"
 #include "color.c"
 #include "memory.c"
+#include "string_intern.c"
+#include "task.c"
 #include "input.c"
 
 #ifndef OOGABOOGA_HEADLESS
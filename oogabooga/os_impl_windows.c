@@ -664,14 +664,15 @@ DWORD WINAPI win32_thread_invoker(LPVOID param) {
 	timeBeginPeriod(1);
 #endif
 	
-	temporary_storage_init(t->temporary_storage_size);
-	
 	context = t->initial_context;
 	context.thread_id = GetCurrentThreadId();
 	
+	temporary_storage_init(t->temporary_storage_size);
+	
 	t->proc(t);
 	
-	heap_dealloc(temporary_storage);
+	temporary_storage_deinit();
+	heap_thread_cache_release();
 	
 	return 0;
 }
@@ -795,6 +796,45 @@ void os_binary_semaphore_signal(Binary_Semaphore *sem) {
 	SetEvent(sem->os_event);
 }
 
+// Needs -lsynchronization
+void os_wait_on_address(volatile u32 *address, u32 compare) {
+	WaitOnAddress(address, &compare, sizeof(u32), INFINITE);
+}
+void os_wake_one_on_address(volatile u32 *address) {
+	WakeByAddressSingle((PVOID)address);
+}
+void os_wake_all_on_address(volatile u32 *address) {
+	WakeByAddressAll((PVOID)address);
+}
+
+///
+// Fibers
+
+Fiber_Handle os_fiber_from_current_thread() {
+	if (IsThreadAFiber()) return GetCurrentFiber();
+	Fiber_Handle fiber = ConvertThreadToFiber(0);
+	assert(fiber, "Failed converting thread to fiber");
+	return fiber;
+}
+bool os_fiber_is_thread_a_fiber() {
+	return IsThreadAFiber();
+}
+void os_fiber_convert_to_thread() {
+	BOOL ok = ConvertFiberToThread();
+	assert(ok, "Failed converting fiber to thread");
+}
+Fiber_Handle os_fiber_create(Fiber_Proc proc, void *data, u64 stack_size) {
+	// Only one calling convention on x64, so Fiber_Proc is a valid LPFIBER_START_ROUTINE
+	Fiber_Handle fiber = CreateFiber((SIZE_T)stack_size, (LPFIBER_START_ROUTINE)proc, data);
+	assert(fiber, "Failed creating fiber");
+	return fiber;
+}
+void os_fiber_destroy(Fiber_Handle fiber) {
+	DeleteFiber(fiber);
+}
+void os_fiber_switch(Fiber_Handle fiber) {
+	SwitchToFiber(fiber);
+}
 
 void os_sleep(u32 ms) {
     Sleep(ms);
@@ -1383,6 +1423,32 @@ os_get_stack_trace(u64 *trace_count, Allocator allocator) {
 #endif // NOT DEBUG
 }
 
+string
+os_get_symbol_name_for_address(void *address, Allocator allocator) {
+#if CONFIGURATION == DEBUG
+	HANDLE process = GetCurrentProcess();
+	
+	DWORD64 displacement = 0;
+	char buffer[sizeof(SYMBOL_INFO) + WIN32_MAX_SYMBOL_NAME_LENGTH * sizeof(TCHAR)];
+	PSYMBOL_INFO symbol = (PSYMBOL_INFO)buffer;
+	symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+	symbol->MaxNameLen = WIN32_MAX_SYMBOL_NAME_LENGTH;
+	
+	if (SymFromAddr(process, (DWORD64)address, &displacement, symbol)) {
+		IMAGEHLP_LINE64 line;
+		DWORD displacement_line;
+		line.SizeOfStruct = sizeof(IMAGEHLP_LINE64);
+		
+		if (SymGetLineFromAddr64(process, (DWORD64)address, &displacement_line, &line)) {
+			return sprintf(allocator, "%cs:%d: %cs", line.FileName, line.LineNumber, symbol->Name);
+		}
+		return sprintf(allocator, "%cs", symbol->Name);
+	}
+#endif // DEBUG
+	
+	return sprintf(allocator, "0x%llx", (u64)address);
+}
+
 bool os_grow_program_memory(u64 new_size) {
 	os_lock_mutex(program_memory_mutex); // #Sync
 	if (program_memory_capacity >= new_size) {
@@ -1508,6 +1574,61 @@ os_lock_program_memory_pages(void *start, u64 size) {
 #endif
 }
 
+void*
+os_reserve_memory(u64 size) {
+	assert(size % os.page_size == 0, "size was not aligned to page size in os_reserve_memory");
+	return VirtualAlloc(0, size, MEM_RESERVE, PAGE_NOACCESS);
+}
+
+void
+os_release_memory(void *start, u64 size) {
+	(void)size;
+	BOOL ok = VirtualFree(start, 0, MEM_RELEASE);
+	assert(ok, "VirtualFree Failed with error %d", GetLastError());
+}
+
+void
+os_decommit_memory_pages(void *start, u64 size) {
+	assert((u64)start % os.page_size == 0, "When decommitting memory pages, the start address must be the start of a page");
+	assert(size       % os.page_size == 0, "When decommitting memory pages, the size must be aligned to page_size");
+	// Program memory is made of multiple VirtualAlloc regions and VirtualFree can't cross
+	// them, so we do one region at a time.
+	u8 *p = (u8*)start;
+	u8 *end = (u8*)start+size;
+	while (p < end) {
+		MEMORY_BASIC_INFORMATION info;
+		SIZE_T ok = VirtualQuery(p, &info, sizeof(info));
+		assert(ok, "VirtualQuery Failed with error %d", GetLastError());
+		u8 *region_end = (u8*)info.BaseAddress + info.RegionSize;
+		u64 n = (u64)(min(region_end, end) - p);
+		
+		BOOL freed = VirtualFree(p, n, MEM_DECOMMIT);
+		assert(freed, "VirtualFree Failed with error %d", GetLastError());
+		
+		p += n;
+	}
+}
+
+void
+os_commit_memory_pages(void *start, u64 size) {
+	assert((u64)start % os.page_size == 0, "When committing memory pages, the start address must be the start of a page");
+	assert(size       % os.page_size == 0, "When committing memory pages, the size must be aligned to page_size");
+	u8 *p = (u8*)start;
+	u8 *end = (u8*)start+size;
+	while (p < end) {
+		MEMORY_BASIC_INFORMATION info;
+		SIZE_T ok = VirtualQuery(p, &info, sizeof(info));
+		assert(ok, "VirtualQuery Failed with error %d", GetLastError());
+		u8 *region_end = (u8*)info.BaseAddress + info.RegionSize;
+		u64 n = (u64)(min(region_end, end) - p);
+		
+		void *result = VirtualAlloc(p, n, MEM_COMMIT, PAGE_READWRITE);
+		assert(result == p, "VirtualAlloc Failed with error %d", GetLastError());
+		
+		p += n;
+	}
+}
+
 ///
 ///
 // Mouse pointer
@@ -1984,6 +2105,14 @@ void os_update() {
 
 	has_os_update_been_called_at_all = true;
 
+#if ENABLE_HEAP_PROFILING && ENABLE_PROFILING
+	heap_profile_report_counter();
+#endif
+
+#if VERY_DEBUG
+	heap_validation_frame();
+#endif
+
 	win32_do_handle_raw_input = true;
 #ifndef OOGABOOGA_HEADLESS
 	window.dpi = window.monitor->dpi;
@@ -6,6 +6,7 @@
 	typedef HMODULE Dynamic_Library_Handle;
 	typedef HWND Window_Handle;
 	typedef HANDLE File;
+	typedef LPVOID Fiber_Handle;
 	
 #elif defined(__linux__)
     #ifndef OOGABOOGA_HEADLESS
@@ -16,6 +17,7 @@
 	typedef SOMETHING Dynamic_Library_Handle;
 	typedef SOMETHING Window_Handle;
 	typedef SOMETHING File;
+	typedef SOMETHING Fiber_Handle;
 	#error "Linux is not supported yet";
 #elif defined(__APPLE__) && defined(__MACH__)
 	typedef SOMETHING Mutex_Handle;
@@ -23,6 +25,7 @@
 	typedef SOMETHING Dynamic_Library_Handle;
 	typedef SOMETHING Window_Handle;
 	typedef SOMETHING File;
+	typedef SOMETHING Fiber_Handle;
 	#error "Mac is not supported yet";
 #else
 	#error "Current OS not supported!";
@@ -192,6 +195,49 @@ os_binary_semaphore_wait(Binary_Semaphore *sem);
 void ogb_instance
 os_binary_semaphore_signal(Binary_Semaphore *sem);
 
+///
+// Waiting on an address (futex)
+// Puts the thread to sleep if *address == compare, until someone wakes the address.
+// Can return without being woken, so check the value again in a loop.
+void ogb_instance
+os_wait_on_address(volatile u32 *address, u32 compare);
+
+void ogb_instance
+os_wake_one_on_address(volatile u32 *address);
+
+void ogb_instance
+os_wake_all_on_address(volatile u32 *address);
+
+///
+// Fibers
+// Cooperative threads of execution with their own stack, which only run when switched to.
+// A thread has to be made into a fiber before it can switch to other fibers.
+// Fibers stay on the thread they were switched to on.
+typedef void(*Fiber_Proc)(void *data);
+
+// Returns the fiber of the calling thread, converting the thread to a fiber if it isn't one
+Fiber_Handle ogb_instance
+os_fiber_from_current_thread();
+
+bool ogb_instance
+os_fiber_is_thread_a_fiber();
+
+// Undoes os_fiber_from_current_thread(). Only from the thread's own fiber, and the
+// thread's fiber handle is invalid after.
+void ogb_instance
+os_fiber_convert_to_thread();
+
+// proc must never return: switch to another fiber when it's done.
+Fiber_Handle ogb_instance
+os_fiber_create(Fiber_Proc proc, void *data, u64 stack_size);
+
+// Can't destroy the running fiber
+void ogb_instance
+os_fiber_destroy(Fiber_Handle fiber);
+
+void ogb_instance
+os_fiber_switch(Fiber_Handle fiber);
+
 ///
 // Threading utilities
 
@@ -446,6 +492,10 @@ os_get_number_of_logical_processors();
 ogb_instance string*
 os_get_stack_trace(u64 *trace_count, Allocator allocator);
 
+// "file:line: procedure" for a code address, or just the address if there are no debug symbols
+ogb_instance string
+os_get_symbol_name_for_address(void *address, Allocator allocator);
+
 inline void 
 dump_stack_trace() {
 	u64 count;
@@ -491,6 +541,26 @@ os_unlock_program_memory_pages(void *start, u64 size);
 void ogb_instance
 os_lock_program_memory_pages(void *start, u64 size);
 
+// Reserves address space outside of program memory without committing any of it.
+// Commit pages with os_commit_memory_pages() before touching them.
+// - size must be aligned to os.page_size
+// - Returns 0 on failure
+ogb_instance void*
+os_reserve_memory(u64 size);
+// Releases address space reserved with os_reserve_memory(), committed or not
+void ogb_instance
+os_release_memory(void *start, u64 size);
+
+// Gives the physical memory of the pages back to the OS. The address range stays ours, but
+// touching it will crash until it's committed again with os_commit_memory_pages().
+// Works on program memory and on memory from os_reserve_memory().
+// - start and size must be aligned to os.page_size
+// - Committed pages are unlocked and zeroed
+void ogb_instance
+os_decommit_memory_pages(void *start, u64 size);
+void ogb_instance
+os_commit_memory_pages(void *start, u64 size);
+
 ///
 ///
 // Mouse pointer
@@ -22,7 +22,7 @@ void dump_profile_result() {
 	
 	log_verbose("Wrote profiling result to google_trace.json");
 }
-void _profiler_report_time(string name, f64 count, f64 start) {
+void _profiler_init_if_needed() {
 	if (!profiler_initted) {
 		spinlock_init(&_profiler_lock);
 		profiler_initted = true;
@@ -30,6 +30,9 @@ void _profiler_report_time(string name, f64 count, f64 start) {
 		string_builder_init_reserve(&_profile_output, 1024*1000, get_heap_allocator());	
 		
 	}
+}
+void _profiler_report_time(string name, f64 count, f64 start) {
+	_profiler_init_if_needed();
 	
 	spinlock_acquire_or_wait(&_profiler_lock);
 	
@@ -61,4 +64,154 @@ void _profiler_report_time(string name, f64 count, f64 start) {
 	#define tm_scope(...)
 	#define tm_scope_var(...)
 	#define tm_scope_accum(...)
-#endif
\ No newline at end of file
+#endif
+
+///
+///
+// Heap profiling
+///
+// With ENABLE_HEAP_PROFILING, every heap allocation is attributed to the place alloc(),
+// alloc_uninitialized() or reallocate() was called from. Live bytes & counts are kept per
+// site in a fixed size open addressing table which is only ever inserted into, so it can
+// be updated with compare_and_swap and no lock.
+// Sites past HEAP_PROFILE_MAX_SITES are all counted in one overflow site.
+
+#if ENABLE_HEAP_PROFILING
+
+#ifndef HEAP_PROFILE_MAX_SITES
+	#define HEAP_PROFILE_MAX_SITES 4096
+#endif
+
+// Heap allocations made without alloc(), for example straight through heap_alloc()
+#define HEAP_PROFILE_UNKNOWN_SITE ((void*)1)
+
+typedef struct Heap_Profile_Site {
+	volatile u64 site; // Call site address, 0 if this slot is unused
+	volatile u64 live_bytes;
+	volatile u64 live_count;
+	volatile u64 total_count;
+} Heap_Profile_Site;
+
+// #Global
+ogb_instance Heap_Profile_Site heap_profile_sites[HEAP_PROFILE_MAX_SITES+1];
+ogb_instance volatile u64 heap_profile_live_bytes;
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+// Last one is the overflow site
+Heap_Profile_Site heap_profile_sites[HEAP_PROFILE_MAX_SITES+1];
+volatile u64 heap_profile_live_bytes = 0;
+#endif
+
+inline void
+heap_profile_add(volatile u64 *a, u64 delta) {
+	u64 old;
+	do {
+		old = *a;
+	} while (!compare_and_swap_64(a, old + delta, old));
+}
+
+// Returns the index of the site's slot, inserting it if it's new
+u32
+heap_profile_get_site_index(void *site) {
+	assert((HEAP_PROFILE_MAX_SITES & (HEAP_PROFILE_MAX_SITES-1)) == 0, "HEAP_PROFILE_MAX_SITES must be a power of two");
+	
+	if (!site) site = HEAP_PROFILE_UNKNOWN_SITE;
+	
+	u64 mask = HEAP_PROFILE_MAX_SITES-1;
+	u64 index = ((u64)site * 0x9E3779B97F4A7C15ull >> 32) & mask;
+	
+	for (u64 probe = 0; probe < HEAP_PROFILE_MAX_SITES; probe += 1) {
+		Heap_Profile_Site *slot = &heap_profile_sites[index];
+		u64 existing = slot->site;
+		if (existing == (u64)site) return (u32)index;
+		if (existing == 0) {
+			if (compare_and_swap_64(&slot->site, (u64)site, 0)) return (u32)index;
+			// Someone else took it just now, maybe for the same site
+			if (slot->site == (u64)site) return (u32)index;
+		}
+		index = (index + 1) & mask;
+	}
+	
+	heap_profile_sites[HEAP_PROFILE_MAX_SITES].site = (u64)HEAP_PROFILE_UNKNOWN_SITE;
+	return HEAP_PROFILE_MAX_SITES;
+}
+
+// Returns the site index to pass to heap_profile_track_dealloc()
+u32
+heap_profile_track_alloc(void *site, u64 size) {
+	u32 index = heap_profile_get_site_index(site);
+	Heap_Profile_Site *slot = &heap_profile_sites[index];
+	heap_profile_add(&slot->live_bytes, size);
+	heap_profile_add(&slot->live_count, 1);
+	heap_profile_add(&slot->total_count, 1);
+	heap_profile_add(&heap_profile_live_bytes, size);
+	return index;
+}
+void
+heap_profile_track_dealloc(u32 site_index, u64 size) {
+	assert(site_index <= HEAP_PROFILE_MAX_SITES, "Heap profile site index is corrupt");
+	Heap_Profile_Site *slot = &heap_profile_sites[site_index];
+	heap_profile_add(&slot->live_bytes, -size);
+	heap_profile_add(&slot->live_count, -1ull);
+	heap_profile_add(&heap_profile_live_bytes, -size);
+}
+
+int
+heap_profile_compare_sites(const void *a, const void *b) {
+	u64 a_bytes = ((Heap_Profile_Site*)a)->live_bytes;
+	u64 b_bytes = ((Heap_Profile_Site*)b)->live_bytes;
+	if (a_bytes == b_bytes) return 0;
+	return a_bytes > b_bytes ? -1 : 1;
+}
+
+// Logs the sites with the most live bytes, biggest first. 0 for all sites.
+void
+heap_profile_log_report(u64 max_sites) {
+	Allocator allocator = get_heap_allocator();
+	Heap_Profile_Site *sites = (Heap_Profile_Site*)alloc(allocator, sizeof(heap_profile_sites)*2);
+	Heap_Profile_Site *help_buffer = sites + HEAP_PROFILE_MAX_SITES+1;
+	
+	// Copying is racy, but each number is a consistent snapshot which is good enough here
+	u64 count = 0;
+	for (u64 i = 0; i <= HEAP_PROFILE_MAX_SITES; i += 1) {
+		if (heap_profile_sites[i].site && heap_profile_sites[i].live_count) {
+			sites[count] = heap_profile_sites[i];
+			count += 1;
+		}
+	}
+	merge_sort(sites, help_buffer, count, sizeof(Heap_Profile_Site), heap_profile_compare_sites);
+	
+	if (max_sites == 0 || max_sites > count) max_sites = count;
+	
+	log("Heap profile: %llu live bytes from %llu sites", heap_profile_live_bytes, count);
+	for (u64 i = 0; i < max_sites; i += 1) {
+		Heap_Profile_Site *site = &sites[i];
+		string where;
+		if (site->site == (u64)HEAP_PROFILE_UNKNOWN_SITE) {
+			where = STR("<not through alloc() or too many sites>");
+		} else {
+			where = os_get_symbol_name_for_address((void*)site->site, get_temporary_allocator());
+		}
+		log("    %llu bytes in %llu allocations (%llu total): %s", site->live_bytes, site->live_count, site->total_count, where);
+	}
+	
+	dealloc(allocator, sites);
+}
+
+// Writes the live heap bytes as a counter to google_trace.json.
+// Called each os_update() when ENABLE_PROFILING is on too.
+void
+heap_profile_report_counter() {
+	_profiler_init_if_needed();
+	
+	spinlock_acquire_or_wait(&_profiler_lock);
+	string_builder_print(
+		&_profile_output,
+		STR("{\"cat\":\"memory\",\"name\":\"Heap\",\"ph\":\"C\",\"pid\":0,\"ts\":%.3f,\"args\":{\"live bytes\":%llu}},"),
+		os_get_elapsed_seconds()*1000000,
+		heap_profile_live_bytes
+	);
+	spinlock_release(&_profiler_lock);
+}
+
+#endif // ENABLE_HEAP_PROFILING
@@ -0,0 +1,623 @@
+
+/*
+
+	Uniform grid spatial hash for broadphase collision & proximity queries.
+
+	Items are Vector2 AABBs with u32 ids. The grid is stored flat: one array of
+	(cell, item) entries sorted by bucket and an array of where each bucket starts, so
+	there are no per-cell lists. spatial_hash_rebuild() builds it with a counting sort.
+
+	Moving an item within the cells it covers only updates its AABB. An item which is
+	inserted or moves into other cells goes into the loose list, which every query also
+	checks. spatial_hash_update() rebuilds the grid once enough items are loose, so call
+	it once per frame after moving things. Items covering more than
+	SPATIAL_HASH_MAX_CELLS_PER_ITEM cells always stay loose.
+
+	Queries don't modify anything, so several threads can query at once. Inserting,
+	moving, removing & updating is not thread safe.
+
+	Pick a cell size around the size of a typical item.
+
+	Full API:
+
+		void spatial_hash_init(Spatial_Hash *h, f32 cell_size, Allocator allocator);
+		void spatial_hash_deinit(Spatial_Hash *h);
+
+		u32  spatial_hash_insert(Spatial_Hash *h, Vector2 min, Vector2 max);
+		// ids may be 0. Rebuilds the grid.
+		void spatial_hash_insert_batch(Spatial_Hash *h, Vector2 *mins, Vector2 *maxs, u64 count, u32 *ids);
+		void spatial_hash_move(Spatial_Hash *h, u32 id, Vector2 min, Vector2 max);
+		bool spatial_hash_remove(Spatial_Hash *h, u32 id);
+		void spatial_hash_get_aabb(Spatial_Hash *h, u32 id, Vector2 *min, Vector2 *max);
+		u64  spatial_hash_get_count(Spatial_Hash *h);
+
+		// Rebuilds if enough items are loose
+		void spatial_hash_update(Spatial_Hash *h);
+		void spatial_hash_rebuild(Spatial_Hash *h);
+
+		// Return how many items were found, but only write up to max_results ids
+		u64  spatial_hash_query_rect(Spatial_Hash *h, Vector2 min, Vector2 max, u32 *results, u64 max_results);
+		u64  spatial_hash_query_circle(Spatial_Hash *h, Vector2 center, f32 radius, u32 *results, u64 max_results);
+		// Closest item the ray hits within max_distance, which can be F32_MAX. direction doesn't
+		// need to be normalized.
+		bool spatial_hash_raycast(Spatial_Hash *h, Vector2 origin, Vector2 direction, f32 max_distance, u32 *hit_id, f32 *hit_distance);
+		// Calls proc once for every pair of overlapping items. proc may be 0 to only count.
+		u64  spatial_hash_find_pairs(Spatial_Hash *h, Spatial_Pair_Proc proc, void *data);
+
+	Usage:
+
+		Spatial_Hash h;
+		spatial_hash_init(&h, 64, get_heap_allocator());
+
+		for (u64 i = 0; i < thing_count; i += 1) {
+			things[i].spatial_id = spatial_hash_insert(&h, things[i].min, things[i].max);
+		}
+
+		// Every frame
+		for (u64 i = 0; i < thing_count; i += 1) {
+			spatial_hash_move(&h, things[i].spatial_id, things[i].min, things[i].max);
+		}
+		spatial_hash_update(&h);
+
+		spatial_hash_find_pairs(&h, on_overlap, 0);
+
+		u32 near[64];
+		u64 near_count = spatial_hash_query_circle(&h, player_pos, 200, near, 64);
+*/
+
+#define SPATIAL_HASH_MAX_CELLS_PER_ITEM 16
+// spatial_hash_update() rebuilds when more than max(this, count/16) items moved into the loose list
+#define SPATIAL_HASH_MIN_REBUILD_MOVES 256
+// Cell coordinates are clamped to this so huge AABBs & queries don't overflow
+#define SPATIAL_HASH_MAX_CELL (1 << 30)
+
+typedef void (*Spatial_Pair_Proc)(u32 a, u32 b, void *data);
+
+typedef enum Spatial_Item_State {
+	SPATIAL_ITEM_FREE,
+	SPATIAL_ITEM_GRID,
+	SPATIAL_ITEM_LOOSE,
+} Spatial_Item_State;
+
+typedef struct Spatial_Hash_Item {
+	Vector2 min;
+	Vector2 max;
+	// Cells covered as of the last rebuild. A grid item's AABB always stays inside them.
+	s32 cell_x0, cell_y0, cell_x1, cell_y1;
+	u32 loose_index;
+	Spatial_Item_State state;
+	bool large; // Counted in large_count
+} Spatial_Hash_Item;
+
+typedef struct Spatial_Hash {
+	Allocator allocator;
+	f32 cell_size;
+	f32 inverse_cell_size;
+
+	Spatial_Hash_Item *items; // Growing array, indexed by id
+	u32 *free_ids; // Growing array
+	u32 *loose; // Growing array of ids which aren't in the grid
+	u64 live_count;
+	u64 large_count; // Loose because they cover too many cells, as of the last rebuild
+	// Cells covered by grid items as of the last rebuild. Grid items don't leave their cells,
+	// so nothing in the grid is outside of these.
+	s32 grid_x0, grid_y0, grid_x1, grid_y1;
+
+	// Entries of bucket b are [bucket_starts[b], bucket_starts[b+1])
+	u32 *bucket_starts;
+	u64 bucket_bits;
+	u64 bucket_capacity;
+	u64 *entry_cells;
+	u32 *entry_items;
+	u64 entry_count;
+	u64 entry_capacity;
+} Spatial_Hash;
+
+void
+spatial_hash_init(Spatial_Hash *h, f32 cell_size, Allocator allocator) {
+	assert(cell_size > 0, "Spatial hash cell size must be more than 0");
+	*h = ZERO(Spatial_Hash);
+	h->allocator = allocator;
+	h->cell_size = cell_size;
+	h->inverse_cell_size = 1.0f/cell_size;
+	growing_array_init((void**)&h->items, sizeof(Spatial_Hash_Item), allocator);
+	growing_array_init((void**)&h->free_ids, sizeof(u32), allocator);
+	growing_array_init((void**)&h->loose, sizeof(u32), allocator);
+}
+void
+spatial_hash_deinit(Spatial_Hash *h) {
+	growing_array_deinit((void**)&h->items);
+	growing_array_deinit((void**)&h->free_ids);
+	growing_array_deinit((void**)&h->loose);
+	if (h->bucket_starts) dealloc(h->allocator, h->bucket_starts);
+	if (h->entry_cells)   dealloc(h->allocator, h->entry_cells);
+	if (h->entry_items)   dealloc(h->allocator, h->entry_items);
+	*h = ZERO(Spatial_Hash);
+}
+
+inline s32
+spatial_hash_get_cell(Spatial_Hash *h, f32 v) {
+	f32 c = floorf(v*h->inverse_cell_size);
+	return (s32)clamp(c, (f32)-SPATIAL_HASH_MAX_CELL, (f32)SPATIAL_HASH_MAX_CELL);
+}
+inline u64
+spatial_hash_get_cell_key(s32 x, s32 y) {
+	return ((u64)(u32)x << 32) | (u64)(u32)y;
+}
+inline u64
+spatial_hash_get_bucket(Spatial_Hash *h, u64 key) {
+	return (key*0x9E3779B97F4A7C15ULL) >> (64 - h->bucket_bits);
+}
+
+inline Spatial_Hash_Item*
+spatial_hash_get_item(Spatial_Hash *h, u32 id) {
+	assert(id < growing_array_get_valid_count(h->items) && h->items[id].state != SPATIAL_ITEM_FREE, "Invalid spatial hash id %u", id);
+	return &h->items[id];
+}
+
+void
+spatial_hash_make_loose(Spatial_Hash *h, u32 id) {
+	h->items[id].state = SPATIAL_ITEM_LOOSE;
+	h->items[id].loose_index = growing_array_get_valid_count(h->loose);
+	growing_array_add((void**)&h->loose, &id);
+}
+void
+spatial_hash_remove_loose(Spatial_Hash *h, u32 id) {
+	u32 index = h->items[id].loose_index;
+	u32 last = h->loose[growing_array_get_valid_count(h->loose)-1];
+	h->loose[index] = last;
+	h->items[last].loose_index = index;
+	growing_array_pop((void**)&h->loose);
+}
+
+u32
+spatial_hash_insert(Spatial_Hash *h, Vector2 min, Vector2 max) {
+	assert(min.x <= max.x && min.y <= max.y, "Spatial hash AABB min is more than max");
+
+	u32 id;
+	u32 free_count = growing_array_get_valid_count(h->free_ids);
+	if (free_count) {
+		id = h->free_ids[free_count-1];
+		growing_array_pop((void**)&h->free_ids);
+	} else {
+		id = growing_array_get_valid_count(h->items);
+		growing_array_add_empty((void**)&h->items);
+	}
+
+	h->items[id].min = min;
+	h->items[id].max = max;
+	h->items[id].large = false;
+	spatial_hash_make_loose(h, id);
+	h->live_count += 1;
+	return id;
+}
+
+void
+spatial_hash_move(Spatial_Hash *h, u32 id, Vector2 min, Vector2 max) {
+	assert(min.x <= max.x && min.y <= max.y, "Spatial hash AABB min is more than max");
+	Spatial_Hash_Item *item = spatial_hash_get_item(h, id);
+	item->min = min;
+	item->max = max;
+	if (item->state != SPATIAL_ITEM_GRID) return;
+
+	if (spatial_hash_get_cell(h, min.x) != item->cell_x0 || spatial_hash_get_cell(h, min.y) != item->cell_y0
+	 || spatial_hash_get_cell(h, max.x) != item->cell_x1 || spatial_hash_get_cell(h, max.y) != item->cell_y1) {
+		spatial_hash_make_loose(h, id);
+	}
+}
+
+bool
+spatial_hash_remove(Spatial_Hash *h, u32 id) {
+	if (id >= growing_array_get_valid_count(h->items) || h->items[id].state == SPATIAL_ITEM_FREE) return false;
+	if (h->items[id].state == SPATIAL_ITEM_LOOSE) spatial_hash_remove_loose(h, id);
+	if (h->items[id].large) h->large_count -= 1;
+	// Its grid entries are skipped until the next rebuild
+	h->items[id].state = SPATIAL_ITEM_FREE;
+	growing_array_add((void**)&h->free_ids, &id);
+	h->live_count -= 1;
+	return true;
+}
+
+void
+spatial_hash_get_aabb(Spatial_Hash *h, u32 id, Vector2 *min, Vector2 *max) {
+	Spatial_Hash_Item *item = spatial_hash_get_item(h, id);
+	*min = item->min;
+	*max = item->max;
+}
+u64
+spatial_hash_get_count(Spatial_Hash *h) {
+	return h->live_count;
+}
+
+void
+spatial_hash_rebuild(Spatial_Hash *h) {
+	growing_array_clear((void**)&h->loose);
+	h->large_count = 0;
+	h->grid_x0 = h->grid_y0 = SPATIAL_HASH_MAX_CELL;
+	h->grid_x1 = h->grid_y1 = -SPATIAL_HASH_MAX_CELL;
+
+	u32 item_count = growing_array_get_valid_count(h->items);
+	u64 entry_count = 0;
+	for (u32 id = 0; id < item_count; id += 1) {
+		Spatial_Hash_Item *item = &h->items[id];
+		if (item->state == SPATIAL_ITEM_FREE) continue;
+
+		item->cell_x0 = spatial_hash_get_cell(h, item->min.x);
+		item->cell_y0 = spatial_hash_get_cell(h, item->min.y);
+		item->cell_x1 = spatial_hash_get_cell(h, item->max.x);
+		item->cell_y1 = spatial_hash_get_cell(h, item->max.y);
+		u64 cells = (u64)(item->cell_x1 - item->cell_x0 + 1)*(u64)(item->cell_y1 - item->cell_y0 + 1);
+		item->large = cells > SPATIAL_HASH_MAX_CELLS_PER_ITEM;
+		if (item->large) {
+			spatial_hash_make_loose(h, id);
+			h->large_count += 1;
+			continue;
+		}
+		item->state = SPATIAL_ITEM_GRID;
+		entry_count += cells;
+		h->grid_x0 = min(h->grid_x0, item->cell_x0);
+		h->grid_y0 = min(h->grid_y0, item->cell_y0);
+		h->grid_x1 = max(h->grid_x1, item->cell_x1);
+		h->grid_y1 = max(h->grid_y1, item->cell_y1);
+	}
+	assert(entry_count < 0xFFFFFFFF, "Too many spatial hash entries");
+
+	// About two buckets per entry, so most buckets hold a single cell
+	u64 bucket_count = get_next_power_of_two(max(entry_count*2, 1024));
+	if (bucket_count+1 > h->bucket_capacity) {
+		if (h->bucket_starts) dealloc(h->allocator, h->bucket_starts);
+		h->bucket_capacity = bucket_count+1;
+		h->bucket_starts = (u32*)alloc(h->allocator, h->bucket_capacity*sizeof(u32));
+	}
+	if (entry_count > h->entry_capacity) {
+		if (h->entry_cells) dealloc(h->allocator, h->entry_cells);
+		if (h->entry_items) dealloc(h->allocator, h->entry_items);
+		h->entry_capacity = get_next_power_of_two(entry_count);
+		h->entry_cells = (u64*)alloc(h->allocator, h->entry_capacity*sizeof(u64));
+		h->entry_items = (u32*)alloc(h->allocator, h->entry_capacity*sizeof(u32));
+	}
+	h->bucket_bits = bit_scan_forward_64(bucket_count);
+	h->entry_count = entry_count;
+
+	// Counting sort by bucket. Counts go one bucket up so the prefix sum gives each bucket's start.
+	u32 *starts = h->bucket_starts;
+	memset(starts, 0, (bucket_count+1)*sizeof(u32));
+	for (u32 id = 0; id < item_count; id += 1) {
+		Spatial_Hash_Item *item = &h->items[id];
+		if (item->state != SPATIAL_ITEM_GRID) continue;
+		for (s32 y = item->cell_y0; y <= item->cell_y1; y += 1) {
+			for (s32 x = item->cell_x0; x <= item->cell_x1; x += 1) {
+				starts[spatial_hash_get_bucket(h, spatial_hash_get_cell_key(x, y)) + 1] += 1;
+			}
+		}
+	}
+	for (u64 b = 1; b <= bucket_count; b += 1) starts[b] += starts[b-1];
+
+	// Scattering moves each start to the end of its bucket, which is the next bucket's start
+	for (u32 id = 0; id < item_count; id += 1) {
+		Spatial_Hash_Item *item = &h->items[id];
+		if (item->state != SPATIAL_ITEM_GRID) continue;
+		for (s32 y = item->cell_y0; y <= item->cell_y1; y += 1) {
+			for (s32 x = item->cell_x0; x <= item->cell_x1; x += 1) {
+				u64 key = spatial_hash_get_cell_key(x, y);
+				u32 e = starts[spatial_hash_get_bucket(h, key)]++;
+				h->entry_cells[e] = key;
+				h->entry_items[e] = id;
+			}
+		}
+	}
+	for (u64 b = bucket_count; b > 0; b -= 1) starts[b] = starts[b-1];
+	starts[0] = 0;
+}
+
+void
+spatial_hash_update(Spatial_Hash *h) {
+	u64 moved = growing_array_get_valid_count(h->loose) - min(h->large_count, growing_array_get_valid_count(h->loose));
+	if (moved > max(SPATIAL_HASH_MIN_REBUILD_MOVES, h->live_count/16)) spatial_hash_rebuild(h);
+}
+
+void
+spatial_hash_insert_batch(Spatial_Hash *h, Vector2 *mins, Vector2 *maxs, u64 count, u32 *ids) {
+	for (u64 i = 0; i < count; i += 1) {
+		u32 id = spatial_hash_insert(h, mins[i], maxs[i]);
+		if (ids) ids[i] = id;
+	}
+	spatial_hash_rebuild(h);
+}
+
+///
+// Queries
+
+typedef void (*Spatial_Visit_Proc)(Spatial_Hash *h, u32 id, void *data);
+
+// Calls proc once for every grid item whose cells overlap the cell range. An item covering
+// several of the cells is only visited in the first one, so nothing needs to remember what
+// was visited.
+void
+spatial_hash_visit_grid(Spatial_Hash *h, s32 x0, s32 y0, s32 x1, s32 y1, Spatial_Visit_Proc proc, void *data) {
+	if (!h->entry_count) return;
+
+	u64 query_cells = (u64)(x1 - x0 + 1)*(u64)(y1 - y0 + 1);
+	if (query_cells > h->entry_count) {
+		// Cheaper to go through every entry
+		for (u64 e = 0; e < h->entry_count; e += 1) {
+			u64 key = h->entry_cells[e];
+			s32 x = (s32)(u32)(key >> 32);
+			s32 y = (s32)(u32)key;
+			if (x < x0 || x > x1 || y < y0 || y > y1) continue;
+			u32 id = h->entry_items[e];
+			Spatial_Hash_Item *item = &h->items[id];
+			if (item->state != SPATIAL_ITEM_GRID) continue;
+			if (x != max(item->cell_x0, x0) || y != max(item->cell_y0, y0)) continue;
+			proc(h, id, data);
+		}
+		return;
+	}
+
+	for (s32 y = y0; y <= y1; y += 1) {
+		for (s32 x = x0; x <= x1; x += 1) {
+			u64 key = spatial_hash_get_cell_key(x, y);
+			u64 b = spatial_hash_get_bucket(h, key);
+			for (u32 e = h->bucket_starts[b]; e < h->bucket_starts[b+1]; e += 1) {
+				if (h->entry_cells[e] != key) continue;
+				u32 id = h->entry_items[e];
+				Spatial_Hash_Item *item = &h->items[id];
+				if (item->state != SPATIAL_ITEM_GRID) continue;
+				if (x != max(item->cell_x0, x0) || y != max(item->cell_y0, y0)) continue;
+				proc(h, id, data);
+			}
+		}
+	}
+}
+
+inline bool
+spatial_aabbs_overlap(Vector2 a_min, Vector2 a_max, Vector2 b_min, Vector2 b_max) {
+	return a_min.x <= b_max.x && a_max.x >= b_min.x && a_min.y <= b_max.y && a_max.y >= b_min.y;
+}
+inline bool
+spatial_circle_overlaps_aabb(Vector2 center, f32 radius, Vector2 min, Vector2 max) {
+	f32 dx = center.x - clamp(center.x, min.x, max.x);
+	f32 dy = center.y - clamp(center.y, min.y, max.y);
+	return dx*dx + dy*dy <= radius*radius;
+}
+
+typedef struct Spatial_Query {
+	Vector2 min;
+	Vector2 max;
+	bool circle;
+	Vector2 center;
+	f32 radius;
+
+	u32 *results;
+	u64 max_results;
+	u64 count;
+} Spatial_Query;
+
+inline bool
+spatial_query_test(Spatial_Query *q, Spatial_Hash_Item *item) {
+	if (!spatial_aabbs_overlap(q->min, q->max, item->min, item->max)) return false;
+	return !q->circle || spatial_circle_overlaps_aabb(q->center, q->radius, item->min, item->max);
+}
+void
+spatial_query_visit(Spatial_Hash *h, u32 id, void *data) {
+	Spatial_Query *q = (Spatial_Query*)data;
+	if (!spatial_query_test(q, &h->items[id])) return;
+	if (q->count < q->max_results) q->results[q->count] = id;
+	q->count += 1;
+}
+
+u64
+spatial_hash_run_query(Spatial_Hash *h, Spatial_Query *q) {
+	spatial_hash_visit_grid(h,
+		spatial_hash_get_cell(h, q->min.x), spatial_hash_get_cell(h, q->min.y),
+		spatial_hash_get_cell(h, q->max.x), spatial_hash_get_cell(h, q->max.y),
+		spatial_query_visit, q);
+
+	u32 loose_count = growing_array_get_valid_count(h->loose);
+	for (u32 i = 0; i < loose_count; i += 1) {
+		spatial_query_visit(h, h->loose[i], q);
+	}
+	return q->count;
+}
+
+u64
+spatial_hash_query_rect(Spatial_Hash *h, Vector2 min, Vector2 max, u32 *results, u64 max_results) {
+	Spatial_Query q = ZERO(Spatial_Query);
+	q.min = min;
+	q.max = max;
+	q.results = results;
+	q.max_results = max_results;
+	return spatial_hash_run_query(h, &q);
+}
+u64
+spatial_hash_query_circle(Spatial_Hash *h, Vector2 center, f32 radius, u32 *results, u64 max_results) {
+	Spatial_Query q = ZERO(Spatial_Query);
+	q.min = v2(center.x - radius, center.y - radius);
+	q.max = v2(center.x + radius, center.y + radius);
+	q.circle = true;
+	q.center = center;
+	q.radius = radius;
+	q.results = results;
+	q.max_results = max_results;
+	return spatial_hash_run_query(h, &q);
+}
+
+// Slab test, t_in & t_out are where the ray enters and leaves the box (t_in is negative if
+// the origin is inside). An axis the ray is parallel to is checked on the origin instead,
+// because its infinite inverse_direction times 0 is NaN when the origin is on the box's edge.
+inline bool
+spatial_ray_clip_aabb(Vector2 origin, Vector2 direction, Vector2 inverse_direction, Vector2 min, Vector2 max, f32 *t_in, f32 *t_out) {
+	f32 enter = -F32_MAX;
+	f32 leave = F32_MAX;
+	if (direction.x == 0) {
+		if (origin.x < min.x || origin.x > max.x) return false;
+	} else {
+		f32 t0 = (min.x - origin.x)*inverse_direction.x;
+		f32 t1 = (max.x - origin.x)*inverse_direction.x;
+		enter = max(enter, min(t0, t1));
+		leave = min(leave, max(t0, t1));
+	}
+	if (direction.y == 0) {
+		if (origin.y < min.y || origin.y > max.y) return false;
+	} else {
+		f32 t0 = (min.y - origin.y)*inverse_direction.y;
+		f32 t1 = (max.y - origin.y)*inverse_direction.y;
+		enter = max(enter, min(t0, t1));
+		leave = min(leave, max(t0, t1));
+	}
+	if (leave < 0 || enter > leave) return false;
+	*t_in = enter;
+	*t_out = leave;
+	return true;
+}
+inline bool
+spatial_ray_hits_aabb(Vector2 origin, Vector2 direction, Vector2 inverse_direction, Vector2 min, Vector2 max, f32 *t) {
+	f32 t_in, t_out;
+	if (!spatial_ray_clip_aabb(origin, direction, inverse_direction, min, max, &t_in, &t_out)) return false;
+	*t = max(t_in, 0);
+	return true;
+}
+
+// Walks the cells along the ray in order (Amanatides & Woo) and stops once the next cell
+// starts further away than the closest hit so far, or the ray leaves the grid's cells.
+bool
+spatial_hash_raycast(Spatial_Hash *h, Vector2 origin, Vector2 direction, f32 max_distance, u32 *hit_id, f32 *hit_distance) {
+	f32 length = v2_length(direction);
+	assert(length > 0, "Spatial hash raycast direction is zero");
+	assert(max_distance >= 0, "Spatial hash raycast max_distance is negative");
+	direction = v2(direction.x/length, direction.y/length);
+	Vector2 inverse = v2(1.0f/direction.x, 1.0f/direction.y);
+
+	f32 best_t = max_distance;
+	bool found = false;
+	u32 best_id = 0;
+
+	u32 loose_count = growing_array_get_valid_count(h->loose);
+	for (u32 i = 0; i < loose_count; i += 1) {
+		Spatial_Hash_Item *item = &h->items[h->loose[i]];
+		f32 t;
+		if (spatial_ray_hits_aabb(origin, direction, inverse, item->min, item->max, &t) && t <= best_t && (!found || t < best_t)) {
+			best_t = t;
+			best_id = h->loose[i];
+			found = true;
+		}
+	}
+
+	// Only the grid's cells can hold grid items. Start where the ray enters them and stop where
+	// it leaves, so a far away origin or a huge max_distance doesn't walk empty cells.
+	Vector2 grid_min = v2((f32)h->grid_x0*h->cell_size, (f32)h->grid_y0*h->cell_size);
+	Vector2 grid_max = v2((f32)(h->grid_x1 + 1)*h->cell_size, (f32)(h->grid_y1 + 1)*h->cell_size);
+	f32 grid_t_in, grid_t_out;
+	if (h->entry_count && spatial_ray_clip_aabb(origin, direction, inverse, grid_min, grid_max, &grid_t_in, &grid_t_out)) {
+		f32 cell_t = max(grid_t_in, 0);
+		Vector2 start = v2(origin.x + direction.x*cell_t, origin.y + direction.y*cell_t);
+		s32 x = clamp(spatial_hash_get_cell(h, start.x), h->grid_x0, h->grid_x1);
+		s32 y = clamp(spatial_hash_get_cell(h, start.y), h->grid_y0, h->grid_y1);
+		s32 step_x = direction.x > 0 ? 1 : -1;
+		s32 step_y = direction.y > 0 ? 1 : -1;
+		f32 next_x = direction.x != 0 ? ((f32)(x + (step_x > 0))*h->cell_size - origin.x)*inverse.x : F32_MAX;
+		f32 next_y = direction.y != 0 ? ((f32)(y + (step_y > 0))*h->cell_size - origin.y)*inverse.y : F32_MAX;
+		f32 delta_x = direction.x != 0 ? h->cell_size*fabsf(inverse.x) : F32_MAX;
+		f32 delta_y = direction.y != 0 ? h->cell_size*fabsf(inverse.y) : F32_MAX;
+
+		while (cell_t <= best_t && cell_t <= grid_t_out) {
+			u64 key = spatial_hash_get_cell_key(x, y);
+			u64 b = spatial_hash_get_bucket(h, key);
+			for (u32 e = h->bucket_starts[b]; e < h->bucket_starts[b+1]; e += 1) {
+				if (h->entry_cells[e] != key) continue;
+				u32 id = h->entry_items[e];
+				Spatial_Hash_Item *item = &h->items[id];
+				if (item->state != SPATIAL_ITEM_GRID) continue;
+				f32 t;
+				if (spatial_ray_hits_aabb(origin, direction, inverse, item->min, item->max, &t) && t <= best_t && (!found || t < best_t)) {
+					best_t = t;
+					best_id = id;
+					found = true;
+				}
+			}
+
+			if (next_x < next_y) {
+				cell_t = next_x;
+				next_x += delta_x;
+				x += step_x;
+			} else {
+				cell_t = next_y;
+				next_y += delta_y;
+				y += step_y;
+			}
+			if (x < h->grid_x0 || x > h->grid_x1 || y < h->grid_y0 || y > h->grid_y1) break;
+		}
+	}
+
+	if (found) {
+		if (hit_id) *hit_id = best_id;
+		if (hit_distance) *hit_distance = best_t;
+	}
+	return found;
+}
+
+typedef struct Spatial_Pair_Query {
+	u32 id;
+	Spatial_Hash_Item *item;
+	Spatial_Pair_Proc proc;
+	void *data;
+	u64 count;
+} Spatial_Pair_Query;
+void
+spatial_pair_visit(Spatial_Hash *h, u32 id, void *data) {
+	Spatial_Pair_Query *q = (Spatial_Pair_Query*)data;
+	Spatial_Hash_Item *other = &h->items[id];
+	if (!spatial_aabbs_overlap(q->item->min, q->item->max, other->min, other->max)) return;
+	if (q->proc) q->proc(q->id, id, q->data);
+	q->count += 1;
+}
+
+u64
+spatial_hash_find_pairs(Spatial_Hash *h, Spatial_Pair_Proc proc, void *data) {
+	u64 count = 0;
+
+	// Grid vs grid. Two items meet in every cell they share, the pair is reported in the first one.
+	u64 bucket_count = h->entry_count ? (1ULL << h->bucket_bits) : 0;
+	for (u64 b = 0; b < bucket_count; b += 1) {
+		u32 start = h->bucket_starts[b];
+		u32 end = h->bucket_starts[b+1];
+		for (u32 i = start; i + 1 < end; i += 1) {
+			u32 a_id = h->entry_items[i];
+			Spatial_Hash_Item *a = &h->items[a_id];
+			if (a->state != SPATIAL_ITEM_GRID) continue;
+			u64 key = h->entry_cells[i];
+			s32 x = (s32)(u32)(key >> 32);
+			s32 y = (s32)(u32)key;
+			for (u32 j = i + 1; j < end; j += 1) {
+				if (h->entry_cells[j] != key) continue;
+				u32 b_id = h->entry_items[j];
+				Spatial_Hash_Item *other = &h->items[b_id];
+				if (other->state != SPATIAL_ITEM_GRID) continue;
+				if (x != max(a->cell_x0, other->cell_x0) || y != max(a->cell_y0, other->cell_y0)) continue;
+				if (!spatial_aabbs_overlap(a->min, a->max, other->min, other->max)) continue;
+				if (proc) proc(a_id, b_id, data);
+				count += 1;
+			}
+		}
+	}
+
+	// Loose vs grid & loose vs loose
+	u32 loose_count = growing_array_get_valid_count(h->loose);
+	for (u32 i = 0; i < loose_count; i += 1) {
+		Spatial_Pair_Query q = ZERO(Spatial_Pair_Query);
+		q.id = h->loose[i];
+		q.item = &h->items[q.id];
+		q.proc = proc;
+		q.data = data;
+		spatial_hash_visit_grid(h,
+			spatial_hash_get_cell(h, q.item->min.x), spatial_hash_get_cell(h, q.item->min.y),
+			spatial_hash_get_cell(h, q.item->max.x), spatial_hash_get_cell(h, q.item->max.y),
+			spatial_pair_visit, &q);
+		for (u32 j = i + 1; j < loose_count; j += 1) {
+			spatial_pair_visit(h, h->loose[j], &q);
+		}
+		count += q.count;
+	}
+
+	return count;
+}
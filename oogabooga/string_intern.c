@@ -0,0 +1,181 @@
+
+/*
+
+	Global string intern pool.
+
+	intern_string() gives each distinct string a dense u32 Atom, starting at 1. The same
+	string always gives the same atom, so comparing interned strings is comparing atoms
+	and an atom can be used as a hash map key as-is.
+	Atom 0 (ATOM_NONE) is never a valid atom.
+
+	Interned strings are copied into storage which never moves or is freed, so the string
+	from atom_get_string() stays valid for the rest of the program.
+
+	Interning a new string takes a lock. Looking up a string that's already interned
+	(find_atom(), and intern_string() when the string is already there) and
+	atom_get_string() don't take any locks, so any thread can resolve atoms without
+	contention.
+
+	Full API:
+
+		Atom   intern_string(string s);
+		// Returns ATOM_NONE if s was never interned
+		Atom   find_atom(string s);
+		string atom_get_string(Atom atom);
+		u64    atom_get_hash(Atom atom); // Same as string_get_hash() on the string
+		u64    get_atom_count();
+
+	Usage:
+
+		Atom player = intern_string(STR("player"));
+		...
+		if (intern_string(message_type) == player) { ... }
+
+		log("%s", atom_get_string(player));
+*/
+
+typedef u32 Atom;
+#define ATOM_NONE ((Atom)0)
+
+// Address space reserved up front. Nothing is committed until it's used.
+#ifndef ATOM_MAX_COUNT
+	#define ATOM_MAX_COUNT (1 << 24)
+#endif
+#ifndef INTERN_STRING_STORAGE_RESERVE
+	#define INTERN_STRING_STORAGE_RESERVE GB(1)
+#endif
+
+typedef struct Atom_Entry {
+	string s;
+	u64 hash;
+} Atom_Entry;
+
+// Slots are (hash >> 32) << 32 | atom, 0 for empty.
+// Tables are never written to after they are replaced and never freed, so a reader who
+// loaded an old table can keep probing it.
+typedef struct Intern_Table {
+	u64 mask;
+	u64 slots[];
+} Intern_Table;
+
+// #Global
+ogb_instance Spinlock intern_lock;
+ogb_instance Arena intern_entries;
+ogb_instance Arena intern_string_storage;
+ogb_instance Intern_Table *volatile intern_table;
+ogb_instance volatile u64 intern_atom_count;
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+Spinlock intern_lock = {0};
+Arena intern_entries = {0};
+Arena intern_string_storage = {0};
+Intern_Table *volatile intern_table = 0;
+volatile u64 intern_atom_count = 0;
+#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
+
+inline Atom_Entry *intern_get_entry(Atom atom) {
+	return (Atom_Entry*)intern_entries.start + (atom-1);
+}
+
+// Lock free. Returns ATOM_NONE if not in the table.
+Atom intern_table_find(Intern_Table *table, string s, u64 hash) {
+	u64 tag = hash >> 32;
+	for (u64 i = hash & table->mask;; i = (i+1) & table->mask) {
+		u64 slot = table->slots[i];
+		if (!slot) return ATOM_NONE;
+		if ((slot >> 32) == tag) {
+			Atom atom = (Atom)(slot & 0xFFFFFFFF);
+			Atom_Entry *entry = intern_get_entry(atom);
+			if (entry->hash == hash && strings_match(entry->s, s)) return atom;
+		}
+	}
+}
+
+void intern_table_insert(Intern_Table *table, u64 hash, Atom atom) {
+	u64 i = hash & table->mask;
+	while (table->slots[i]) i = (i+1) & table->mask;
+	// One aligned 64-bit store, so readers see the slot as either empty or complete
+	table->slots[i] = ((hash >> 32) << 32) | (u64)atom;
+}
+
+Intern_Table *make_intern_table(u64 slot_count) {
+	Intern_Table *table = (Intern_Table*)alloc(get_heap_allocator(), sizeof(Intern_Table) + slot_count*sizeof(u64));
+	memset(table->slots, 0, slot_count*sizeof(u64));
+	table->mask = slot_count-1;
+	return table;
+}
+
+Atom find_atom(string s) {
+	Intern_Table *table = intern_table;
+	if (!table) return ATOM_NONE;
+	return intern_table_find(table, s, string_get_hash(s));
+}
+
+Atom intern_string(string s) {
+	u64 hash = string_get_hash(s);
+
+	Intern_Table *table = intern_table;
+	if (table) {
+		Atom atom = intern_table_find(table, s, hash);
+		if (atom) return atom;
+	}
+
+	spinlock_acquire_or_wait(&intern_lock);
+
+	if (!intern_table) {
+		intern_entries = make_growing_arena(ATOM_MAX_COUNT*sizeof(Atom_Entry));
+		intern_string_storage = make_growing_arena(INTERN_STRING_STORAGE_RESERVE);
+		intern_table = make_intern_table(1024);
+	}
+
+	// Someone might have interned it since we looked
+	table = intern_table;
+	Atom atom = intern_table_find(table, s, hash);
+	if (atom) {
+		spinlock_release(&intern_lock);
+		return atom;
+	}
+
+	assert(intern_atom_count < ATOM_MAX_COUNT, "Interned more than ATOM_MAX_COUNT strings");
+	atom = (Atom)(intern_atom_count+1);
+
+	Atom_Entry *entry = (Atom_Entry*)arena_push(&intern_entries, sizeof(Atom_Entry));
+	entry->s.count = s.count;
+	entry->s.data = (u8*)arena_push(&intern_string_storage, s.count);
+	memcpy(entry->s.data, s.data, s.count);
+	entry->hash = hash;
+
+	// Keep the table at most half full
+	if ((intern_atom_count+1)*2 > table->mask+1) {
+		Intern_Table *new_table = make_intern_table((table->mask+1)*2);
+		for (u64 i = 0; i <= table->mask; i += 1) {
+			u64 slot = table->slots[i];
+			if (slot) intern_table_insert(new_table, intern_get_entry((Atom)(slot & 0xFFFFFFFF))->hash, (Atom)(slot & 0xFFFFFFFF));
+		}
+		table = new_table;
+	}
+
+	// The entry (and count) must be visible before the slot pointing to it, and a new
+	// table must be filled before it's published.
+	intern_atom_count += 1;
+	MEMORY_BARRIER;
+	intern_table_insert(table, hash, atom);
+	MEMORY_BARRIER;
+	intern_table = table;
+
+	spinlock_release(&intern_lock);
+
+	return atom;
+}
+
+string atom_get_string(Atom atom) {
+	assert(atom != ATOM_NONE && atom <= intern_atom_count, "Invalid atom %u", atom);
+	return intern_get_entry(atom)->s;
+}
+u64 atom_get_hash(Atom atom) {
+	assert(atom != ATOM_NONE && atom <= intern_atom_count, "Invalid atom %u", atom);
+	return intern_get_entry(atom)->hash;
+}
+u64 get_atom_count() {
+	return intern_atom_count;
+}
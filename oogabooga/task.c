@@ -0,0 +1,338 @@
+
+/*
+
+	Async tasks.
+
+	A task is a proc running on its own fiber. It runs until it awaits something and then
+	task_update() moves on to the next task. On the first task_update() after the thing it
+	waited on is done, the task continues where it left off. Loading, timers and network
+	flows can be written as straight line code, without blocking the frame and without an
+	OS thread per task.
+
+	All tasks run one at a time on the thread calling task_update(), so they can touch the
+	same data as that thread without locking. Blocking work goes to the job system with
+	task_await_job(), or task_read_entire_file() for the common case, which runs it on a
+	worker while the task waits.
+
+	Not thread safe: spawn tasks and call task_update() from the same thread.
+	Tasks share the thread's context, so don't await between push_context() & pop_context().
+	Temporary storage can be reset while a task waits, so don't keep temp memory across awaits.
+
+	Full API:
+
+		Task_Handle task_spawn(Task_Proc proc, void *data);
+		// Runs every ready task until it awaits or returns. Call it once per frame.
+		void task_update();
+		// Finished tasks are released, so a stale handle is a done task
+		bool task_is_done(Task_Handle task);
+		u64  task_get_count();
+
+		// Only from inside a task
+		bool task_is_running_in_task();
+		// Continue on the next task_update()
+		void task_yield();
+		void task_sleep(f64 seconds);
+		void task_await_counter(Job_Counter *counter);
+		void task_await_task(Task_Handle task);
+		// Polled on every task_update() until it returns true
+		void task_await_condition(Task_Condition_Proc condition, void *data);
+		// Runs proc on the job system
+		void task_await_job(Job_Proc proc, void *data);
+		bool task_read_entire_file(string path, string *result, Allocator allocator);
+
+		// Frees all fibers and drops unfinished tasks without resuming them. Turns the
+		// thread back from a fiber if task_update() made it one. Tasks can be spawned again after.
+		void task_system_shutdown();
+
+	Usage:
+
+		void load_level_task(void *data) {
+			Level *level = (Level*)data;
+
+			string text;
+			if (!task_read_entire_file(STR("res/level.txt"), &text, get_heap_allocator())) return;
+			parse_level(level, text);
+
+			level->background = task_load_image_from_disk(STR("res/background.png"), get_heap_allocator());
+
+			task_sleep(0.5);
+			level->loaded = true;
+		}
+
+		task_spawn(load_level_task, &level);
+
+		while (!window.should_close) {
+			reset_temporary_storage();
+			task_update();
+			...
+			os_update();
+			gfx_update();
+		}
+*/
+
+typedef Object_Handle Task_Handle;
+typedef void (*Task_Proc)(void *data);
+typedef bool (*Task_Condition_Proc)(void *data);
+
+// Committed stack per task fiber. On Windows the fiber reserves the executable's default
+// stack size and grows into it, so this doesn't limit how deep task procs can go.
+#ifndef TASK_FIBER_STACK_SIZE
+	#define TASK_FIBER_STACK_SIZE KB(64)
+#endif
+
+typedef enum Task_Wait_Kind {
+	TASK_WAIT_NONE,
+	TASK_WAIT_TIME,
+	TASK_WAIT_COUNTER,
+	TASK_WAIT_TASK,
+	TASK_WAIT_CONDITION,
+} Task_Wait_Kind;
+
+typedef struct Task Task;
+
+// Fibers are kept when their task is done and reused for the next task
+typedef struct Task_Fiber {
+	Fiber_Handle fiber;
+	Task *task;
+} Task_Fiber;
+
+typedef struct Task {
+	Task_Proc proc;
+	void *data;
+	Task_Fiber *fiber; // 0 until the task first runs
+	bool done;
+
+	Task_Wait_Kind wait_kind;
+	f64 wake_time;
+	Job_Counter *counter;
+	Task_Handle other;
+	Task_Condition_Proc condition;
+	void *condition_data;
+} Task;
+
+Task_Handle ogb_instance
+task_spawn(Task_Proc proc, void *data);
+
+void ogb_instance
+task_update();
+
+bool ogb_instance
+task_is_done(Task_Handle task);
+
+u64 ogb_instance
+task_get_count();
+
+bool ogb_instance
+task_is_running_in_task();
+
+void ogb_instance
+task_yield();
+
+void ogb_instance
+task_sleep(f64 seconds);
+
+void ogb_instance
+task_await_counter(Job_Counter *counter);
+
+void ogb_instance
+task_await_task(Task_Handle task);
+
+void ogb_instance
+task_await_condition(Task_Condition_Proc condition, void *data);
+
+void ogb_instance
+task_await_job(Job_Proc proc, void *data);
+
+bool ogb_instance
+task_read_entire_file(string path, string *result, Allocator allocator);
+
+void ogb_instance
+task_system_shutdown();
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+
+// #Global
+Object_Pool task_pool = {0};
+Task_Fiber **task_free_fibers = 0; // Growing array
+Fiber_Handle task_scheduler_fiber = 0;
+bool task_converted_thread = false; // If task_update() made the thread a fiber
+Task *task_current = 0;
+
+void task_fiber_proc(void *data) {
+	Task_Fiber *f = (Task_Fiber*)data;
+	while (true) {
+		f->task->proc(f->task->data);
+		f->task->done = true;
+		os_fiber_switch(task_scheduler_fiber);
+	}
+}
+
+Task_Fiber *task_get_fiber() {
+	if (growing_array_get_valid_count(task_free_fibers)) {
+		Task_Fiber *f = task_free_fibers[growing_array_get_valid_count(task_free_fibers)-1];
+		growing_array_pop((void**)&task_free_fibers);
+		return f;
+	}
+
+	Task_Fiber *f = (Task_Fiber*)alloc(get_heap_allocator(), sizeof(Task_Fiber));
+	f->fiber = os_fiber_create(task_fiber_proc, f, TASK_FIBER_STACK_SIZE);
+	return f;
+}
+
+Task_Handle task_spawn(Task_Proc proc, void *data) {
+	assert(proc, "Task proc is null");
+	if (!task_pool.item_size) {
+		object_pool_init(&task_pool, sizeof(Task), 64, get_heap_allocator());
+		growing_array_init((void**)&task_free_fibers, sizeof(Task_Fiber*), get_heap_allocator());
+	}
+
+	Task_Handle handle;
+	Task *t = (Task*)object_pool_acquire(&task_pool, &handle);
+	t->proc = proc;
+	t->data = data;
+	return handle;
+}
+
+bool task_is_done(Task_Handle task) {
+	return !task_pool.item_size || !object_pool_is_valid(&task_pool, task);
+}
+
+u64 task_get_count() {
+	if (!task_pool.item_size) return 0;
+	return object_pool_get_live_count(&task_pool);
+}
+
+bool task_is_ready(Task *t, f64 now) {
+	switch (t->wait_kind) {
+		case TASK_WAIT_NONE:      return true;
+		case TASK_WAIT_TIME:      return now >= t->wake_time;
+		case TASK_WAIT_COUNTER:   return atomic_load_acquire_64(&t->counter->count) == 0;
+		case TASK_WAIT_TASK:      return task_is_done(t->other);
+		case TASK_WAIT_CONDITION: return t->condition(t->condition_data);
+	}
+	panic("Invalid task wait kind %d", t->wait_kind);
+	return false;
+}
+
+void task_update() {
+	if (!task_pool.item_size) return;
+	assert(!task_current, "task_update() can't be called from inside a task");
+
+	if (!task_scheduler_fiber) task_converted_thread = !os_fiber_is_thread_a_fiber();
+	task_scheduler_fiber = os_fiber_from_current_thread();
+	f64 now = os_get_elapsed_seconds();
+
+	// Backwards because releasing moves the last live task into the released position.
+	// Tasks spawned during the update go at the end and first run on the next update.
+	for (s64 i = (s64)object_pool_get_live_count(&task_pool)-1; i >= 0; i -= 1) {
+		Task_Handle handle;
+		Task *t = (Task*)object_pool_get_live(&task_pool, (u64)i, &handle);
+		if (!task_is_ready(t, now)) continue;
+
+		t->wait_kind = TASK_WAIT_NONE;
+		if (!t->fiber) {
+			t->fiber = task_get_fiber();
+			t->fiber->task = t;
+		}
+
+		task_current = t;
+		os_fiber_switch(t->fiber->fiber);
+		task_current = 0;
+
+		if (t->done) {
+			t->fiber->task = 0;
+			growing_array_add((void**)&task_free_fibers, &t->fiber);
+			object_pool_release(&task_pool, handle);
+		}
+	}
+}
+
+void task_fiber_destroy(Task_Fiber *f) {
+	os_fiber_destroy(f->fiber);
+	dealloc(get_heap_allocator(), f);
+}
+
+void task_system_shutdown() {
+	if (!task_pool.item_size) return;
+	assert(!task_current, "task_system_shutdown() can't be called from inside a task");
+
+	// Unfinished tasks are never switched back to, so their stacks can just go
+	for (u64 i = 0; i < object_pool_get_live_count(&task_pool); i += 1) {
+		Task *t = (Task*)object_pool_get_live(&task_pool, i, 0);
+		if (t->fiber) task_fiber_destroy(t->fiber);
+	}
+	for (u64 i = 0; i < growing_array_get_valid_count(task_free_fibers); i += 1) {
+		task_fiber_destroy(task_free_fibers[i]);
+	}
+	growing_array_deinit((void**)&task_free_fibers);
+	task_free_fibers = 0;
+	object_pool_deinit(&task_pool);
+
+	if (task_scheduler_fiber && task_converted_thread) os_fiber_convert_to_thread();
+	task_scheduler_fiber = 0;
+	task_converted_thread = false;
+}
+
+bool task_is_running_in_task() {
+	return task_current != 0;
+}
+
+// Back to task_update(), which switches back here when the task is ready again
+void task_suspend(Task_Wait_Kind wait_kind) {
+	assert(task_current, "Can only await from inside a task");
+	task_current->wait_kind = wait_kind;
+	os_fiber_switch(task_scheduler_fiber);
+}
+
+void task_yield() {
+	task_suspend(TASK_WAIT_NONE);
+}
+void task_sleep(f64 seconds) {
+	assert(task_current, "Can only await from inside a task");
+	task_current->wake_time = os_get_elapsed_seconds() + seconds;
+	task_suspend(TASK_WAIT_TIME);
+}
+void task_await_counter(Job_Counter *counter) {
+	assert(task_current, "Can only await from inside a task");
+	if (atomic_load_acquire_64(&counter->count) == 0) return;
+	task_current->counter = counter;
+	task_suspend(TASK_WAIT_COUNTER);
+}
+void task_await_task(Task_Handle task) {
+	assert(task_current, "Can only await from inside a task");
+	if (task_is_done(task)) return;
+	task_current->other = task;
+	task_suspend(TASK_WAIT_TASK);
+}
+void task_await_condition(Task_Condition_Proc condition, void *data) {
+	assert(task_current, "Can only await from inside a task");
+	if (condition(data)) return;
+	task_current->condition = condition;
+	task_current->condition_data = data;
+	task_suspend(TASK_WAIT_CONDITION);
+}
+
+void task_await_job(Job_Proc proc, void *data) {
+	Job_Counter counter = {0};
+	job_run(proc, data, &counter);
+	task_await_counter(&counter);
+}
+
+typedef struct Task_Read_File {
+	string path;
+	string *result;
+	Allocator allocator;
+	bool ok;
+} Task_Read_File;
+void task_read_entire_file_job(void *data) {
+	Task_Read_File *r = (Task_Read_File*)data;
+	r->ok = os_read_entire_file(r->path, r->result, r->allocator);
+}
+// allocator is used from a worker thread
+bool task_read_entire_file(string path, string *result, Allocator allocator) {
+	Task_Read_File r = {path, result, allocator, false};
+	task_await_job(task_read_entire_file_job, &r);
+	return r.ok;
+}
+
+#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
@@ -5,8 +5,10 @@
 ///
 
 void log_heap() {
+	Heap_Stats stats = get_heap_stats();
+	
 	spinlock_acquire_or_wait(&heap_lock);
-	print("\nHEAP:\n");
+	print("\nHEAP: %llu used, %llu free in %llu nodes, fragmentation %.2f\n", stats.used_bytes, stats.free_bytes, stats.free_node_count, stats.fragmentation);
 	
 	Heap_Block *block = heap_head;
 	
@@ -14,17 +16,19 @@ void log_heap() {
 		
 		print("\tBLOCK @ 0x%I64x, %llu bytes\n", (u64)block, block->size);
 		
-		Heap_Free_Node *node = block->free_head;
+		Heap_Chunk_Header *chunk = (Heap_Chunk_Header*)block->start;
 
 		u64 total_free = 0;
 		
-		while (node != 0) {
+		while (chunk->size != 0) {
 		
-			print("\t\tFREE NODE @ 0x%I64x, %llu bytes\n", (u64)node, node->size);
-			
-			total_free += node->size;
+			if (heap_is_chunk_free(chunk)) {
+				print("\t\tFREE NODE @ 0x%I64x, %llu bytes\n", (u64)chunk, chunk->size);
+				
+				total_free += chunk->size;
+			}
 		
-			node = node->next;
+			chunk = heap_get_next_chunk(chunk);
 		}
 		
 		print("\t TOTAL FREE: %llu\n\n", total_free);
@@ -34,6 +38,19 @@ void log_heap() {
 	spinlock_release(&heap_lock);
 }
 
+void temporary_storage_thread_proc(Thread *t) {
+	assert(context.temporary_storage, "Thread has no temporary storage");
+	assert(context.temporary_storage->size == t->temporary_storage_size, "Thread temporary storage has the wrong size");
+	
+	for (int i = 0; i < 100; i += 1) {
+		memset(talloc(1024), 0xAB, 1024); // Wraps around a couple of times in KB(10)
+	}
+	assert(get_temporary_storage_overflow_count() > 0, "Thread temporary storage should have overflown");
+	assert(get_temporary_storage_high_water_mark() == t->temporary_storage_size, "Thread temporary storage high water mark is wrong");
+	
+	reset_temporary_storage();
+}
+
 void test_allocator(bool do_log_heap) {
 
 	u64 h = get_hash((string*)69);
@@ -139,6 +156,19 @@ void test_allocator(bool do_log_heap) {
     
     assert(old_foo == foo, "Temp allocator goof");
     
+    assert(get_temporary_storage_high_water_mark() >= 72+69+420, "Temporary storage high water mark is wrong");
+    
+    // Resetting temporary storage on another thread must not touch this thread's storage
+    *foo = 1337;
+    Thread temp_thread;
+    os_thread_init(&temp_thread, temporary_storage_thread_proc);
+    os_thread_start(&temp_thread);
+    os_thread_join(&temp_thread);
+    os_thread_destroy(&temp_thread);
+    void *after_thread = alloc(get_temporary_allocator(), 8);
+    assert(after_thread == (u8*)foo + 72, "Another thread reset this thread's temporary storage");
+    assert(*foo == 1337, "Another thread overwrote this thread's temporary storage");
+    
     // Repeated Allocation and Free
     for (int i = 0; i < 10000; ++i) {
         void* temp = alloc(heap, 128);
@@ -192,11 +222,337 @@ void test_allocator(bool do_log_heap) {
         dealloc(heap, blocks[i]);
     }
     
+    // Reallocation grows in place into free neighbours, and keeps contents when it has to move
+    u8 *r = (u8*)heap_alloc(KB(300));
+    for (u64 i = 0; i < KB(300); i += 1) r[i] = (u8)i;
+    u8 *r_grown = (u8*)reallocate(heap, r, KB(600));
+    assert(r_grown == r, "Heap realloc did not grow into the free space after the allocation");
+    u8 *r_shrunk = (u8*)reallocate(heap, r_grown, KB(100));
+    assert(r_shrunk == r, "Heap realloc should shrink in place");
+    u8 *blocker = (u8*)heap_alloc(KB(100));
+    u8 *r_moved = (u8*)reallocate(heap, r_shrunk, KB(400));
+    (void)blocker;
+    for (u64 i = 0; i < KB(100); i += 1) assert(r_moved[i] == (u8)i, "Heap realloc lost data");
+    heap_dealloc(blocker);
+    heap_dealloc(r_moved);
+    
+    u8 *small = (u8*)reallocate(heap, 0, 20);
+    memcpy(small, "ooga", 5);
+    assert(reallocate(heap, small, 30) == small, "Heap realloc should not move within the thread cache size class");
+    small = (u8*)reallocate(heap, small, 5000);
+    assert(memcmp(small, "ooga", 5) == 0, "Heap realloc lost data");
+    heap_dealloc(small);
+    
+    // Huge allocations get their own pages, so they can be bigger than a heap block
+    u8 *huge = (u8*)alloc(heap, MB(600));
+    assert((u64)huge % 16 == 0, "Huge allocation is misaligned");
+    huge[0] = 1;
+    huge[MB(600)-1] = 2;
+    assert(huge[0] == 1 && huge[MB(600)-1] == 2, "Huge allocation memory is broken");
+    dealloc(heap, huge);
+    
+    // The freed pages should be reused rather than reserving more program memory
+    void *program_memory_next_before = program_memory_next;
+    u8 *huge2 = (u8*)alloc(heap, MB(300));
+    assert(program_memory_next == program_memory_next_before, "Freed huge allocation pages were not reused");
+    memset(huge2, 0xAB, MB(300));
+    
+    // Huge allocations grow in place into released neighbours
+    u8 *huge3 = (u8*)reallocate(heap, huge2, MB(450));
+    assert(huge3 == huge2, "Huge realloc did not grow in place");
+    assert(huge3[MB(300)-1] == 0xAB, "Huge realloc lost data");
+    huge3[MB(450)-1] = 1;
+    dealloc(heap, huge3);
+    
+    // Small chunks are not coalesced on free, so this leaves lots of small free nodes next to each other
+    void *pieces[512];
+    for (int i = 0; i < 512; i += 1) pieces[i] = alloc(heap, 16);
+    for (int i = 0; i < 512; i += 1) dealloc(heap, pieces[i]);
+    // heap_trim() flushes this thread's cache too, but flush it here so the stats see the free neighbours
+    for (u64 i = 0; i < HEAP_CACHE_SIZE_CLASS_COUNT; i += 1) {
+    	heap_cache_flush(heap_thread_cache, i, heap_thread_cache->bin_counts[i]);
+    }
+    Heap_Stats untrimmed = get_heap_stats();
+    heap_trim();
+    Heap_Stats stats = get_heap_stats();
+    assert(stats.free_node_count < untrimmed.free_node_count, "heap_trim() did not merge free neighbours");
+    assert(stats.block_count < untrimmed.block_count || stats.free_bytes == untrimmed.free_bytes, "heap_trim() lost free bytes");
+    spinlock_acquire_or_wait(&heap_lock);
+    for (Heap_Block *block = heap_head; block; block = block->next) {
+    	Heap_Chunk_Header *chunk = (Heap_Chunk_Header*)block->start;
+    	while (chunk->size != 0) {
+    		Heap_Chunk_Header *next = heap_get_next_chunk(chunk);
+    		assert(!(heap_is_chunk_free(chunk) && heap_is_chunk_free(next)), "heap_trim() left free neighbours");
+    		chunk = next;
+    	}
+    }
+    spinlock_release(&heap_lock);
+    heap_trim();
+    Heap_Stats trimmed = get_heap_stats();
+    assert(trimmed.free_node_count == stats.free_node_count, "heap_trim() should be a no-op on a trimmed heap");
+    assert(stats.largest_free_node <= stats.free_bytes, "Heap stats are wrong");
+    assert(stats.fragmentation >= 0.0 && stats.fragmentation < 1.0, "Heap fragmentation is out of range");
+    assert(stats.used_bytes + stats.free_bytes + stats.block_count*(sizeof(Heap_Block)+sizeof(Heap_Chunk_Header)) == stats.block_bytes, "Heap stats don't add up");
+    
+    // Per block stats walk the chunks, so they should agree with the counters
+    u64 walked_free = 0;
+    u64 walked_nodes = 0;
+    for (u64 i = 0; i < get_heap_block_count(); i += 1) {
+    	Heap_Block_Stats block_stats = get_heap_block_stats(i);
+    	assert(block_stats.occupancy >= 0.0 && block_stats.occupancy <= 1.0, "Heap block occupancy is out of range");
+    	walked_free += block_stats.free_bytes;
+    	walked_nodes += block_stats.free_node_count;
+    }
+    assert(walked_free == trimmed.free_bytes && walked_nodes == trimmed.free_node_count, "Heap free counters are out of sync");
+    
+    // Empty heap blocks are given back, and their address space is reused
+    spinlock_acquire_or_wait(&heap_lock);
+    Heap_Block *last_block = heap_head;
+    while (last_block->next) last_block = last_block->next;
+    make_heap_block(last_block, MB(4));
+    spinlock_release(&heap_lock);
+    assert(get_heap_block_count() == trimmed.block_count+1, "Heap block count is wrong");
+    heap_trim();
+    assert(get_heap_block_count() == trimmed.block_count, "heap_trim() did not release an empty heap block");
+    
+    program_memory_next_before = program_memory_next;
+    spinlock_acquire_or_wait(&heap_lock);
+    make_heap_block(last_block, MB(4));
+    spinlock_release(&heap_lock);
+    assert(program_memory_next == program_memory_next_before, "Released heap block address space was not reused");
+    heap_trim();
+    
+#if VERY_DEBUG
+    // Allocations only validate a slice of the heap, so check all of it at least once
+    spinlock_acquire_or_wait(&heap_lock);
+    heap_validate_full_locked();
+    spinlock_release(&heap_lock);
+#endif
+    
+#if ENABLE_HEAP_PROFILING
+    // Allocations from the same call site are counted together
+    u64 profile_live_before = heap_profile_live_bytes;
+    void *tracked[10];
+    for (int i = 0; i < 10; i += 1) tracked[i] = alloc(heap, 5000);
+    u32 site = ((Heap_Allocation_Metadata*)((u8*)tracked[0]-sizeof(Heap_Allocation_Metadata)))->profile_site;
+    u64 usable = heap_get_usable_size((Heap_Allocation_Metadata*)((u8*)tracked[0]-sizeof(Heap_Allocation_Metadata)));
+    for (int i = 1; i < 10; i += 1) {
+    	assert(((Heap_Allocation_Metadata*)((u8*)tracked[i]-sizeof(Heap_Allocation_Metadata)))->profile_site == site, "Heap profiler split one call site");
+    }
+    assert(heap_profile_sites[site].live_count == 10, "Heap profiler live count is wrong");
+    assert(heap_profile_sites[site].live_bytes == 10*usable, "Heap profiler live bytes is wrong");
+    assert(heap_profile_live_bytes - profile_live_before == 10*usable, "Heap profiler total live bytes is wrong");
+    
+    tracked[0] = reallocate(heap, tracked[0], 9000);
+    for (int i = 0; i < 10; i += 1) dealloc(heap, tracked[i]);
+    assert(heap_profile_sites[site].live_count == 0 && heap_profile_sites[site].live_bytes == 0, "Heap profiler did not track deallocations");
+    assert(heap_profile_live_bytes == profile_live_before, "Heap profiler total live bytes is wrong");
+#endif
+    
     assert(bytes_match(check_bytes, check_bytes_copy, 1024), "Memory corrupt");
     
     if (do_log_heap) log_heap();
 }
 
+void test_arena() {
+	
+	// Growing arena commits as it goes
+	Arena arena = make_growing_arena(MB(64));
+	assert(arena.size == 0, "Growing arena should not commit up front");
+	
+	u8 *first = (u8*)arena_push(&arena, 100);
+	memset(first, 0xAB, 100);
+	assert(arena.size >= 100 && arena.size <= ARENA_COMMIT_SIZE, "Growing arena committed the wrong amount");
+	
+	u8 *big = (u8*)arena_push(&arena, MB(3));
+	memset(big, 0xCD, MB(3));
+	assert(big == first + 100, "Growing arena moved");
+	assert(arena.size >= MB(3)+100, "Growing arena did not commit enough");
+	
+	// Mark & rewind
+	Arena_Mark mark = arena_mark(&arena);
+	u8 *scratch = (u8*)arena_push(&arena, 1000);
+	memset(scratch, 0xEF, 1000);
+	arena_rewind(&arena, mark);
+	u8 *scratch2 = (u8*)arena_push(&arena, 10);
+	assert(scratch2 == scratch, "Arena rewind did not pop");
+	arena_rewind(&arena, mark);
+	
+	// Realloc of the latest push happens in place
+	Allocator allocator = make_arena_allocator_from_arena(&arena);
+	u8 *grow = (u8*)alloc(allocator, 16);
+	for (int i = 0; i < 16; i += 1) grow[i] = (u8)i;
+	u8 *grown = (u8*)allocator.proc(KB(200), grow, ALLOCATOR_REALLOCATE, allocator.data);
+	assert(grown == grow, "Realloc of the latest arena push should be in place");
+	for (int i = 0; i < 16; i += 1) assert(grown[i] == (u8)i, "Arena realloc lost data");
+	memset(grown+16, 0, KB(200)-16);
+	
+	// Anything else is copied
+	u8 *other = (u8*)alloc(allocator, 16);
+	u8 *moved = (u8*)allocator.proc(64, grown, ALLOCATOR_REALLOCATE, allocator.data);
+	assert(moved != grown && moved > other, "Realloc of an older arena push should copy");
+	for (int i = 0; i < 16; i += 1) assert(moved[i] == (u8)i, "Arena realloc lost data");
+	
+	// Reset decommits everything but the first ARENA_COMMIT_SIZE
+	arena.decommit_on_reset = true;
+	arena_reset(&arena);
+	assert(arena.next == arena.start && arena.size == ARENA_COMMIT_SIZE, "Arena reset did not decommit");
+	u8 *after_reset = (u8*)arena_push(&arena, MB(1));
+	assert(after_reset == first, "Arena reset did not reset");
+	for (u64 i = 0; i < MB(1); i += 1) assert(after_reset[i] == 0 || i < ARENA_COMMIT_SIZE, "Decommitted arena memory should come back zeroed");
+	
+	destroy_arena(&arena);
+	
+	// Fixed arenas still work the same, with realloc
+	Arena fixed = make_arena(KB(4));
+	Allocator fixed_allocator = make_arena_allocator_from_arena(&fixed);
+	u64 *numbers = (u64*)alloc(fixed_allocator, sizeof(u64)*4);
+	for (u64 i = 0; i < 4; i += 1) numbers[i] = i;
+	u64 *more_numbers = (u64*)fixed_allocator.proc(sizeof(u64)*8, numbers, ALLOCATOR_REALLOCATE, fixed_allocator.data);
+	assert(more_numbers == numbers, "Realloc of the latest arena push should be in place");
+	for (u64 i = 0; i < 4; i += 1) assert(more_numbers[i] == i, "Arena realloc lost data");
+	destroy_arena(&fixed);
+	
+	// Temporary storage reallocates the latest allocation in place too
+	reset_temporary_storage();
+	u8 *t = (u8*)alloc(get_temporary_allocator(), 8);
+	memcpy(t, "oogabog", 8);
+	u8 *t_grown = (u8*)get_temporary_allocator().proc(100, t, ALLOCATOR_REALLOCATE, 0);
+	assert(t_grown == t, "Temporary storage realloc of the latest allocation should be in place");
+	(void)talloc(8);
+	u8 *t_moved = (u8*)get_temporary_allocator().proc(200, t, ALLOCATOR_REALLOCATE, 0);
+	assert(t_moved != t && memcmp(t_moved, "oogabog", 8) == 0, "Temporary storage realloc lost data");
+	reset_temporary_storage();
+}
+
+typedef struct Pool_Test_Thing {
+	u64 value;
+	u8 padding[20];
+} Pool_Test_Thing;
+
+void test_object_pool() {
+	Object_Pool pool;
+	object_pool_init(&pool, sizeof(Pool_Test_Thing), 4, get_heap_allocator());
+	
+	const u64 N = 1000;
+	Object_Handle *handles = (Object_Handle*)alloc(get_heap_allocator(), sizeof(Object_Handle)*N);
+	Pool_Test_Thing **things = (Pool_Test_Thing**)alloc(get_heap_allocator(), sizeof(Pool_Test_Thing*)*N);
+	
+	for (u64 i = 0; i < N; i += 1) {
+		things[i] = (Pool_Test_Thing*)object_pool_acquire(&pool, &handles[i]);
+		assert(things[i]->value == 0, "Acquired object pool item was not zeroed");
+		assert((u64)things[i] % 8 == 0, "Object pool item is misaligned");
+		things[i]->value = i;
+	}
+	assert(object_pool_get_live_count(&pool) == N, "Wrong object pool live count");
+	
+	// Items never move as the pool grows
+	for (u64 i = 0; i < N; i += 1) {
+		assert(object_pool_get(&pool, handles[i]) == things[i], "Object pool item moved");
+		assert(things[i]->value == i, "Object pool item was corrupted");
+		Object_Handle h = object_pool_get_handle(&pool, things[i]);
+		assert(h.index == handles[i].index && h.generation == handles[i].generation, "Object pool get handle by pointer failed");
+	}
+	
+	// Release every other item, stale handles must be detected
+	for (u64 i = 0; i < N; i += 2) {
+		assert(object_pool_release(&pool, handles[i]), "Object pool release failed");
+		assert(!object_pool_release(&pool, handles[i]), "Object pool double release should fail");
+		assert(!object_pool_get(&pool, handles[i]), "Stale object pool handle was not detected");
+	}
+	assert(object_pool_get_live_count(&pool) == N/2, "Wrong object pool live count");
+	
+	// Dense iteration only sees live items
+	u64 sum = 0;
+	for (u64 i = 0; i < object_pool_get_live_count(&pool); i += 1) {
+		Object_Handle h;
+		Pool_Test_Thing *thing = (Pool_Test_Thing*)object_pool_get_live(&pool, i, &h);
+		assert(thing->value % 2 == 1, "Object pool dense iteration found a released item");
+		assert(object_pool_get(&pool, h) == thing, "Object pool dense iteration returned a bad handle");
+		sum += thing->value;
+	}
+	assert(sum == (N/2)*(N/2), "Object pool dense iteration missed items");
+	
+	// Released slots are reused, and old handles to them stay stale
+	u64 slot_count = pool.slot_count;
+	for (u64 i = 0; i < N; i += 2) {
+		Object_Handle old = handles[i];
+		things[i] = (Pool_Test_Thing*)object_pool_acquire(&pool, &handles[i]);
+		assert(!object_pool_get(&pool, old), "Stale object pool handle became valid after reuse");
+	}
+	assert(pool.slot_count == slot_count, "Object pool grew instead of reusing released slots");
+	
+	// Release while iterating backwards
+	for (s64 i = (s64)object_pool_get_live_count(&pool)-1; i >= 0; i -= 1) {
+		Object_Handle h;
+		object_pool_get_live(&pool, (u64)i, &h);
+		object_pool_release(&pool, h);
+	}
+	assert(object_pool_get_live_count(&pool) == 0, "Object pool did not release everything");
+	
+	assert(!object_pool_get(&pool, ZERO(Object_Handle)), "Zero object pool handle should never be valid");
+	
+	dealloc(get_heap_allocator(), handles);
+	dealloc(get_heap_allocator(), things);
+	object_pool_deinit(&pool);
+}
+
+void test_chunked_array() {
+	Chunked_Array array;
+	chunked_array_init(&array, sizeof(Pool_Test_Thing), 3, get_heap_allocator());
+	assert(array.first_chunk_count == 4, "Chunked array first chunk count should be rounded up to a power of two");
+	
+	const u64 N = 1000;
+	Pool_Test_Thing **things = (Pool_Test_Thing**)alloc(get_heap_allocator(), sizeof(Pool_Test_Thing*)*N);
+	for (u64 i = 0; i < N; i += 1) {
+		if (i % 2 == 0) {
+			things[i] = (Pool_Test_Thing*)chunked_array_add_empty(&array);
+			assert(things[i]->value == 0, "Chunked array item was not zeroed");
+			things[i]->value = i;
+		} else {
+			Pool_Test_Thing thing = {0};
+			thing.value = i;
+			things[i] = (Pool_Test_Thing*)chunked_array_add(&array, &thing);
+		}
+	}
+	assert(array.count == N, "Wrong chunked array count");
+	
+	// Items never move as the array grows
+	for (u64 i = 0; i < N; i += 1) {
+		assert(chunked_array_get(&array, i) == things[i], "Chunked array item moved");
+		assert(things[i]->value == i, "Chunked array item was corrupted");
+	}
+	
+	// Chunk iteration sees every item once, in order
+	u64 next = 0;
+	for (u64 c = 0; c < chunked_array_get_chunk_count(&array); c += 1) {
+		u64 count;
+		Pool_Test_Thing *chunk = (Pool_Test_Thing*)chunked_array_get_chunk(&array, c, &count);
+		for (u64 i = 0; i < count; i += 1) {
+			assert(chunk[i].value == next, "Chunked array chunk iteration is out of order");
+			next += 1;
+		}
+	}
+	assert(next == N, "Chunked array chunk iteration missed items");
+	
+	chunked_array_unordered_remove(&array, 10);
+	assert(things[10]->value == N-1 && array.count == N-1, "Chunked array unordered remove");
+	chunked_array_pop(&array);
+	assert(array.count == N-2, "Chunked array pop");
+	
+	// Clearing keeps the chunks, so the same memory is handed out again
+	u64 chunk_count = array.chunk_count;
+	chunked_array_clear(&array);
+	assert(chunked_array_get_chunk_count(&array) == 0, "Chunked array should be empty after clear");
+	for (u64 i = 0; i < N; i += 1) {
+		assert(chunked_array_add_empty(&array) == things[i], "Chunked array did not reuse its chunks after clear");
+	}
+	assert(array.chunk_count == chunk_count, "Chunked array allocated new chunks after clear");
+	
+	dealloc(get_heap_allocator(), things);
+	chunked_array_deinit(&array);
+}
+
 void test_thread_proc1(Thread* t) {
 	os_sleep(5);
 	print("Hello from thread %llu\n", t->id);
@@ -258,6 +614,91 @@ void test_allocator_threaded(Thread *t) {
     }
 }
 
+#define ALLOCATOR_SCALING_ITERATIONS 200000
+#define ALLOCATOR_SCALING_LIVE_COUNT 64
+void allocator_scaling_thread_proc(Thread *t) {
+	Allocator heap = get_heap_allocator();
+	
+	void *live[ALLOCATOR_SCALING_LIVE_COUNT] = {0};
+	u64 seed = t->id;
+	
+	for (u64 i = 0; i < ALLOCATOR_SCALING_ITERATIONS; i += 1) {
+		u64 slot = i % ALLOCATOR_SCALING_LIVE_COUNT;
+		if (live[slot]) dealloc(heap, live[slot]);
+		
+		seed = seed*6364136223846793005ULL + 1442695040888963407ULL;
+		u64 size = 16 + (seed >> 33) % 1024;
+		
+		live[slot] = alloc_uninitialized(heap, size);
+		*(u64*)live[slot] = i;
+	}
+	
+	for (u64 i = 0; i < ALLOCATOR_SCALING_LIVE_COUNT; i += 1) {
+		if (live[i]) dealloc(heap, live[i]);
+	}
+}
+void allocator_remote_free_thread_proc(Thread *t) {
+	void **pointers = (void**)t->data;
+	for (u64 i = 0; i < 1000; i += 1) {
+		dealloc(get_heap_allocator(), pointers[i]);
+	}
+}
+void test_allocator_thread_scaling() {
+
+	Allocator heap = get_heap_allocator();
+
+	// Memory allocated on this thread and freed on another should come back to this thread
+	void **pointers = (void**)alloc(heap, 1000*sizeof(void*));
+	for (u64 i = 0; i < 1000; i += 1) {
+		pointers[i] = alloc(heap, 64);
+		memset(pointers[i], 0xAB, 64);
+	}
+	Thread remote_freer;
+	os_thread_init(&remote_freer, allocator_remote_free_thread_proc);
+	remote_freer.data = pointers;
+	os_thread_start(&remote_freer);
+	os_thread_join(&remote_freer);
+	os_thread_destroy(&remote_freer);
+	assert(heap_thread_cache->remote_free_head != 0, "Failed: cross-thread frees did not go to the owning thread cache");
+	
+	for (u64 i = 0; i < 1000; i += 1) {
+		pointers[i] = alloc(heap, 64);
+		memset(pointers[i], 0xCD, 64);
+	}
+	for (u64 i = 0; i < 1000; i += 1) {
+		dealloc(heap, pointers[i]);
+	}
+	dealloc(heap, pointers);
+
+	u64 max_thread_count = min(os_get_number_of_logical_processors(), 16);
+	Thread *threads = (Thread*)alloc(heap, sizeof(Thread)*max_thread_count);
+	
+	f64 single_thread_seconds = 0;
+	for (u64 thread_count = 1; thread_count <= max_thread_count; thread_count *= 2) {
+		for (u64 i = 0; i < thread_count; i += 1) {
+			os_thread_init(&threads[i], allocator_scaling_thread_proc);
+		}
+		
+		f64 start = os_get_elapsed_seconds();
+		for (u64 i = 0; i < thread_count; i += 1) {
+			os_thread_start(&threads[i]);
+		}
+		for (u64 i = 0; i < thread_count; i += 1) {
+			os_thread_join(&threads[i]);
+			os_thread_destroy(&threads[i]);
+		}
+		f64 seconds = os_get_elapsed_seconds()-start;
+		if (thread_count == 1) single_thread_seconds = seconds;
+		
+		f64 million_ops_per_second = ((f64)(thread_count*ALLOCATOR_SCALING_ITERATIONS*2)/seconds)/1000000.0;
+		f64 scaling = (single_thread_seconds*(f64)thread_count)/seconds;
+		print("\n\t%llu threads: %.2f M alloc+dealloc/s, %.2fx of single thread", thread_count, million_ops_per_second, scaling);
+	}
+	print("\n");
+	
+	dealloc(heap, threads);
+}
+
 void test_strings() {
 	Allocator heap = get_heap_allocator();
 	{
@@ -1307,6 +1748,147 @@ void test_intmath() {
     assert(v4i_result.x == 1 && v4i_result.y == 2 && v4i_result.z == 3 && v4i_result.w == 4, "v4i_divi incorrect");
 }
 
+u64 legacy_string_get_hash(string s) {
+	if (s.count > 32) return djb2_hash(s);
+	return city_hash(s);
+}
+int compare_u64(const void *a, const void *b) {
+	u64 x = *(u64*)a;
+	u64 y = *(u64*)b;
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+u64 count_hash_collisions(u64 *hashes, u64 count, u64 mask) {
+	u64 *sorted = (u64*)alloc(get_heap_allocator(), count*sizeof(u64)*2);
+	for (u64 i = 0; i < count; i += 1) sorted[i] = hashes[i] & mask;
+	merge_sort(sorted, sorted+count, count, sizeof(u64), compare_u64);
+	u64 collisions = 0;
+	for (u64 i = 1; i < count; i += 1) {
+		if (sorted[i] == sorted[i-1]) collisions += 1;
+	}
+	dealloc(get_heap_allocator(), sorted);
+	return collisions;
+}
+
+void test_hash() {
+	Allocator heap = get_heap_allocator();
+	
+	u64 buffer_size = 2000;
+	u8 *buffer = (u8*)alloc(heap, buffer_size);
+	for (u64 i = 0; i < buffer_size; i += 1) buffer[i] = (u8)(i*7);
+	
+	// Every length, and every byte of the input, changes the hash
+	u64 lengths[] = { 0, 1, 3, 4, 7, 8, 15, 16, 17, 33, 48, 49, 100, 256, 257, 511, 512, 513, 2000 };
+	for (u64 l = 0; l < sizeof(lengths)/sizeof(lengths[0]); l += 1) {
+		u64 length = lengths[l];
+		u64 original = hash_bytes(buffer, length, 0);
+		assert(original == hash_bytes(buffer, length, 0), "Failed: Hash is not deterministic");
+		assert(original != hash_bytes(buffer, length, 1), "Failed: Seed does not change the hash");
+		if (length != buffer_size) {
+			assert(original != hash_bytes(buffer, length+1, 0), "Failed: Length does not change the hash");
+		}
+		for (u64 i = 0; i < length; i += 1) {
+			buffer[i] ^= 1;
+			assert(hash_bytes(buffer, length, 0) != original, "Failed: Byte %llu of %llu does not change the hash", i, length);
+			buffer[i] ^= 1;
+		}
+	}
+	
+	// Only reads inside of the input
+	u8 *guarded = buffer + 1000;
+	for (u64 length = 0; length < 300; length += 1) {
+		u64 h = hash_bytes(guarded, length, 0);
+		guarded[-1] ^= 0xFF;
+		guarded[length] ^= 0xFF;
+		assert(hash_bytes(guarded, length, 0) == h, "Failed: Hash of %llu bytes read outside of the input", length);
+		guarded[-1] ^= 0xFF;
+		guarded[length] ^= 0xFF;
+	}
+	
+	string a = STR("assets/textures/a_very_long_shared_prefix/and/a/long/path/player.png");
+	string b = STR("assets/textures/a_very_long_shared_prefix/and/a/long/path/player.png");
+	assert(string_get_hash(a) == string_get_hash(b), "Failed: Equal strings should hash the same");
+	
+	dealloc(heap, buffer);
+}
+
+void test_hash_performance() {
+	Allocator heap = get_heap_allocator();
+	
+	// Throughput
+	u64 sizes[] = { 16, 64, 256, 4096, MB(1) };
+	u64 total_bytes = MB(256);
+	u8 *data = (u8*)alloc(heap, MB(1));
+	for (u64 i = 0; i < MB(1); i += 1) data[i] = (u8)get_random_int_in_range(0, 255);
+	for (u64 s = 0; s < sizeof(sizes)/sizeof(sizes[0]); s += 1) {
+		u64 size = sizes[s];
+		u64 iterations = total_bytes/size;
+		u64 sink = 0;
+		
+		f64 start = os_get_elapsed_seconds();
+		for (u64 i = 0; i < iterations; i += 1) sink += hash_bytes(data + (i & 7), size - 8*(size > 8), 0);
+		f64 new_seconds = os_get_elapsed_seconds()-start;
+		
+		start = os_get_elapsed_seconds();
+		for (u64 i = 0; i < iterations; i += 1) {
+			string str = {size - 8*(size > 8), data + (i & 7)};
+			sink += legacy_string_get_hash(str);
+		}
+		f64 legacy_seconds = os_get_elapsed_seconds()-start;
+		
+		print("\n\t%llu byte keys: hash_bytes %.2f GB/s, ", size, ((f64)total_bytes/new_seconds)/(f64)GB(1));
+		print("old string hash %.2f GB/s", ((f64)total_bytes/legacy_seconds)/(f64)GB(1));
+		if (sink == 1) print(" ");
+	}
+	dealloc(heap, data);
+	
+	// Collisions over asset paths which share long prefixes & suffixes
+	const char *directories[] = {
+		"C:/projects/game/assets/textures/environment/forest/",
+		"C:/projects/game/assets/textures/characters/player/",
+		"C:/projects/game/assets/sounds/sfx/footsteps/",
+		"assets/fonts/",
+		"assets/",
+	};
+	const char *names[] = { "tree", "rock", "footstep_grass", "npc", "a" };
+	const char *extensions[] = { "_diffuse.png", "_normal.png", ".wav", ".ttf" };
+	u64 per_combination = 2000;
+	u64 path_count = 5*5*4*per_combination;
+	u64 *new_hashes = (u64*)alloc(heap, path_count*sizeof(u64));
+	u64 *legacy_hashes = (u64*)alloc(heap, path_count*sizeof(u64));
+	u64 n = 0;
+	u64 total_path_bytes = 0;
+	for (u64 d = 0; d < 5; d += 1) {
+		for (u64 m = 0; m < 5; m += 1) {
+			for (u64 e = 0; e < 4; e += 1) {
+				for (u64 i = 0; i < per_combination; i += 1) {
+					string file_name = sprintf(heap, "%cs_%llu", names[m], i);
+					string path = sprintf(heap, "%cs%s%cs", directories[d], file_name, extensions[e]);
+					dealloc_string(heap, file_name);
+					new_hashes[n] = string_get_hash(path);
+					legacy_hashes[n] = legacy_string_get_hash(path);
+					total_path_bytes += path.count;
+					n += 1;
+					dealloc_string(heap, path);
+				}
+				reset_temporary_storage();
+			}
+		}
+	}
+	
+	print("\n\t%llu asset paths, ", path_count);
+	print("%llu bytes on average. ", total_path_bytes/path_count);
+	print("Full hash collisions: hash_bytes %llu, ", count_hash_collisions(new_hashes, path_count, 0xFFFFFFFFFFFFFFFFULL));
+	print("old %llu. ", count_hash_collisions(legacy_hashes, path_count, 0xFFFFFFFFFFFFFFFFULL));
+	print("Low 24 bit collisions: hash_bytes %llu, ", count_hash_collisions(new_hashes, path_count, 0xFFFFFF));
+	print("old %llu ", count_hash_collisions(legacy_hashes, path_count, 0xFFFFFF));
+	print("(%.0f expected)\n", (f64)path_count - (f64)0x1000000*(1.0 - pow(1.0 - 1.0/(f64)0x1000000, (f64)path_count)));
+	
+	assert(count_hash_collisions(new_hashes, path_count, 0xFFFFFFFFFFFFFFFFULL) == 0, "Failed: 64 bit hash collision in asset paths");
+	
+	dealloc(heap, new_hashes);
+	dealloc(heap, legacy_hashes);
+}
+
 void test_hash_table() {
     Hash_Table table = make_hash_table(string, int, get_heap_allocator());
     
@@ -1337,11 +1919,322 @@ void test_hash_table() {
     hash_table_reset(&table);
     found_value = hash_table_find(&table, key1);
     assert(found_value == NULL, "Failed: Hash table should be empty after reset");
+    
+    // Keys are compared by content, not by the string pointer
+    string key1_copy = string_copy(key1, get_heap_allocator());
+    hash_table_set(&table, key1, value1);
+    found_value = hash_table_find(&table, key1_copy);
+    assert(found_value && *found_value == 69, "Failed: String keys should be compared by content");
+    assert(hash_table_remove(&table, key1_copy), "Failed: Key should have been removed");
+    assert(!hash_table_contains(&table, key1), "Failed: Key should be gone after remove");
+    assert(!hash_table_remove(&table, key1), "Failed: Removing a missing key should return false");
+    dealloc_string(get_heap_allocator(), key1_copy);
 
     hash_table_destroy(&table);
     assert(table.entries == NULL, "Failed: Hash table entries should be NULL after destroy");
     assert(table.count == 0, "Failed: Hash table count should be 0 after destroy");
     assert(table.capacity_count == 0, "Failed: Hash table capacity count should be 0 after destroy");
+    
+    // Different keys with the same hash don't alias
+    Hash_Table colliding = make_hash_table(u64, u64, get_heap_allocator());
+    for (u64 i = 0; i < 100; i += 1) {
+    	u64 v = i*10;
+    	hash_table_add_raw(&colliding, 1234, &i, &v, sizeof(u64), sizeof(u64));
+    }
+    for (u64 i = 0; i < 100; i += 1) {
+    	u64 *v = (u64*)hash_table_find_raw(&colliding, 1234, &i, sizeof(u64));
+    	assert(v && *v == i*10, "Failed: Colliding keys aliased");
+    }
+    for (u64 i = 0; i < 100; i += 2) {
+    	assert(hash_table_remove_raw(&colliding, 1234, &i, sizeof(u64)), "Failed: Colliding key was not removed");
+    }
+    for (u64 i = 0; i < 100; i += 1) {
+    	u64 *v = (u64*)hash_table_find_raw(&colliding, 1234, &i, sizeof(u64));
+    	if (i % 2 == 0) {
+    		assert(!v, "Failed: Removed colliding key is still there");
+    	} else {
+    		assert(v && *v == i*10, "Failed: Removing broke another colliding key");
+    	}
+    }
+    hash_table_destroy(&colliding);
+    
+    // Lots of entries, with removes in between
+    Hash_Table numbers = make_hash_table(u64, u64, get_heap_allocator());
+    for (u64 i = 0; i < 20000; i += 1) {
+    	u64 v = i+1;
+    	hash_table_add(&numbers, i, v);
+    	if (i % 3 == 0) {
+    		u64 k = i/2;
+    		hash_table_remove(&numbers, k);
+    	}
+    }
+    assert(numbers.slot_count*3 >= numbers.count*4, "Failed: Hash table is too full");
+    u64 found_count = 0;
+    for (u64 i = 0; i < 20000; i += 1) {
+    	u64 *v = (u64*)hash_table_find(&numbers, i);
+    	if (v) {
+    		assert(*v == i+1, "Failed: Wrong value");
+    		found_count += 1;
+    	}
+    }
+    assert(found_count == numbers.count, "Failed: Hash table count is wrong");
+    u64 value_sum = 0;
+    for (u64 i = 0; i < numbers.count; i += 1) {
+    	u64 *k = (u64*)hash_table_get_nth_key(&numbers, i);
+    	u64 *v = (u64*)hash_table_get_nth_value(&numbers, i);
+    	assert(*v == *k+1, "Failed: Iterated key & value don't match");
+    	value_sum += *v;
+    }
+    assert(value_sum > 0, "Failed: Iteration");
+    hash_table_destroy(&numbers);
+}
+
+void test_hash_map() {
+    Allocator heap = get_heap_allocator();
+    
+    Hash_Map map = make_hash_map(string, int, heap);
+    
+    string key1 = STR("Key string");
+    int value1 = 69;
+    assert(hash_map_set(&map, key1, value1) == true, "Failed: Key should be newly added");
+    int value2 = 70;
+    assert(hash_map_set(&map, key1, value2) == false, "Failed: Key should not be newly added");
+    
+    string key1_copy = string_copy(key1, heap);
+    int *found_value = (int*)hash_map_find(&map, key1_copy);
+    assert(found_value && *found_value == 70, "Failed: String keys should be compared by content");
+    
+    string key2 = STR("Non-existing key");
+    assert(!hash_map_contains(&map, key2), "Failed: Hash map should not contain key2");
+    assert(hash_map_remove(&map, key1_copy), "Failed: Key should have been removed");
+    assert(!hash_map_contains(&map, key1), "Failed: Key should be gone after remove");
+    assert(!hash_map_remove(&map, key1), "Failed: Removing a missing key should return false");
+    assert(map.count == 0, "Failed: Hash map should be empty");
+    dealloc_string(heap, key1_copy);
+    
+    hash_map_set(&map, key1, value1);
+    hash_map_reset(&map);
+    assert(!hash_map_contains(&map, key1), "Failed: Hash map should be empty after reset");
+    hash_map_destroy(&map);
+    assert(map.ctrl == 0 && map.count == 0 && map.capacity == 0, "Failed: Hash map should be empty after destroy");
+    
+    // Different keys with the same hash (and so the same control byte) don't alias
+    Hash_Map colliding = make_hash_map(u64, u64, heap);
+    for (u64 i = 0; i < 100; i += 1) {
+    	u64 v = i*10;
+    	hash_map_set_raw(&colliding, 1234, &i, &v, sizeof(u64), sizeof(u64));
+    }
+    for (u64 i = 0; i < 100; i += 2) {
+    	assert(hash_map_remove_raw(&colliding, 1234, &i, sizeof(u64)), "Failed: Colliding key was not removed");
+    }
+    for (u64 i = 0; i < 100; i += 1) {
+    	u64 *v = (u64*)hash_map_find_raw(&colliding, 1234, &i, sizeof(u64));
+    	if (i % 2 == 0) {
+    		assert(!v, "Failed: Removed colliding key is still there");
+    	} else {
+    		assert(v && *v == i*10, "Failed: Removing broke another colliding key");
+    	}
+    }
+    hash_map_destroy(&colliding);
+    
+    // Lots of entries with removes in between, so deleted slots get reused and cleaned up
+    Hash_Map numbers = make_hash_map(u64, u64, heap);
+    for (u64 round = 0; round < 4; round += 1) {
+	    for (u64 i = 0; i < 20000; i += 1) {
+	    	u64 v = i+1;
+	    	hash_map_set(&numbers, i, v);
+	    	if (i % 3 == 0) {
+	    		u64 k = i/2;
+	    		hash_map_remove(&numbers, k);
+	    	}
+	    }
+    }
+    assert(numbers.capacity - numbers.capacity/8 >= numbers.count, "Failed: Hash map is too full");
+    u64 found_count = 0;
+    for (u64 i = 0; i < 20000; i += 1) {
+    	u64 *v = (u64*)hash_map_find(&numbers, i);
+    	if (v) {
+    		assert(*v == i+1, "Failed: Wrong value");
+    		found_count += 1;
+    	}
+    }
+    assert(found_count == numbers.count, "Failed: Hash map count is wrong");
+    u64 iterated_count = 0;
+    u64 iterator = 0;
+    u64 *k;
+    u64 *v;
+    while (hash_map_iterate(&numbers, &iterator, (void**)&k, (void**)&v)) {
+    	assert(*v == *k+1, "Failed: Iterated key & value don't match");
+    	iterated_count += 1;
+    }
+    assert(iterated_count == numbers.count, "Failed: Iteration missed entries");
+    hash_map_destroy(&numbers);
+    
+    Hash_Map reserved = make_hash_map_reserve(u64, u64, 1000, heap);
+    u64 reserved_capacity = reserved.capacity;
+    for (u64 i = 0; i < 1000; i += 1) hash_map_set(&reserved, i, i);
+    assert(reserved.capacity == reserved_capacity, "Failed: Reserved hash map should not grow");
+    hash_map_destroy(&reserved);
+}
+
+void test_hash_map_vs_hash_table_performance() {
+	Allocator heap = get_heap_allocator();
+	
+#if RUN_TEST_BENCHMARKS
+	u64 counts[] = { 1000, 100000, 10000000 };
+#else
+	u64 counts[] = { 1000, 100000 };
+#endif
+	u64 lookup_count = 1000000;
+	
+	for (u64 c = 0; c < sizeof(counts)/sizeof(counts[0]); c += 1) {
+		u64 count = counts[c];
+		
+		Hash_Table table = make_hash_table(u64, u64, heap);
+		Hash_Map map = make_hash_map(u64, u64, heap);
+		
+		f64 start = os_get_elapsed_seconds();
+		for (u64 i = 0; i < count; i += 1) {
+			u64 k = i*0x9E3779B97F4A7C15ULL;
+			hash_table_set(&table, k, i);
+		}
+		f64 table_insert_seconds = os_get_elapsed_seconds()-start;
+		
+		start = os_get_elapsed_seconds();
+		for (u64 i = 0; i < count; i += 1) {
+			u64 k = i*0x9E3779B97F4A7C15ULL;
+			hash_map_set(&map, k, i);
+		}
+		f64 map_insert_seconds = os_get_elapsed_seconds()-start;
+		
+		// Same pseudo random lookup order for both, half hits and half misses
+		u64 table_sum = 0;
+		u64 seed = 1;
+		start = os_get_elapsed_seconds();
+		for (u64 i = 0; i < lookup_count; i += 1) {
+			seed = seed*6364136223846793005ULL + 1442695040888963407ULL;
+			u64 k = ((seed >> 33) % (count*2))*0x9E3779B97F4A7C15ULL;
+			u64 *v = (u64*)hash_table_find(&table, k);
+			if (v) table_sum += *v+1;
+		}
+		f64 table_find_seconds = os_get_elapsed_seconds()-start;
+		
+		u64 map_sum = 0;
+		seed = 1;
+		start = os_get_elapsed_seconds();
+		for (u64 i = 0; i < lookup_count; i += 1) {
+			seed = seed*6364136223846793005ULL + 1442695040888963407ULL;
+			u64 k = ((seed >> 33) % (count*2))*0x9E3779B97F4A7C15ULL;
+			u64 *v = (u64*)hash_map_find(&map, k);
+			if (v) map_sum += *v+1;
+		}
+		f64 map_find_seconds = os_get_elapsed_seconds()-start;
+		
+		assert(table_sum == map_sum, "Failed: Hash map and hash table found different values");
+		assert(map.count == count, "Failed: Hash map count is wrong");
+		
+		print("\n\t%llu entries, load %.2f: ", count, (f64)map.count/(f64)map.capacity);
+		print("insert table %.2f ms, map %.2f ms. ", table_insert_seconds*1000.0, map_insert_seconds*1000.0);
+		print("%llu lookups table %.2f ms, map %.2f ms", lookup_count, table_find_seconds*1000.0, map_find_seconds*1000.0);
+		
+		hash_table_destroy(&table);
+		hash_map_destroy(&map);
+	}
+	print("\n");
+}
+
+DEFINE_TYPED_ARRAY(test_u64_array, u64, typed_equals_scalar)
+DEFINE_TYPED_ARRAY(test_thing_array, Pool_Test_Thing, typed_equals_bytes)
+DEFINE_TYPED_MAP(test_u64_map, u64, u64, get_hash, typed_equals_scalar)
+DEFINE_TYPED_MAP(test_string_map, string, s32, get_hash, typed_equals_string)
+
+void test_typed_containers() {
+	Allocator heap = get_heap_allocator();
+	
+	u64 *numbers;
+	test_u64_array_init(&numbers, heap);
+	for (u64 i = 0; i < 1000; i += 1) {
+		test_u64_array_add(&numbers, i);
+	}
+	assert(test_u64_array_count(numbers) == 1000, "Failed: Typed array count");
+	assert(growing_array_get_valid_count(numbers) == 1000, "Failed: Typed array should be a regular growing array");
+	assert(test_u64_array_find(numbers, 500) == 500, "Failed: Typed array find");
+	assert(test_u64_array_find(numbers, 5000) == -1, "Failed: Typed array find of missing item");
+	test_u64_array_ordered_remove(&numbers, 0);
+	assert(numbers[0] == 1 && numbers[998] == 999, "Failed: Typed array ordered remove");
+	test_u64_array_unordered_remove(&numbers, 0);
+	assert(numbers[0] == 999, "Failed: Typed array unordered remove");
+	assert(test_u64_array_unordered_remove_one_by_value(&numbers, 2), "Failed: Typed array remove by value");
+	assert(test_u64_array_find(numbers, 2) == -1, "Failed: Typed array remove by value");
+	assert(test_u64_array_pop(&numbers) == 997, "Failed: Typed array pop");
+	u64 more[] = { 7, 8, 9 };
+	test_u64_array_add_multiple(&numbers, more, 3);
+	assert(test_u64_array_count(numbers) == 999 && numbers[998] == 9, "Failed: Typed array add multiple");
+	// Untyped API on the same array
+	u64 x = 69;
+	growing_array_add((void**)&numbers, &x);
+	assert(numbers[999] == 69, "Failed: Untyped add on a typed array");
+	test_u64_array_deinit(&numbers);
+	
+	Pool_Test_Thing *things;
+	test_thing_array_init(&things, heap);
+	Pool_Test_Thing thing = {0};
+	thing.value = 5;
+	test_thing_array_add(&things, thing);
+	assert(test_thing_array_find(things, thing) == 0, "Failed: Typed array bytes compare");
+	test_thing_array_deinit(&things);
+	
+	Hash_Map map = test_u64_map_make(heap);
+	for (u64 i = 0; i < 20000; i += 1) {
+		assert(test_u64_map_set(&map, i, i*2), "Failed: Typed map key should be newly added");
+		if (i % 3 == 0) test_u64_map_remove(&map, i/2);
+	}
+	assert(!test_u64_map_set(&map, 19999, 1), "Failed: Typed map key should exist");
+	assert(*test_u64_map_find(&map, 19999) == 1, "Failed: Typed map set should overwrite");
+	u64 found_count = 0;
+	for (u64 i = 0; i < 20000; i += 1) {
+		u64 *v = test_u64_map_find(&map, i);
+		// Untyped API on the same map
+		u64 *untyped = (u64*)hash_map_find(&map, i);
+		assert(v == untyped, "Failed: Typed and untyped map lookups differ");
+		if (v) found_count += 1;
+	}
+	assert(found_count == map.count, "Failed: Typed map count");
+	hash_map_destroy(&map);
+	
+	Hash_Map strings = test_string_map_make(heap);
+	string key = STR("Key string");
+	string key_copy = string_copy(key, heap);
+	test_string_map_set(&strings, key, 69);
+	assert(test_string_map_contains(&strings, key_copy), "Failed: Typed map string keys should be compared by content");
+	assert(test_string_map_remove(&strings, key_copy), "Failed: Typed map string remove");
+	assert(strings.count == 0, "Failed: Typed map string remove");
+	dealloc_string(heap, key_copy);
+	hash_map_destroy(&strings);
+	
+	// Typed vs untyped
+	u64 item_count = RUN_TEST_BENCHMARKS ? 10000000 : 100000;
+	u64 *untyped_array;
+	growing_array_init((void**)&untyped_array, sizeof(u64), heap);
+	f64 start = os_get_elapsed_seconds();
+	for (u64 i = 0; i < item_count; i += 1) {
+		growing_array_add((void**)&untyped_array, &i);
+	}
+	f64 untyped_seconds = os_get_elapsed_seconds()-start;
+	
+	u64 *typed_array;
+	test_u64_array_init(&typed_array, heap);
+	start = os_get_elapsed_seconds();
+	for (u64 i = 0; i < item_count; i += 1) {
+		test_u64_array_add(&typed_array, i);
+	}
+	f64 typed_seconds = os_get_elapsed_seconds()-start;
+	assert(bytes_match(untyped_array, typed_array, item_count*sizeof(u64)), "Failed: Typed & untyped arrays differ");
+	growing_array_deinit((void**)&untyped_array);
+	test_u64_array_deinit(&typed_array);
+	
+	print("\n\t%llu adds: growing_array_add %.2f ms, ", item_count, untyped_seconds*1000.0);
+	print("typed add %.2f ms\n", typed_seconds*1000.0);
 }
 
 #define NUM_BINS 100
@@ -1368,6 +2261,56 @@ void test_random_distribution() {
     print("Min: %d, max: %d\n", min_bin, max_bin);
 }
 
+typedef struct Test_Thread {
+	void *data;
+	u64 index;
+	Thread_Proc proc;
+	Barrier *start_barrier;
+	float64 *start_time;
+	float64 end_time;
+} Test_Thread;
+void test_thread_proc(Thread *t) {
+	Test_Thread *tt = (Test_Thread*)t->data;
+	// The last thread to get here releases the others, so thread startup isn't timed
+	if (barrier_wait(tt->start_barrier)) *tt->start_time = os_get_elapsed_seconds();
+	tt->proc(t);
+	tt->end_time = os_get_elapsed_seconds();
+}
+// Runs procs[i] on thread i, with t->data pointing to a Test_Thread.
+// Returns seconds from when all threads are up until the last proc returns.
+float64 test_run_threads(Thread_Proc *procs, u64 count, void *data) {
+	Allocator heap = get_heap_allocator();
+	Thread *threads = (Thread*)alloc(heap, count*sizeof(Thread));
+	Test_Thread *thread_data = (Test_Thread*)alloc(heap, count*sizeof(Test_Thread));
+	Barrier start_barrier;
+	barrier_init(&start_barrier, (u32)count);
+	float64 start_time = 0;
+	
+	for (u64 i = 0; i < count; i += 1) {
+		thread_data[i] = (Test_Thread){data, i, procs[i], &start_barrier, &start_time, 0};
+		os_thread_init(&threads[i], test_thread_proc);
+		threads[i].data = &thread_data[i];
+		os_thread_start(&threads[i]);
+	}
+	float64 end_time = 0;
+	for (u64 i = 0; i < count; i += 1) {
+		os_thread_join(&threads[i]);
+		os_thread_destroy(&threads[i]);
+		end_time = max(end_time, thread_data[i].end_time);
+	}
+	
+	dealloc(heap, threads);
+	dealloc(heap, thread_data);
+	return end_time - start_time;
+}
+// Same proc on every thread
+float64 test_run_threads_with_proc(Thread_Proc proc, u64 count, void *data) {
+	Thread_Proc procs[64];
+	assert(count <= 64, "Too many test threads");
+	for (u64 i = 0; i < count; i += 1) procs[i] = proc;
+	return test_run_threads(procs, count, data);
+}
+
 #define MUTEX_TEST_TASK_COUNT 1000
 typedef struct Mutex_Test_Shared_Data {
     int counter;
@@ -1385,20 +2328,72 @@ void mutex_test_increment_counter(Thread* t) {
         mutex_release(&data->mutex);
     }
 }
+// The Mutex as it was before it got an atomic fast path, to benchmark against.
+// Spins on a spinlock for a while and then always locks an OS mutex, even when it won the spinlock.
+typedef struct Legacy_Mutex {
+	Spinlock spinlock;
+	Mutex_Handle os_handle;
+	volatile bool spinlock_acquired;
+} Legacy_Mutex;
+void legacy_mutex_init(Legacy_Mutex *m) {
+	spinlock_init(&m->spinlock);
+	m->os_handle = os_make_mutex();
+	m->spinlock_acquired = false;
+}
+void legacy_mutex_destroy(Legacy_Mutex *m) {
+	os_destroy_mutex(m->os_handle);
+}
+void legacy_mutex_acquire_or_wait(Legacy_Mutex *m) {
+	if (spinlock_acquire_or_wait_timeout(&m->spinlock, MUTEX_DEFAULT_SPIN_TIME_MICROSECONDS/1000000.0)) {
+		m->spinlock_acquired = true;
+	}
+	os_lock_mutex(m->os_handle);
+}
+void legacy_mutex_release(Legacy_Mutex *m) {
+	bool was_spinlock_acquired = m->spinlock_acquired;
+	m->spinlock_acquired = false;
+	os_unlock_mutex(m->os_handle);
+	if (was_spinlock_acquired) spinlock_release(&m->spinlock);
+}
+
+#define MUTEX_BENCHMARK_ITERATIONS 200000
+#define MUTEX_BENCHMARK_THREAD_COUNT 4
+typedef struct Mutex_Benchmark_Data {
+	Mutex mutex;
+	Legacy_Mutex legacy;
+	u64 counter;
+} Mutex_Benchmark_Data;
+void mutex_benchmark_proc(Thread *t) {
+	Mutex_Benchmark_Data *d = (Mutex_Benchmark_Data*)((Test_Thread*)t->data)->data;
+	for (u64 i = 0; i < MUTEX_BENCHMARK_ITERATIONS; i += 1) {
+		mutex_acquire_or_wait(&d->mutex);
+		d->counter += 1;
+		mutex_release(&d->mutex);
+	}
+}
+void legacy_mutex_benchmark_proc(Thread *t) {
+	Mutex_Benchmark_Data *d = (Mutex_Benchmark_Data*)((Test_Thread*)t->data)->data;
+	for (u64 i = 0; i < MUTEX_BENCHMARK_ITERATIONS; i += 1) {
+		legacy_mutex_acquire_or_wait(&d->legacy);
+		d->counter += 1;
+		legacy_mutex_release(&d->legacy);
+	}
+}
+
 void test_mutex() {
     Mutex m;
     
     // Test initialization
     mutex_init(&m);
     assert(m.spin_time_microseconds == MUTEX_DEFAULT_SPIN_TIME_MICROSECONDS, "Failed: Default spin time incorrect");
-    assert(!m.spinlock_acquired, "Failed: Spinlock should not be acquired after initialization");
+    assert(m.state == MUTEX_STATE_UNLOCKED, "Failed: Mutex should not be acquired after initialization");
 
     // Test acquire and release without contention
     mutex_acquire_or_wait(&m);
-    assert(m.spinlock_acquired, "Failed: Mutex should be acquired after mutex_acquire_or_wait");
+    assert(m.state == MUTEX_STATE_LOCKED, "Failed: Mutex should be acquired after mutex_acquire_or_wait");
     
     mutex_release(&m);
-    assert(!m.spinlock_acquired, "Failed: Spinlock should not be acquired after mutex_release");
+    assert(m.state == MUTEX_STATE_UNLOCKED, "Failed: Mutex should not be acquired after mutex_release");
 
     // Clean up
     mutex_destroy(&m);
@@ -1422,11 +2417,1242 @@ void test_mutex() {
 	}
 	for (u64 i = 0; i < num_threads; i++) {
     	os_thread_join(&threads[i]);
+    	os_thread_destroy(&threads[i]);
 	}
 
     assert(data.counter == num_threads * MUTEX_TEST_TASK_COUNT, "Failed: Counter does not match expected value after threading tasks");
-
+    
+    dealloc(allocator, threads);
     mutex_destroy(&data.mutex);
+    
+    // Mutex vs the old one
+    Mutex_Benchmark_Data *bench = (Mutex_Benchmark_Data*)alloc(allocator, sizeof(Mutex_Benchmark_Data));
+    *bench = ZERO(Mutex_Benchmark_Data);
+    mutex_init(&bench->mutex);
+    legacy_mutex_init(&bench->legacy);
+    
+    float64 start = os_get_elapsed_seconds();
+    for (u64 i = 0; i < MUTEX_BENCHMARK_ITERATIONS; i += 1) {
+        mutex_acquire_or_wait(&bench->mutex);
+        bench->counter += 1;
+        mutex_release(&bench->mutex);
+    }
+    float64 uncontended = os_get_elapsed_seconds() - start;
+    start = os_get_elapsed_seconds();
+    for (u64 i = 0; i < MUTEX_BENCHMARK_ITERATIONS; i += 1) {
+        legacy_mutex_acquire_or_wait(&bench->legacy);
+        bench->counter += 1;
+        legacy_mutex_release(&bench->legacy);
+    }
+    float64 legacy_uncontended = os_get_elapsed_seconds() - start;
+    
+    bench->counter = 0;
+    float64 contended = test_run_threads_with_proc(mutex_benchmark_proc, MUTEX_BENCHMARK_THREAD_COUNT, bench);
+    assert(bench->counter == MUTEX_BENCHMARK_THREAD_COUNT*MUTEX_BENCHMARK_ITERATIONS, "Failed: Lost increments under contention");
+    bench->counter = 0;
+    float64 legacy_contended = test_run_threads_with_proc(legacy_mutex_benchmark_proc, MUTEX_BENCHMARK_THREAD_COUNT, bench);
+    assert(bench->counter == MUTEX_BENCHMARK_THREAD_COUNT*MUTEX_BENCHMARK_ITERATIONS, "Failed: Lost increments under contention with the old mutex");
+    
+    const float64 ns = 1000000000.0;
+    const float64 contended_count = MUTEX_BENCHMARK_THREAD_COUNT*MUTEX_BENCHMARK_ITERATIONS;
+    print("\n    Uncontended: Mutex %.2fns, ", (uncontended/MUTEX_BENCHMARK_ITERATIONS)*ns);
+    print("old mutex %.2fns per acquire & release\n", (legacy_uncontended/MUTEX_BENCHMARK_ITERATIONS)*ns);
+    print("    %d threads contended: ", MUTEX_BENCHMARK_THREAD_COUNT);
+    print("Mutex %.2fns, ", (contended/contended_count)*ns);
+    print("old mutex %.2fns per acquire & release\n", (legacy_contended/contended_count)*ns);
+    
+    mutex_destroy(&bench->mutex);
+    legacy_mutex_destroy(&bench->legacy);
+    dealloc(allocator, bench);
+}
+
+#define ATOMIC_TEST_THREAD_COUNT 4
+#define ATOMIC_TEST_ITERATIONS 1000000
+typedef struct Atomic_Test_Data {
+	volatile u64 shared_64;
+	volatile u32 shared_32;
+	Padded_U64 *padded_counters;
+} Atomic_Test_Data;
+void atomic_test_add_proc(Thread *t) {
+	Atomic_Test_Data *d = (Atomic_Test_Data*)((Test_Thread*)t->data)->data;
+	for (u64 i = 0; i < ATOMIC_TEST_ITERATIONS; i += 1) {
+		atomic_add_64(&d->shared_64, 3);
+		atomic_sub_64(&d->shared_64, 1);
+		atomic_add_32(&d->shared_32, 1);
+	}
+}
+void atomic_test_padded_proc(Thread *t) {
+	Test_Thread *tt = (Test_Thread*)t->data;
+	Atomic_Test_Data *d = (Atomic_Test_Data*)tt->data;
+	volatile u64 *counter = &d->padded_counters[tt->index].value;
+	for (u64 i = 0; i < ATOMIC_TEST_ITERATIONS; i += 1) *counter += 1;
+}
+void test_atomics() {
+	Allocator heap = get_heap_allocator();
+	
+	volatile u64 x64 = 10;
+	volatile u32 x32 = 10;
+	assert(atomic_add_64(&x64, 5) == 10 && x64 == 15, "Failed: atomic_add_64");
+	assert(atomic_sub_64(&x64, 20) == 15 && x64 == (u64)-5, "Failed: atomic_sub_64");
+	assert(atomic_exchange_64(&x64, 7) == (u64)-5 && x64 == 7, "Failed: atomic_exchange_64");
+	assert(atomic_add_32(&x32, 5) == 10 && x32 == 15, "Failed: atomic_add_32");
+	assert(atomic_sub_32(&x32, 16) == 15 && x32 == 0xFFFFFFFF, "Failed: atomic_sub_32");
+	assert(atomic_exchange_32(&x32, 7) == 0xFFFFFFFF && x32 == 7, "Failed: atomic_exchange_32");
+	atomic_store_64(&x64, 1); assert(atomic_load_64(&x64) == 1, "Failed: atomic load/store 64");
+	atomic_store_release_64(&x64, 2); assert(atomic_load_acquire_64(&x64) == 2, "Failed: atomic acquire/release 64");
+	atomic_store_relaxed_64(&x64, 3); assert(atomic_load_relaxed_64(&x64) == 3, "Failed: atomic relaxed 64");
+	atomic_store_32(&x32, 1); assert(atomic_load_32(&x32) == 1, "Failed: atomic load/store 32");
+	atomic_store_release_32(&x32, 2); assert(atomic_load_acquire_32(&x32) == 2, "Failed: atomic acquire/release 32");
+	atomic_store_relaxed_32(&x32, 3); assert(atomic_load_relaxed_32(&x32) == 3, "Failed: atomic relaxed 32");
+	
+	assert(sizeof(Padded_U64) == CACHE_LINE_SIZE && sizeof(Padded_U32) == CACHE_LINE_SIZE, "Failed: Padded types should be one cache line");
+	
+	Atomic_Test_Data d = ZERO(Atomic_Test_Data);
+	test_run_threads_with_proc(atomic_test_add_proc, ATOMIC_TEST_THREAD_COUNT, &d);
+	assert(d.shared_64 == ATOMIC_TEST_THREAD_COUNT*ATOMIC_TEST_ITERATIONS*2, "Failed: Lost atomic adds (%llu)", d.shared_64);
+	assert(d.shared_32 == ATOMIC_TEST_THREAD_COUNT*ATOMIC_TEST_ITERATIONS, "Failed: Lost atomic adds (%u)", d.shared_32);
+	
+	for (u64 i = 1; i < 100; i += 1) {
+		void *p = alloc_cache_line_aligned(heap, i*8);
+		assert((u64)p % CACHE_LINE_SIZE == 0, "Failed: alloc_cache_line_aligned is not aligned");
+		memset(p, 0xFF, i*8);
+		dealloc_cache_line_aligned(heap, p);
+	}
+	
+	// Per thread counters, each on its own cache line
+	d.padded_counters = (Padded_U64*)alloc_cache_line_aligned(heap, ATOMIC_TEST_THREAD_COUNT*sizeof(Padded_U64));
+	memset(d.padded_counters, 0, ATOMIC_TEST_THREAD_COUNT*sizeof(Padded_U64));
+	test_run_threads_with_proc(atomic_test_padded_proc, ATOMIC_TEST_THREAD_COUNT, &d);
+	for (u64 i = 0; i < ATOMIC_TEST_THREAD_COUNT; i += 1) {
+		assert(d.padded_counters[i].value == ATOMIC_TEST_ITERATIONS, "Failed: Per thread counter is wrong");
+	}
+	dealloc_cache_line_aligned(heap, d.padded_counters);
+}
+
+#define SYNC_TEST_THREAD_COUNT 8
+#define SYNC_TEST_ITERATIONS 20000
+typedef struct Sync_Test_Data {
+	Rw_Lock rw_lock;
+	volatile u64 a, b; // Written together under the write lock
+	volatile u32 active_readers;
+	volatile u32 active_writers;
+	volatile u64 write_count;
+	
+	Semaphore semaphore;
+	volatile u32 semaphore_holders;
+	volatile u32 max_semaphore_holders;
+	
+	Barrier barrier;
+	volatile u64 round_slots[SYNC_TEST_THREAD_COUNT];
+	volatile u32 barrier_winners;
+	
+	Event ping, pong;
+	volatile u64 ping_count;
+} Sync_Test_Data;
+
+void sync_test_rw_lock_proc(Thread *t) {
+	Test_Thread *st = (Test_Thread*)t->data;
+	Sync_Test_Data *d = (Sync_Test_Data*)st->data;
+	for (u64 i = 0; i < SYNC_TEST_ITERATIONS; i += 1) {
+		if ((i + st->index) % 10 == 0) {
+			rw_lock_acquire_write_or_wait(&d->rw_lock);
+			assert(d->active_readers == 0, "Failed: Rw_Lock writer got in with readers");
+			assert(atomic_add_32(&d->active_writers, 1) == 0, "Failed: Two Rw_Lock writers got in");
+			d->a += 1;
+			d->b += 1;
+			d->write_count += 1;
+			atomic_sub_32(&d->active_writers, 1);
+			rw_lock_release_write(&d->rw_lock);
+		} else {
+			rw_lock_acquire_read_or_wait(&d->rw_lock);
+			atomic_add_32(&d->active_readers, 1);
+			assert(d->active_writers == 0, "Failed: Rw_Lock reader got in with a writer");
+			assert(d->a == d->b, "Failed: Rw_Lock reader saw a half done write");
+			atomic_sub_32(&d->active_readers, 1);
+			rw_lock_release_read(&d->rw_lock);
+		}
+	}
+}
+void sync_test_semaphore_proc(Thread *t) {
+	Test_Thread *st = (Test_Thread*)t->data;
+	Sync_Test_Data *d = (Sync_Test_Data*)st->data;
+	for (u64 i = 0; i < SYNC_TEST_ITERATIONS; i += 1) {
+		semaphore_wait(&d->semaphore);
+		u32 holders = atomic_add_32(&d->semaphore_holders, 1) + 1;
+		while (true) {
+			u32 max_holders = d->max_semaphore_holders;
+			if (holders <= max_holders || compare_and_swap_32(&d->max_semaphore_holders, holders, max_holders)) break;
+		}
+		atomic_sub_32(&d->semaphore_holders, 1);
+		semaphore_signal(&d->semaphore, 1);
+	}
+}
+void sync_test_barrier_proc(Thread *t) {
+	Test_Thread *st = (Test_Thread*)t->data;
+	Sync_Test_Data *d = (Sync_Test_Data*)st->data;
+	for (u64 round = 1; round <= 1000; round += 1) {
+		d->round_slots[st->index] = round;
+		if (barrier_wait(&d->barrier)) atomic_add_32(&d->barrier_winners, 1);
+		for (u64 i = 0; i < SYNC_TEST_THREAD_COUNT; i += 1) {
+			assert(d->round_slots[i] == round, "Failed: Thread got past the barrier before everyone arrived");
+		}
+		// Nobody writes the next round until everyone has checked this one
+		barrier_wait(&d->barrier);
+	}
+}
+void sync_test_pong_proc(Thread *t) {
+	Test_Thread *st = (Test_Thread*)t->data;
+	Sync_Test_Data *d = (Sync_Test_Data*)st->data;
+	for (u64 i = 0; i < SYNC_TEST_ITERATIONS; i += 1) {
+		event_wait(&d->ping);
+		assert(d->ping_count == i+1, "Failed: Event let a wait through without a signal");
+		event_signal(&d->pong);
+	}
+}
+void test_sync_primitives() {
+	Allocator heap = get_heap_allocator();
+	Sync_Test_Data *d = (Sync_Test_Data*)alloc(heap, sizeof(Sync_Test_Data));
+	// Counters start at zero, and every primitive is still inited explicitly below
+	*d = ZERO(Sync_Test_Data);
+	
+	rw_lock_init(&d->rw_lock);
+	rw_lock_acquire_read_or_wait(&d->rw_lock);
+	rw_lock_acquire_read_or_wait(&d->rw_lock);
+	assert(d->rw_lock.state == 2, "Failed: Rw_Lock should allow several readers");
+	rw_lock_release_read(&d->rw_lock);
+	rw_lock_release_read(&d->rw_lock);
+	rw_lock_acquire_write_or_wait(&d->rw_lock);
+	assert(d->rw_lock.state == RW_LOCK_WRITER, "Failed: Rw_Lock should be write acquired");
+	rw_lock_release_write(&d->rw_lock);
+	assert(d->rw_lock.state == 0, "Failed: Rw_Lock should be free");
+	
+	test_run_threads_with_proc(sync_test_rw_lock_proc, SYNC_TEST_THREAD_COUNT, d);
+	assert(d->write_count == SYNC_TEST_THREAD_COUNT*SYNC_TEST_ITERATIONS/10, "Failed: Rw_Lock lost writes (%llu)", d->write_count);
+	assert(d->a == d->write_count && d->b == d->write_count, "Failed: Rw_Lock lost writes");
+	assert(d->rw_lock.state == 0, "Failed: Rw_Lock should be free after the stress test");
+	
+	semaphore_init(&d->semaphore, 2);
+	assert(semaphore_try_wait(&d->semaphore) && semaphore_try_wait(&d->semaphore), "Failed: Semaphore should have 2");
+	assert(!semaphore_try_wait(&d->semaphore), "Failed: Semaphore should be empty");
+	semaphore_signal(&d->semaphore, 3);
+	assert(d->semaphore.count == 3, "Failed: Semaphore should have 3");
+	
+	test_run_threads_with_proc(sync_test_semaphore_proc, SYNC_TEST_THREAD_COUNT, d);
+	assert(d->max_semaphore_holders <= 3, "Failed: Semaphore let %u threads in at once", d->max_semaphore_holders);
+	assert(d->semaphore.count == 3, "Failed: Semaphore count should be back to 3");
+	
+	barrier_init(&d->barrier, SYNC_TEST_THREAD_COUNT);
+	test_run_threads_with_proc(sync_test_barrier_proc, SYNC_TEST_THREAD_COUNT, d);
+	assert(d->barrier_winners == 1000, "Failed: Expected one barrier_wait to return true per round, got %u", d->barrier_winners);
+	
+	event_init(&d->ping, false);
+	event_init(&d->pong, false);
+	event_signal(&d->pong);
+	event_signal(&d->pong);
+	event_wait(&d->pong);
+	assert(d->pong.signaled == 0, "Failed: Event should reset after a wait and signals should not stack");
+	
+	Thread pong_thread;
+	Test_Thread pong_data = {d, 0};
+	os_thread_init(&pong_thread, sync_test_pong_proc);
+	pong_thread.data = &pong_data;
+	os_thread_start(&pong_thread);
+	for (u64 i = 0; i < SYNC_TEST_ITERATIONS; i += 1) {
+		d->ping_count += 1;
+		event_signal(&d->ping);
+		event_wait(&d->pong);
+	}
+	os_thread_join(&pong_thread);
+	os_thread_destroy(&pong_thread);
+	
+	dealloc(heap, d);
+}
+
+#define INTERN_TEST_STRING_COUNT 4000
+void intern_test_thread_proc(Thread *t) {
+	Atom *atoms = (Atom*)t->data;
+	for (u64 i = 0; i < INTERN_TEST_STRING_COUNT; i += 1) {
+		string s = sprintf(get_heap_allocator(), "intern test %llu", i);
+		atoms[i] = intern_string(s);
+		dealloc_string(get_heap_allocator(), s);
+		reset_temporary_storage();
+	}
+}
+void test_string_intern() {
+	Allocator heap = get_heap_allocator();
+	
+	Atom a = intern_string(STR("Atom a"));
+	Atom b = intern_string(STR("Atom b"));
+	string a_copy = string_copy(STR("Atom a"), heap);
+	assert(a != ATOM_NONE && b != ATOM_NONE && a != b, "Failed: Different strings should be different atoms");
+	assert(intern_string(a_copy) == a, "Failed: Same string should give the same atom");
+	assert(find_atom(a_copy) == a, "Failed: find_atom");
+	assert(find_atom(STR("Never interned")) == ATOM_NONE, "Failed: find_atom on a string that was never interned");
+	assert(strings_match(atom_get_string(a), a_copy), "Failed: atom_get_string");
+	assert(atom_get_string(a).data != a_copy.data, "Failed: Interned strings should be copied");
+	assert(atom_get_hash(a) == string_get_hash(a_copy), "Failed: atom_get_hash");
+	Atom empty = intern_string(STR(""));
+	assert(empty != ATOM_NONE && atom_get_string(empty).count == 0, "Failed: Empty string should be interned too");
+	dealloc_string(heap, a_copy);
+	
+	// Threads interning the same strings at the same time get the same atoms
+	const u64 thread_count = 8;
+	Thread threads[8];
+	Atom *atoms = (Atom*)alloc(heap, thread_count*INTERN_TEST_STRING_COUNT*sizeof(Atom));
+	u64 atom_count_before = get_atom_count();
+	for (u64 i = 0; i < thread_count; i += 1) {
+		os_thread_init(&threads[i], intern_test_thread_proc);
+		threads[i].data = atoms + i*INTERN_TEST_STRING_COUNT;
+	}
+	for (u64 i = 0; i < thread_count; i += 1) os_thread_start(&threads[i]);
+	for (u64 i = 0; i < thread_count; i += 1) {
+		os_thread_join(&threads[i]);
+		os_thread_destroy(&threads[i]);
+	}
+	assert(get_atom_count() == atom_count_before + INTERN_TEST_STRING_COUNT, "Failed: Strings were interned more than once");
+	for (u64 i = 0; i < INTERN_TEST_STRING_COUNT; i += 1) {
+		for (u64 t = 1; t < thread_count; t += 1) {
+			assert(atoms[t*INTERN_TEST_STRING_COUNT + i] == atoms[i], "Failed: Threads got different atoms for the same string");
+		}
+		string expected = sprintf(heap, "intern test %llu", i);
+		assert(strings_match(atom_get_string(atoms[i]), expected), "Failed: Atom has the wrong string");
+		dealloc_string(heap, expected);
+	}
+	dealloc(heap, atoms);
+}
+
+typedef struct Job_Test_Data {
+	u64 *numbers;
+	volatile u64 sum;
+	volatile u64 jobs_done;
+	Job_Counter *counter;
+} Job_Test_Data;
+void job_test_sum_proc(u64 start, u64 end, void *data) {
+	Job_Test_Data *d = (Job_Test_Data*)data;
+	u64 sum = 0;
+	for (u64 i = start; i < end; i += 1) sum += d->numbers[i];
+	atomic_add_64(&d->sum, sum);
+}
+void job_test_count_proc(void *data) {
+	Job_Test_Data *d = (Job_Test_Data*)data;
+	atomic_add_64(&d->jobs_done, 1);
+}
+// Fork-join from inside a job, and more jobs than fit in a worker's deque
+void job_test_spawn_proc(void *data) {
+	Job_Test_Data *d = (Job_Test_Data*)data;
+	Job_Counter children = {0};
+	for (u64 i = 0; i < JOB_DEQUE_CAPACITY*2; i += 1) {
+		job_run(job_test_count_proc, d, &children);
+	}
+	job_counter_wait(&children);
+	assert(children.count == 0, "Failed: Job counter should be 0 after waiting");
+	assert(d->jobs_done >= JOB_DEQUE_CAPACITY*2, "Failed: Child jobs should be done after waiting");
+}
+// Every job fills most of the worker's temp storage, which only fits if workers reset it
+void job_test_temp_proc(void *data) {
+	Job_Test_Data *d = (Job_Test_Data*)data;
+	u64 overflows_before = get_temporary_storage_overflow_count();
+	u8 *p = (u8*)talloc(JOB_WORKER_TEMPORARY_STORAGE_SIZE/4*3);
+	memset(p, 0xCD, JOB_WORKER_TEMPORARY_STORAGE_SIZE/4*3);
+	if (get_temporary_storage_overflow_count() != overflows_before) atomic_add_64(&d->sum, 1);
+}
+void job_test_work_proc(u64 start, u64 end, void *data) {
+	Job_Test_Data *d = (Job_Test_Data*)data;
+	for (u64 i = start; i < end; i += 1) {
+		u64 x = i;
+		for (u64 j = 0; j < 200; j += 1) x = x*6364136223846793005ULL + 1442695040888963407ULL;
+		d->numbers[i] = x;
+	}
+}
+void test_job_system() {
+	Allocator heap = get_heap_allocator();
+	
+	const u64 count = 1000000;
+	Job_Test_Data data = ZERO(Job_Test_Data);
+	data.numbers = (u64*)alloc(heap, count*sizeof(u64));
+	for (u64 i = 0; i < count; i += 1) data.numbers[i] = i;
+	
+	parallel_for(count, 1000, job_test_sum_proc, &data);
+	assert(data.sum == count*(count-1)/2, "Failed: parallel_for sum is wrong (%llu)", data.sum);
+	assert(job_system_get_worker_count() >= 1, "Failed: Job system should have at least one worker");
+	
+	// Uneven ranges & grain bigger than count
+	data.sum = 0;
+	parallel_for(1001, 7, job_test_sum_proc, &data);
+	assert(data.sum == 1001*1000/2, "Failed: parallel_for sum is wrong for uneven ranges (%llu)", data.sum);
+	data.sum = 0;
+	parallel_for(10, 100, job_test_sum_proc, &data);
+	assert(data.sum == 45, "Failed: parallel_for sum is wrong for a single range (%llu)", data.sum);
+	
+	// Jobs from a thread outside of the pool
+	Job_Counter counter = {0};
+	data.jobs_done = 0;
+	for (u64 i = 0; i < 10000; i += 1) {
+		job_run(job_test_count_proc, &data, &counter);
+	}
+	job_counter_wait(&counter);
+	assert(data.jobs_done == 10000, "Failed: Expected 10000 jobs done, got %llu", data.jobs_done);
+	
+	data.jobs_done = 0;
+	for (u64 i = 0; i < 8; i += 1) {
+		job_run(job_test_spawn_proc, &data, &counter);
+	}
+	job_counter_wait(&counter);
+	assert(data.jobs_done == 8*JOB_DEQUE_CAPACITY*2, "Failed: Expected all nested jobs done, got %llu", data.jobs_done);
+	
+	data.sum = 0;
+	for (u64 i = 0; i < 64; i += 1) {
+		job_run(job_test_temp_proc, &data, &counter);
+	}
+	// Not job_counter_wait(), so the workers run all of them
+	while (counter.count) os_yield_thread();
+	assert(data.sum == 0, "Failed: Workers should reset temporary storage after each job (%llu overflows)", data.sum);
+	
+	// Restarts on first use after shutdown
+	job_system_shutdown();
+	data.sum = 0;
+	parallel_for(count, 1000, job_test_sum_proc, &data);
+	assert(data.sum == count*(count-1)/2, "Failed: parallel_for sum is wrong after restart (%llu)", data.sum);
+	
+	float64 start = os_get_elapsed_seconds();
+	job_test_work_proc(0, count, &data);
+	float64 serial = os_get_elapsed_seconds() - start;
+	u64 serial_result = data.numbers[count-1];
+	
+	start = os_get_elapsed_seconds();
+	parallel_for(count, 1024, job_test_work_proc, &data);
+	float64 parallel = os_get_elapsed_seconds() - start;
+	assert(data.numbers[count-1] == serial_result, "Failed: parallel_for result differs from serial");
+	
+	print("\n    %llu workers, ", job_system_get_worker_count());
+	print("serial %.2fms, ", serial*1000.0);
+	print("parallel_for %.2fms ", parallel*1000.0);
+	print("(%.2fx)\n", serial/parallel);
+	
+	dealloc(heap, data.numbers);
+}
+
+#define RING_TEST_ITEMS_PER_PRODUCER 200000
+#define RING_TEST_MAX_THREADS 8
+typedef struct Ring_Test_Data {
+	Spsc_Ring spsc;
+	Mpmc_Ring mpmc;
+	// Baseline: a plain ring behind a mutex
+	Mutex lock;
+	u64 *locked_items;
+	u64 locked_head;
+	u64 locked_tail;
+	u64 locked_capacity;
+	
+	volatile u64 consumed_count;
+	volatile u64 sums[RING_TEST_MAX_THREADS*2]; // By thread index
+	u64 total_count;
+} Ring_Test_Data;
+
+void ring_test_spsc_producer(Thread *t) {
+	Ring_Test_Data *d = (Ring_Test_Data*)t->data;
+	for (u64 i = 0; i < d->total_count; i += 1) {
+		while (!spsc_ring_push(&d->spsc, &i)) os_yield_thread();
+	}
+}
+void ring_test_mpmc_producer(Thread *t) {
+	Test_Thread *rt = (Test_Thread*)t->data;
+	Ring_Test_Data *d = (Ring_Test_Data*)rt->data;
+	for (u64 i = 0; i < RING_TEST_ITEMS_PER_PRODUCER; i += 1) {
+		u64 item = rt->index*RING_TEST_ITEMS_PER_PRODUCER + i;
+		while (!mpmc_ring_push(&d->mpmc, &item)) os_yield_thread();
+	}
+}
+void ring_test_mpmc_consumer(Thread *t) {
+	Test_Thread *rt = (Test_Thread*)t->data;
+	Ring_Test_Data *d = (Ring_Test_Data*)rt->data;
+	u64 sum = 0;
+	u64 last[RING_TEST_MAX_THREADS];
+	for (u64 i = 0; i < RING_TEST_MAX_THREADS; i += 1) last[i] = UINT64_MAX;
+	while (d->consumed_count < d->total_count) {
+		u64 item;
+		if (mpmc_ring_pop(&d->mpmc, &item)) {
+			// Items from one producer must come out in the order they went in
+			u64 producer = item / RING_TEST_ITEMS_PER_PRODUCER;
+			assert(last[producer] == UINT64_MAX || item > last[producer], "Failed: Mpmc ring items from one producer came out of order");
+			last[producer] = item;
+			sum += item;
+			atomic_add_64(&d->consumed_count, 1);
+		} else {
+			os_yield_thread();
+		}
+	}
+	d->sums[rt->index] = sum;
+}
+void ring_test_locked_producer(Thread *t) {
+	Test_Thread *rt = (Test_Thread*)t->data;
+	Ring_Test_Data *d = (Ring_Test_Data*)rt->data;
+	for (u64 i = 0; i < RING_TEST_ITEMS_PER_PRODUCER; i += 1) {
+		u64 item = rt->index*RING_TEST_ITEMS_PER_PRODUCER + i;
+		while (true) {
+			mutex_acquire_or_wait(&d->lock);
+			bool pushed = d->locked_tail - d->locked_head < d->locked_capacity;
+			if (pushed) {
+				d->locked_items[d->locked_tail % d->locked_capacity] = item;
+				d->locked_tail += 1;
+			}
+			mutex_release(&d->lock);
+			if (pushed) break;
+			os_yield_thread();
+		}
+	}
+}
+void ring_test_locked_consumer(Thread *t) {
+	Test_Thread *rt = (Test_Thread*)t->data;
+	Ring_Test_Data *d = (Ring_Test_Data*)rt->data;
+	u64 sum = 0;
+	while (d->consumed_count < d->total_count) {
+		mutex_acquire_or_wait(&d->lock);
+		bool popped = d->locked_head < d->locked_tail;
+		if (popped) {
+			sum += d->locked_items[d->locked_head % d->locked_capacity];
+			d->locked_head += 1;
+			d->consumed_count += 1;
+		}
+		mutex_release(&d->lock);
+		if (!popped) os_yield_thread();
+	}
+	d->sums[rt->index] = sum;
+}
+
+// Producers are threads 0..producer_count-1 and consumers the ones after. Returns seconds.
+float64 ring_test_run_threads(Ring_Test_Data *d, u64 producer_count, u64 consumer_count, Thread_Proc producer, Thread_Proc consumer) {
+	Thread_Proc procs[RING_TEST_MAX_THREADS*2];
+	for (u64 i = 0; i < producer_count + consumer_count; i += 1) {
+		procs[i] = i < producer_count ? producer : consumer;
+	}
+	d->consumed_count = 0;
+	d->total_count = producer_count*RING_TEST_ITEMS_PER_PRODUCER;
+	for (u64 i = 0; i < RING_TEST_MAX_THREADS*2; i += 1) d->sums[i] = 0;
+	
+	float64 seconds = test_run_threads(procs, producer_count + consumer_count, d);
+	
+	u64 sum = 0;
+	for (u64 i = 0; i < RING_TEST_MAX_THREADS*2; i += 1) sum += d->sums[i];
+	u64 n = d->total_count;
+	assert(sum == n*(n-1)/2, "Failed: Ring items were lost or duplicated (sum %llu)", sum);
+	return seconds;
+}
+
+void test_ring_buffers() {
+	Allocator heap = get_heap_allocator();
+	Ring_Test_Data *d = (Ring_Test_Data*)alloc_cache_line_aligned(heap, sizeof(Ring_Test_Data));
+	memset(d, 0, sizeof(Ring_Test_Data));
+	
+	assert(offsetof(Spsc_Ring, head) - offsetof(Spsc_Ring, tail) == CACHE_LINE_SIZE && offsetof(Spsc_Ring, tail) % CACHE_LINE_SIZE == 0, "Failed: Spsc ring indices should be on their own cache lines");
+	assert(offsetof(Mpmc_Ring, head) - offsetof(Mpmc_Ring, tail) == CACHE_LINE_SIZE && offsetof(Mpmc_Ring, tail) % CACHE_LINE_SIZE == 0, "Failed: Mpmc ring indices should be on their own cache lines");
+	assert(sizeof(Mpmc_Ring) == CACHE_LINE_SIZE*3, "Failed: Mpmc ring should be 3 cache lines");
+	
+	// Single threaded behaviour
+	spsc_ring_init(&d->spsc, sizeof(u64), 5, heap);
+	assert(d->spsc.mask == 7, "Failed: Ring capacity should round up to a power of two");
+	u64 x;
+	assert(!spsc_ring_pop(&d->spsc, &x), "Failed: Empty spsc ring should not pop");
+	for (u64 i = 0; i < 8; i += 1) assert(spsc_ring_push(&d->spsc, &i), "Failed: Spsc ring should not be full yet");
+	x = 8;
+	assert(!spsc_ring_push(&d->spsc, &x), "Failed: Full spsc ring should not push");
+	assert(spsc_ring_count(&d->spsc) == 8, "Failed: Spsc ring count is wrong");
+	for (u64 lap = 0; lap < 100; lap += 1) {
+		assert(spsc_ring_pop(&d->spsc, &x) && x == lap, "Failed: Spsc ring popped the wrong item");
+		u64 next = lap + 8;
+		assert(spsc_ring_push(&d->spsc, &next), "Failed: Spsc ring should have room after a pop");
+	}
+	spsc_ring_deinit(&d->spsc);
+	
+	mpmc_ring_init(&d->mpmc, sizeof(u64), 8, heap);
+	assert(!mpmc_ring_pop(&d->mpmc, &x), "Failed: Empty mpmc ring should not pop");
+	for (u64 i = 0; i < 8; i += 1) assert(mpmc_ring_push(&d->mpmc, &i), "Failed: Mpmc ring should not be full yet");
+	x = 8;
+	assert(!mpmc_ring_push(&d->mpmc, &x), "Failed: Full mpmc ring should not push");
+	assert(mpmc_ring_count(&d->mpmc) == 8, "Failed: Mpmc ring count is wrong");
+	for (u64 lap = 0; lap < 100; lap += 1) {
+		assert(mpmc_ring_pop(&d->mpmc, &x) && x == lap, "Failed: Mpmc ring popped the wrong item");
+		u64 next = lap + 8;
+		assert(mpmc_ring_push(&d->mpmc, &next), "Failed: Mpmc ring should have room after a pop");
+	}
+	mpmc_ring_deinit(&d->mpmc);
+	
+	// Odd item size
+	mpmc_ring_init(&d->mpmc, 3, 4, heap);
+	u8 three[3] = {1, 2, 3};
+	u8 three_out[3] = {0};
+	assert(mpmc_ring_push(&d->mpmc, three), "Failed: Mpmc ring push");
+	assert(mpmc_ring_pop(&d->mpmc, three_out) && bytes_match(three, three_out, 3), "Failed: Mpmc ring item was not copied");
+	mpmc_ring_deinit(&d->mpmc);
+	
+	// Contention benchmark
+	u64 n = RING_TEST_ITEMS_PER_PRODUCER*4;
+	spsc_ring_init(&d->spsc, sizeof(u64), 1024, heap);
+	d->total_count = n;
+	Thread producer;
+	os_thread_init(&producer, ring_test_spsc_producer);
+	producer.data = d;
+	float64 start = os_get_elapsed_seconds();
+	os_thread_start(&producer);
+	for (u64 i = 0; i < n; i += 1) {
+		while (!spsc_ring_pop(&d->spsc, &x)) os_yield_thread();
+		assert(x == i, "Failed: Spsc ring items came out of order");
+	}
+	float64 spsc_seconds = os_get_elapsed_seconds() - start;
+	os_thread_join(&producer);
+	os_thread_destroy(&producer);
+	spsc_ring_deinit(&d->spsc);
+	print("\n    spsc 1->1: %.2fm items/s\n", (n/spsc_seconds)/1000000.0);
+	
+	mutex_init(&d->lock);
+	d->locked_capacity = 1024;
+	d->locked_items = (u64*)alloc(heap, d->locked_capacity*sizeof(u64));
+	u64 thread_counts[] = {1, 2, 4};
+	for (u64 c = 0; c < sizeof(thread_counts)/sizeof(u64); c += 1) {
+		u64 threads = thread_counts[c];
+		
+		mpmc_ring_init(&d->mpmc, sizeof(u64), 1024, heap);
+		float64 mpmc_seconds = ring_test_run_threads(d, threads, threads, ring_test_mpmc_producer, ring_test_mpmc_consumer);
+		mpmc_ring_deinit(&d->mpmc);
+		
+		d->locked_head = 0;
+		d->locked_tail = 0;
+		float64 locked_seconds = ring_test_run_threads(d, threads, threads, ring_test_locked_producer, ring_test_locked_consumer);
+		
+		u64 items = threads*RING_TEST_ITEMS_PER_PRODUCER;
+		print("    %llu->%llu ", threads, threads);
+		print("mpmc: %.2fm items/s, ", (items/mpmc_seconds)/1000000.0);
+		print("mutex: %.2fm items/s\n", (items/locked_seconds)/1000000.0);
+	}
+	dealloc(heap, d->locked_items);
+	mutex_destroy(&d->lock);
+	
+	dealloc_cache_line_aligned(heap, d);
+}
+
+// About the size of a Draw_Quad
+typedef struct Sort_Test_Item {
+	u8 payload[120];
+	s32 z;
+	u32 original_index;
+} Sort_Test_Item;
+void test_radix_sort_keys() {
+	Allocator heap = get_heap_allocator();
+	
+	const u64 count = 150000;
+	const u64 bits = 21;
+	u64 *keys = (u64*)alloc(heap, count*2*sizeof(u64));
+	u64 *parallel_keys = (u64*)alloc(heap, count*2*sizeof(u64));
+	
+	for (u64 i = 0; i < count; i += 1) {
+		keys[i] = make_sort_key((u32)get_random_int_in_range(0, (1 << bits)-1), (u32)i);
+	}
+	memcpy(parallel_keys, keys, count*sizeof(u64));
+	
+	radix_sort_keys(keys, keys + count, count, bits);
+	parallel_radix_sort_keys(parallel_keys, parallel_keys + count, count, bits);
+	for (u64 i = 1; i < count; i += 1) {
+		u32 a = (u32)(keys[i-1] >> 32);
+		u32 b = (u32)(keys[i] >> 32);
+		assert(a <= b, "Failed: Keys not sorted");
+		assert(a != b || sort_key_get_index(keys[i-1]) < sort_key_get_index(keys[i]), "Failed: Key sort is not stable");
+	}
+	assert(bytes_match(keys, parallel_keys, count*sizeof(u64)), "Failed: Parallel key sort differs from single threaded");
+	
+	// Few distinct values, some passes are skipped
+	for (u64 i = 0; i < count; i += 1) keys[i] = make_sort_key((u32)(7 - i % 3), (u32)i);
+	memcpy(parallel_keys, keys, count*sizeof(u64));
+	radix_sort_keys(keys, keys + count, count, bits);
+	parallel_radix_sort_keys(parallel_keys, parallel_keys + count, count, bits);
+	assert(sort_key_get_index(keys[0]) == 2 && sort_key_get_index(keys[count-1]) == count-3, "Failed: Key sort with few values");
+	assert(bytes_match(keys, parallel_keys, count*sizeof(u64)), "Failed: Parallel key sort differs from single threaded");
+	
+	radix_sort_keys(keys, keys + count, 0, bits);
+	keys[0] = make_sort_key(5, 0);
+	radix_sort_keys(keys, keys + count, 1, bits);
+	assert(keys[0] == make_sort_key(5, 0), "Failed: Sorting one key");
+	
+	// Small sorts run on the calling thread and don't start the job system
+	job_system_shutdown();
+	for (u64 i = 0; i < 10; i += 1) keys[i] = make_sort_key((u32)(10-i), (u32)i);
+	parallel_radix_sort_keys(keys, keys + count, 10, bits);
+	assert(!job_workers, "Failed: Small parallel sort started the job system");
+	assert(sort_key_get_index(keys[0]) == 9, "Failed: Small parallel sort");
+	
+	// Whole items vs keys, z sorting quad sized items like the renderer does
+	Sort_Test_Item *items = (Sort_Test_Item*)alloc(heap, count*2*sizeof(Sort_Test_Item));
+	s32 max_z = 1 << (bits-1);
+	const int samples = 20;
+	float64 item_seconds = 0;
+	float64 key_seconds = 0;
+	float64 parallel_seconds = 0;
+	for (int sample = 0; sample < samples; sample += 1) {
+		for (u64 i = 0; i < count; i += 1) {
+			items[i].z = (s32)get_random_int_in_range(-max_z+1, max_z);
+			items[i].original_index = (u32)i;
+		}
+		
+		// Keys are built from the items every time, like the renderer has to
+		float64 start = os_get_elapsed_seconds();
+		for (u64 i = 0; i < count; i += 1) keys[i] = make_sort_key((u32)(items[i].z + max_z), (u32)i);
+		radix_sort_keys(keys, keys + count, count, bits+1);
+		key_seconds += os_get_elapsed_seconds() - start;
+		
+		start = os_get_elapsed_seconds();
+		for (u64 i = 0; i < count; i += 1) parallel_keys[i] = make_sort_key((u32)(items[i].z + max_z), (u32)i);
+		parallel_radix_sort_keys(parallel_keys, parallel_keys + count, count, bits+1);
+		parallel_seconds += os_get_elapsed_seconds() - start;
+		
+		start = os_get_elapsed_seconds();
+		radix_sort(items, items + count, count, sizeof(Sort_Test_Item), offsetof(Sort_Test_Item, z), bits);
+		item_seconds += os_get_elapsed_seconds() - start;
+		
+		for (u64 i = 0; i < count; i += 1) {
+			assert(sort_key_get_index(keys[i]) == items[i].original_index, "Failed: Key sort order differs from radix_sort");
+		}
+		assert(bytes_match(keys, parallel_keys, count*sizeof(u64)), "Failed: Parallel key sort differs from single threaded");
+	}
+	print("\n    %llu items: radix_sort ", count);
+	print("%.2fms, ", (item_seconds/samples)*1000.0);
+	print("radix_sort_keys %.2fms, ", (key_seconds/samples)*1000.0);
+	print("parallel_radix_sort_keys %.2fms\n", (parallel_seconds/samples)*1000.0);
+	
+	dealloc(heap, items);
+	dealloc(heap, keys);
+	dealloc(heap, parallel_keys);
+}
+
+typedef struct Task_Test_Data {
+	u64 steps;
+	u64 job_value;
+	bool flag;
+	bool done;
+	Task_Handle other;
+	string file;
+	bool file_ok;
+} Task_Test_Data;
+void task_test_stepper(void *data) {
+	Task_Test_Data *d = (Task_Test_Data*)data;
+	for (u64 i = 0; i < 3; i += 1) {
+		d->steps += 1;
+		task_yield();
+	}
+	d->done = true;
+}
+void task_test_job(void *data) {
+	Task_Test_Data *d = (Task_Test_Data*)data;
+	d->job_value = 69;
+}
+void task_test_awaiter(void *data) {
+	Task_Test_Data *d = (Task_Test_Data*)data;
+	assert(task_is_running_in_task(), "Failed: task_is_running_in_task");
+	
+	task_await_job(task_test_job, d);
+	assert(d->job_value == 69, "Failed: task_await_job");
+	
+	task_await_task(d->other);
+	assert(task_is_done(d->other), "Failed: task_await_task");
+	
+	float64 start = os_get_elapsed_seconds();
+	task_sleep(0.01);
+	assert(os_get_elapsed_seconds() - start >= 0.01, "Failed: task_sleep");
+	
+	d->file_ok = task_read_entire_file(STR("oogabooga_task_test.txt"), &d->file, get_heap_allocator());
+	d->done = true;
+}
+bool task_test_flag_is_set(void *data) {
+	return ((Task_Test_Data*)data)->flag;
+}
+void task_test_condition(void *data) {
+	Task_Test_Data *d = (Task_Test_Data*)data;
+	task_await_condition(task_test_flag_is_set, d);
+	d->done = true;
+}
+void task_test_counter(void *data) {
+	Task_Test_Data *d = (Task_Test_Data*)data;
+	d->steps += 1;
+}
+void test_tasks() {
+	Task_Test_Data stepper = {0};
+	Task_Handle h = task_spawn(task_test_stepper, &stepper);
+	assert(!task_is_done(h), "Failed: task_is_done");
+	assert(stepper.steps == 0, "Failed: Task ran before task_update");
+	for (u64 i = 1; i <= 3; i += 1) {
+		task_update();
+		assert(stepper.steps == i, "Failed: Task should run until it yields");
+		assert(!stepper.done, "Failed: Task finished early");
+	}
+	task_update();
+	assert(stepper.done && task_is_done(h), "Failed: Task should be done");
+	
+	Task_Test_Data condition = {0};
+	h = task_spawn(task_test_condition, &condition);
+	task_update();
+	task_update();
+	assert(!condition.done, "Failed: task_await_condition returned early");
+	condition.flag = true;
+	task_update();
+	assert(condition.done && task_is_done(h), "Failed: task_await_condition");
+	
+	string file_data = STR("Task test file");
+	assert(os_write_entire_file(STR("oogabooga_task_test.txt"), file_data), "Failed writing task test file");
+	
+	Task_Test_Data awaiter = {0};
+	Task_Test_Data other = {0};
+	awaiter.other = task_spawn(task_test_stepper, &other);
+	h = task_spawn(task_test_awaiter, &awaiter);
+	float64 start = os_get_elapsed_seconds();
+	while (!task_is_done(h)) {
+		task_update();
+		assert(os_get_elapsed_seconds() - start < 5.0, "Failed: Tasks timed out");
+	}
+	assert(awaiter.done && other.done, "Failed: Tasks did not finish");
+	assert(awaiter.file_ok && strings_match(awaiter.file, file_data), "Failed: task_read_entire_file");
+	dealloc_string(get_heap_allocator(), awaiter.file);
+	os_file_delete(STR("oogabooga_task_test.txt"));
+	
+	// Fibers are reused
+	Task_Test_Data counter = {0};
+	const u64 task_count = 1000;
+	for (u64 round = 0; round < 4; round += 1) {
+		for (u64 i = 0; i < task_count; i += 1) task_spawn(task_test_counter, &counter);
+		task_update();
+	}
+	assert(counter.steps == task_count*4, "Failed: Not all tasks ran");
+	assert(task_get_count() == 0, "Failed: Tasks were not released");
+	assert(growing_array_get_valid_count(task_free_fibers) <= task_count, "Failed: Fibers were not reused");
+	
+	// Switching cost
+	Task_Test_Data bench = {0};
+	const u64 bench_tasks = 64;
+	for (u64 i = 0; i < bench_tasks; i += 1) task_spawn(task_test_stepper, &bench);
+	start = os_get_elapsed_seconds();
+	while (task_get_count()) task_update();
+	float64 seconds = os_get_elapsed_seconds() - start;
+	assert(bench.steps == bench_tasks*3, "Failed: Not all tasks ran");
+	print("%.0fns per resume... ", (seconds/(bench_tasks*4))*1000000000.0);
+	
+	// Shutdown drops unfinished tasks and gives the thread back
+	Task_Test_Data dropped = {0};
+	task_spawn(task_test_stepper, &dropped);
+	task_update();
+	assert(os_fiber_is_thread_a_fiber(), "Failed: task_update should make the thread a fiber");
+	task_system_shutdown();
+	assert(task_get_count() == 0 && !task_free_fibers, "Failed: task_system_shutdown should free everything");
+	assert(!os_fiber_is_thread_a_fiber(), "Failed: task_system_shutdown should convert the thread back");
+	assert(dropped.steps == 1 && !dropped.done, "Failed: Dropped task should not run again");
+	
+	// And tasks work again after
+	Task_Test_Data again = {0};
+	h = task_spawn(task_test_stepper, &again);
+	while (!task_is_done(h)) task_update();
+	assert(again.done, "Failed: Tasks should run after task_system_shutdown");
+	task_system_shutdown();
+}
+
+// Roughly what a game object ends up looking like as one struct
+typedef struct Entity_Test_Object {
+	Vector2 position;
+	Vector2 velocity;
+	Vector2 size;
+	Vector4 color;
+	u64 flags;
+	u8 other_stuff[72];
+} Entity_Test_Object;
+void test_entity_storage() {
+	Allocator heap = get_heap_allocator();
+	
+	Entity_Storage s;
+	entity_storage_init(&s, heap);
+	u64 position_columns[] = { sizeof(float32), sizeof(float32) };
+	Component_Id position = entity_storage_register_component(&s, 2, position_columns);
+	u64 velocity_columns[] = { sizeof(float32), sizeof(float32) };
+	Component_Id velocity = entity_storage_register_component(&s, 2, velocity_columns);
+	u64 tag_columns[] = { sizeof(u64) };
+	Component_Id tag = entity_storage_register_component(&s, 1, tag_columns);
+	
+	assert(!entity_is_alive(&s, ZERO(Entity_Id)), "Failed: Zero entity id is alive");
+	
+	const u64 count = 1000;
+	Entity_Id *ids = (Entity_Id*)alloc(heap, count*sizeof(Entity_Id));
+	for (u64 i = 0; i < count; i += 1) {
+		ids[i] = entity_create(&s);
+		assert(entity_is_alive(&s, ids[i]), "Failed: entity_create");
+		entity_add_component(&s, ids[i], tag);
+		*(u64*)entity_get_field(&s, ids[i], tag, 0) = i;
+		entity_add_component(&s, ids[i], position);
+		*(float32*)entity_get_field(&s, ids[i], position, 0) = (float32)i;
+		if (i % 3 == 0) {
+			entity_add_component(&s, ids[i], velocity);
+			*(float32*)entity_get_field(&s, ids[i], velocity, 0) = 1.0f;
+		}
+	}
+	assert(entity_get_count(&s) == count, "Failed: entity_get_count");
+	assert(component_get_count(&s, velocity) == (count+2)/3, "Failed: component_get_count");
+	assert(entity_add_component(&s, ids[0], tag) == (u64)entity_get_component_index(&s, ids[0], tag), "Failed: Adding a component twice");
+	
+	// Destroy every 4th, remove position from every 5th
+	for (u64 i = 0; i < count; i += 4) assert(entity_destroy(&s, ids[i]), "Failed: entity_destroy");
+	for (u64 i = 1; i < count; i += 5) entity_remove_component(&s, ids[i], position);
+	assert(!entity_destroy(&s, ids[0]), "Failed: Destroying twice");
+	assert(!entity_get_field(&s, ids[0], tag, 0), "Failed: Field of a destroyed entity");
+	
+	for (u64 i = 0; i < count; i += 1) {
+		bool alive = i % 4 != 0;
+		assert(entity_is_alive(&s, ids[i]) == alive, "Failed: entity_is_alive");
+		if (!alive) continue;
+		assert(*(u64*)entity_get_field(&s, ids[i], tag, 0) == i, "Failed: Field moved to the wrong entity");
+		assert(entity_has_component(&s, ids[i], position) == (i % 5 != 1), "Failed: entity_has_component");
+		assert(entity_has_component(&s, ids[i], velocity) == (i % 3 == 0), "Failed: entity_has_component");
+		if (i % 5 != 1) assert(*(float32*)entity_get_field(&s, ids[i], position, 0) == (float32)i, "Failed: Position moved to the wrong entity");
+	}
+	
+	// Destroyed slots are reused with a new generation
+	Entity_Id reused = entity_create(&s);
+	assert(!entity_is_alive(&s, ids[count-4]) && entity_is_alive(&s, reused), "Failed: Stale id is alive");
+	assert(!entity_has_component(&s, reused, tag), "Failed: Reused entity has old components");
+	entity_destroy(&s, reused);
+	
+	// Dense iteration
+	u64 *tags = (u64*)component_get_column(&s, tag, 0);
+	Entity_Id *tag_entities = component_get_entities(&s, tag);
+	for (u64 i = 0; i < component_get_count(&s, tag); i += 1) {
+		assert(tag_entities[i].index == ids[tags[i]].index, "Failed: Dense entities out of sync");
+	}
+	
+	u64 both = components_align(&s, velocity, position);
+	u64 expected_both = 0;
+	for (u64 i = 0; i < count; i += 1) {
+		if (i % 4 != 0 && i % 3 == 0 && i % 5 != 1) expected_both += 1;
+	}
+	assert(both == expected_both, "Failed: components_align count");
+	Entity_Id *velocity_entities = component_get_entities(&s, velocity);
+	Entity_Id *position_entities = component_get_entities(&s, position);
+	float32 *px = (float32*)component_get_column(&s, position, 0);
+	float32 *vx = (float32*)component_get_column(&s, velocity, 0);
+	for (u64 i = 0; i < both; i += 1) {
+		assert(bytes_match(&velocity_entities[i], &position_entities[i], sizeof(Entity_Id)), "Failed: components_align order");
+		assert(px[i] == *(float32*)entity_get_field(&s, position_entities[i], position, 0), "Failed: Sparse out of sync after align");
+		assert(vx[i] == 1.0f, "Failed: Velocity moved to the wrong entity");
+	}
+	assert(components_align(&s, velocity, position) == both, "Failed: Aligning twice");
+	entity_remove_component(&s, position_entities[0], position);
+	assert(components_align(&s, velocity, position) == both-1, "Failed: components_align after a remove");
+	for (u64 i = 0; i < both-1; i += 1) {
+		assert(bytes_match(&velocity_entities[i], &position_entities[i], sizeof(Entity_Id)), "Failed: components_align order after a remove");
+	}
+	
+	entity_storage_deinit(&s);
+	dealloc(heap, ids);
+	
+	// Movement & culling, one struct per object vs the columns the systems touch
+	const u64 object_count = 50000;
+	const int samples = 20;
+	Entity_Test_Object *objects = (Entity_Test_Object*)alloc(heap, object_count*sizeof(Entity_Test_Object));
+	entity_storage_init(&s, heap);
+	position = entity_storage_register_component(&s, 2, position_columns);
+	velocity = entity_storage_register_component(&s, 2, velocity_columns);
+	for (u64 i = 0; i < object_count; i += 1) {
+		float32 x = get_random_float32_in_range(-1000, 1000);
+		float32 y = get_random_float32_in_range(-1000, 1000);
+		float32 dx = get_random_float32_in_range(-10, 10);
+		float32 dy = get_random_float32_in_range(-10, 10);
+		objects[i].position = v2(x, y);
+		objects[i].velocity = v2(dx, dy);
+		
+		Entity_Id e = entity_create(&s);
+		entity_add_component(&s, e, position);
+		entity_add_component(&s, e, velocity);
+		*(float32*)entity_get_field(&s, e, position, 0) = x;
+		*(float32*)entity_get_field(&s, e, position, 1) = y;
+		*(float32*)entity_get_field(&s, e, velocity, 0) = dx;
+		*(float32*)entity_get_field(&s, e, velocity, 1) = dy;
+	}
+	
+	float32 dt = 1.0f/60.0f;
+	u64 aos_visible = 0;
+	u64 soa_visible = 0;
+	float64 start = os_get_elapsed_seconds();
+	for (int sample = 0; sample < samples; sample += 1) {
+		for (u64 i = 0; i < object_count; i += 1) {
+			objects[i].position.x += objects[i].velocity.x*dt;
+			objects[i].position.y += objects[i].velocity.y*dt;
+		}
+		for (u64 i = 0; i < object_count; i += 1) {
+			Vector2 p = objects[i].position;
+			aos_visible += p.x > -500 && p.x < 500 && p.y > -300 && p.y < 300;
+		}
+	}
+	float64 aos_seconds = os_get_elapsed_seconds() - start;
+	
+	start = os_get_elapsed_seconds();
+	for (int sample = 0; sample < samples; sample += 1) {
+		u64 n = components_align(&s, velocity, position);
+		float32 *x  = (float32*)component_get_column(&s, position, 0);
+		float32 *y  = (float32*)component_get_column(&s, position, 1);
+		float32 *dx = (float32*)component_get_column(&s, velocity, 0);
+		float32 *dy = (float32*)component_get_column(&s, velocity, 1);
+		for (u64 i = 0; i < n; i += 1) {
+			x[i] += dx[i]*dt;
+			y[i] += dy[i]*dt;
+		}
+		for (u64 i = 0; i < n; i += 1) {
+			soa_visible += x[i] > -500 && x[i] < 500 && y[i] > -300 && y[i] < 300;
+		}
+	}
+	float64 soa_seconds = os_get_elapsed_seconds() - start;
+	assert(aos_visible == soa_visible, "Failed: Array of structs & entity storage disagree");
+	
+	print("\n    %llu objects move & cull: ", object_count);
+	print("array of structs %.3fms, ", (aos_seconds/samples)*1000.0);
+	print("entity storage %.3fms\n", (soa_seconds/samples)*1000.0);
+	
+	entity_storage_deinit(&s);
+	dealloc(heap, objects);
+}
+
+typedef struct Spatial_Test_Pairs {
+	Vector2 *mins;
+	Vector2 *maxs;
+	u64 count;
+	u64 key_sum;
+} Spatial_Test_Pairs;
+void spatial_test_pair_proc(u32 a, u32 b, void *data) {
+	Spatial_Test_Pairs *p = (Spatial_Test_Pairs*)data;
+	assert(a != b, "Failed: Item paired with itself");
+	assert(spatial_aabbs_overlap(p->mins[a], p->maxs[a], p->mins[b], p->maxs[b]), "Failed: Pair doesn't overlap");
+	p->count += 1;
+	p->key_sum += (u64)min(a, b)*1000003ULL + (u64)max(a, b);
+}
+// Checks every query against going through all items
+void spatial_test_check(Spatial_Hash *h, Vector2 *mins, Vector2 *maxs, bool *alive, u64 count, u32 *results) {
+	for (int q = 0; q < 50; q += 1) {
+		Vector2 center = v2(get_random_float32_in_range(-600, 600), get_random_float32_in_range(-600, 600));
+		Vector2 half = v2(get_random_float32_in_range(0, 80), get_random_float32_in_range(0, 80));
+		Vector2 qmin = v2_sub(center, half);
+		Vector2 qmax = v2_add(center, half);
+		f32 radius = half.x;
+		
+		u64 expected_rect = 0, expected_circle = 0, expected_rect_sum = 0, expected_circle_sum = 0;
+		f32 expected_t = 300;
+		bool expected_hit = false;
+		Vector2 direction = v2(get_random_float32_in_range(-1, 1), get_random_float32_in_range(-1, 1));
+		if (v2_length(direction) < 0.01f) direction = v2(1, 0);
+		Vector2 normal = v2_normalize(direction);
+		Vector2 inverse = v2(1.0f/normal.x, 1.0f/normal.y);
+		for (u64 i = 0; i < count; i += 1) {
+			if (!alive[i]) continue;
+			if (spatial_aabbs_overlap(qmin, qmax, mins[i], maxs[i])) {
+				expected_rect += 1;
+				expected_rect_sum += i;
+			}
+			if (spatial_circle_overlaps_aabb(center, radius, mins[i], maxs[i])) {
+				expected_circle += 1;
+				expected_circle_sum += i;
+			}
+			f32 t;
+			if (spatial_ray_hits_aabb(center, normal, inverse, mins[i], maxs[i], &t) && t <= expected_t) {
+				expected_t = t;
+				expected_hit = true;
+			}
+		}
+		
+		u64 found = spatial_hash_query_rect(h, qmin, qmax, results, count);
+		u64 sum = 0;
+		for (u64 i = 0; i < found; i += 1) sum += results[i];
+		assert(found == expected_rect && sum == expected_rect_sum, "Failed: spatial_hash_query_rect");
+		
+		found = spatial_hash_query_circle(h, center, radius, results, count);
+		sum = 0;
+		for (u64 i = 0; i < found; i += 1) sum += results[i];
+		assert(found == expected_circle && sum == expected_circle_sum, "Failed: spatial_hash_query_circle");
+		
+		u32 hit_id;
+		f32 hit_t;
+		bool hit = spatial_hash_raycast(h, center, direction, 300, &hit_id, &hit_t);
+		assert(hit == expected_hit, "Failed: spatial_hash_raycast hit");
+		if (hit) {
+			assert(fabsf(hit_t - expected_t) < 0.001f, "Failed: spatial_hash_raycast distance");
+			f32 t;
+			assert(alive[hit_id] && spatial_ray_hits_aabb(center, normal, inverse, mins[hit_id], maxs[hit_id], &t), "Failed: spatial_hash_raycast item");
+		}
+	}
+	
+	Spatial_Test_Pairs pairs = {mins, maxs, 0, 0};
+	u64 expected_pairs = 0, expected_sum = 0;
+	for (u64 i = 0; i < count; i += 1) {
+		if (!alive[i]) continue;
+		for (u64 j = i+1; j < count; j += 1) {
+			if (!alive[j] || !spatial_aabbs_overlap(mins[i], maxs[i], mins[j], maxs[j])) continue;
+			expected_pairs += 1;
+			expected_sum += i*1000003ULL + j;
+		}
+	}
+	u64 found_pairs = spatial_hash_find_pairs(h, spatial_test_pair_proc, &pairs);
+	assert(found_pairs == expected_pairs && pairs.count == expected_pairs, "Failed: spatial_hash_find_pairs count");
+	assert(pairs.key_sum == expected_sum, "Failed: spatial_hash_find_pairs pairs");
+}
+void test_spatial_hash() {
+	Allocator heap = get_heap_allocator();
+	
+	const u64 count = 2000;
+	Vector2 *mins = (Vector2*)alloc(heap, count*sizeof(Vector2));
+	Vector2 *maxs = (Vector2*)alloc(heap, count*sizeof(Vector2));
+	bool *alive = (bool*)alloc(heap, count*sizeof(bool));
+	u32 *ids = (u32*)alloc(heap, count*sizeof(u32));
+	u32 *results = (u32*)alloc(heap, count*sizeof(u32));
+	for (u64 i = 0; i < count; i += 1) {
+		// Every 100th is big enough to stay loose
+		f32 size = i % 100 == 0 ? 150 : get_random_float32_in_range(0, 20);
+		mins[i] = v2(get_random_float32_in_range(-500, 500), get_random_float32_in_range(-500, 500));
+		maxs[i] = v2(mins[i].x + size, mins[i].y + get_random_float32_in_range(0, size));
+		alive[i] = true;
+	}
+	
+	Spatial_Hash h;
+	spatial_hash_init(&h, 16, heap);
+	spatial_hash_insert_batch(&h, mins, maxs, count, ids);
+	for (u64 i = 0; i < count; i += 1) assert(ids[i] == i, "Failed: Batch insert ids");
+	assert(spatial_hash_get_count(&h) == count, "Failed: spatial_hash_get_count");
+	spatial_test_check(&h, mins, maxs, alive, count, results);
+	
+	assert(spatial_hash_query_rect(&h, v2(-1000, -1000), v2(1000, 1000), results, 10) == count, "Failed: Query over everything");
+	
+	// Move everything a bit, some change cells and go loose
+	for (int round = 0; round < 3; round += 1) {
+		for (u64 i = 0; i < count; i += 1) {
+			Vector2 d = v2(get_random_float32_in_range(-6, 6), get_random_float32_in_range(-6, 6));
+			mins[i] = v2_add(mins[i], d);
+			maxs[i] = v2_add(maxs[i], d);
+			spatial_hash_move(&h, (u32)i, mins[i], maxs[i]);
+		}
+		spatial_test_check(&h, mins, maxs, alive, count, results);
+		spatial_hash_update(&h);
+		spatial_test_check(&h, mins, maxs, alive, count, results);
+	}
+	
+	// Remove some, reinsert a few which reuse ids
+	for (u64 i = 0; i < count; i += 7) {
+		assert(spatial_hash_remove(&h, (u32)i), "Failed: spatial_hash_remove");
+		alive[i] = false;
+	}
+	assert(!spatial_hash_remove(&h, 0), "Failed: Removing twice");
+	spatial_test_check(&h, mins, maxs, alive, count, results);
+	for (u64 n = 0; n < 10; n += 1) {
+		u32 id = spatial_hash_insert(&h, v2(0, 0), v2(5, 5));
+		assert(id < count && !alive[id], "Failed: Insert should reuse removed ids");
+		alive[id] = true;
+		mins[id] = v2(0, 0);
+		maxs[id] = v2(5, 5);
+	}
+	spatial_test_check(&h, mins, maxs, alive, count, results);
+	spatial_hash_rebuild(&h);
+	spatial_test_check(&h, mins, maxs, alive, count, results);
+	
+	// Removing large items takes them out of large_count
+	u64 large_count_before = h.large_count;
+	u32 large_ids[3];
+	for (u64 i = 0; i < 3; i += 1) large_ids[i] = spatial_hash_insert(&h, v2(-400, -400), v2(400, 400));
+	spatial_hash_rebuild(&h);
+	assert(h.large_count == large_count_before + 3, "Failed: Large items should be counted on rebuild");
+	for (u64 i = 0; i < 3; i += 1) spatial_hash_remove(&h, large_ids[i]);
+	assert(h.large_count == large_count_before, "Failed: Removing large items should decrement large_count");
+	
+	spatial_hash_deinit(&h);
+	
+	// Rays along an axis, with the origin on a box's edge
+	spatial_hash_init(&h, 16, heap);
+	u32 box = spatial_hash_insert(&h, v2(10, 10), v2(20, 20));
+	spatial_hash_rebuild(&h);
+	u32 hit_id = 0;
+	f32 hit_t = 0;
+	assert(spatial_hash_raycast(&h, v2(10, 0), v2(0, 1), 100, &hit_id, &hit_t) && hit_id == box && hit_t == 10, "Failed: Vertical ray on the box's edge");
+	assert(spatial_hash_raycast(&h, v2(0, 20), v2(1, 0), 100, &hit_id, &hit_t) && hit_id == box && hit_t == 10, "Failed: Horizontal ray on the box's edge");
+	assert(spatial_hash_raycast(&h, v2(20, 30), v2(0, -1), 100, &hit_id, &hit_t) && hit_id == box && hit_t == 10, "Failed: Downward ray on the box's edge");
+	assert(!spatial_hash_raycast(&h, v2(9.9f, 0), v2(0, 1), 100, 0, 0), "Failed: Vertical ray next to the box");
+	assert(!spatial_hash_raycast(&h, v2(0, 20.1f), v2(1, 0), 100, 0, 0), "Failed: Horizontal ray next to the box");
+	
+	// Unbounded rays stop at the grid's cells
+	assert(!spatial_hash_raycast(&h, v2(0, 0), v2(-1, 0.3f), F32_MAX, 0, 0), "Failed: Ray away from everything");
+	assert(!spatial_hash_raycast(&h, v2(15, 25), v2(0, 1), F32_MAX, 0, 0), "Failed: Ray out of the grid");
+	assert(spatial_hash_raycast(&h, v2(-100000, 15), v2(1, 0), F32_MAX, &hit_id, &hit_t) && hit_id == box && hit_t == 100010, "Failed: Ray from far away");
+	spatial_hash_deinit(&h);
+	
+	dealloc(heap, mins);
+	dealloc(heap, maxs);
+	dealloc(heap, alive);
+	dealloc(heap, ids);
+	dealloc(heap, results);
+	
+	// Moving objects at the same density, 1k to 1m
+	print("\n");
+	for (u64 object_count = 1000; object_count <= 1000000; object_count *= 10) {
+		f32 world = sqrtf((f32)object_count)*8;
+		Vector2 *positions = (Vector2*)alloc(heap, object_count*sizeof(Vector2));
+		Vector2 *velocities = (Vector2*)alloc(heap, object_count*sizeof(Vector2));
+		Vector2 *sizes = (Vector2*)alloc(heap, object_count*sizeof(Vector2));
+		mins = (Vector2*)alloc(heap, object_count*sizeof(Vector2));
+		maxs = (Vector2*)alloc(heap, object_count*sizeof(Vector2));
+		for (u64 i = 0; i < object_count; i += 1) {
+			positions[i] = v2(get_random_float32_in_range(0, world), get_random_float32_in_range(0, world));
+			velocities[i] = v2(get_random_float32_in_range(-30, 30), get_random_float32_in_range(-30, 30));
+			sizes[i] = v2(get_random_float32_in_range(1, 4), get_random_float32_in_range(1, 4));
+			mins[i] = positions[i];
+			maxs[i] = v2_add(positions[i], sizes[i]);
+		}
+		
+		spatial_hash_init(&h, 4, heap);
+		float64 start = os_get_elapsed_seconds();
+		spatial_hash_insert_batch(&h, mins, maxs, object_count, 0);
+		float64 build_seconds = os_get_elapsed_seconds() - start;
+		
+		const int frames = 5;
+		u64 pair_count = 0;
+		float64 move_seconds = 0;
+		float64 pair_seconds = 0;
+		for (int frame = 0; frame < frames; frame += 1) {
+			start = os_get_elapsed_seconds();
+			for (u64 i = 0; i < object_count; i += 1) {
+				positions[i] = v2_add(positions[i], v2_mulf(velocities[i], 1.0f/60.0f));
+				mins[i] = positions[i];
+				maxs[i] = v2_add(positions[i], sizes[i]);
+				spatial_hash_move(&h, (u32)i, mins[i], maxs[i]);
+			}
+			spatial_hash_update(&h);
+			move_seconds += os_get_elapsed_seconds() - start;
+			
+			start = os_get_elapsed_seconds();
+			pair_count = spatial_hash_find_pairs(&h, 0, 0);
+			pair_seconds += os_get_elapsed_seconds() - start;
+		}
+		
+		print("    %llu objects: ", object_count);
+		print("batch insert %.2fms, ", build_seconds*1000.0);
+		print("move & update %.2fms, ", (move_seconds/frames)*1000.0);
+		print("pairs %.2fms ", (pair_seconds/frames)*1000.0);
+		print("(%llu pairs)", pair_count);
+		
+		if (object_count <= 10000) {
+			start = os_get_elapsed_seconds();
+			u64 brute_pairs = 0;
+			for (u64 i = 0; i < object_count; i += 1) {
+				for (u64 j = i+1; j < object_count; j += 1) {
+					brute_pairs += spatial_aabbs_overlap(mins[i], maxs[i], mins[j], maxs[j]);
+				}
+			}
+			float64 brute_seconds = os_get_elapsed_seconds() - start;
+			assert(brute_pairs == pair_count, "Failed: Spatial hash pairs differ from brute force");
+			print(", brute force %.2fms (%llu pairs)", brute_seconds*1000.0, brute_pairs);
+		}
+		print("\n");
+		
+		spatial_hash_deinit(&h);
+		dealloc(heap, positions);
+		dealloc(heap, velocities);
+		dealloc(heap, sizes);
+		dealloc(heap, mins);
+		dealloc(heap, maxs);
+	}
 }
 
 #ifndef OOGABOOGA_HEADLESS
@@ -1708,6 +3934,22 @@ void oogabooga_run_tests() {
 	test_allocator(true);
 	print("OK!\n");
 	
+	print("Testing arena... ");
+	test_arena();
+	print("OK!\n");
+	
+	print("Testing object pool... ");
+	test_object_pool();
+	print("OK!\n");
+	
+	print("Testing chunked array... ");
+	test_chunked_array();
+	print("OK!\n");
+	
+	print("Testing allocator thread scaling... ");
+	test_allocator_thread_scaling();
+	print("OK!\n");
+	
 	print("Testing threads... ");
 	test_threads();
 	print("OK!\n");
@@ -1732,10 +3974,30 @@ void oogabooga_run_tests() {
 	test_simd();
 	print("OK!\n");
 	
+	print("Testing hash... ");
+	test_hash();
+	print("OK!\n");
+	
+	print("Testing hash performance... ");
+	test_hash_performance();
+	print("OK!\n");
+	
 	print("Testing hash table... ");
 	test_hash_table();
 	print("OK!\n");
 	
+	print("Testing hash map... ");
+	test_hash_map();
+	print("OK!\n");
+	
+	print("Testing hash map vs hash table performance... ");
+	test_hash_map_vs_hash_table_performance();
+	print("OK!\n");
+	
+	print("Testing typed containers... ");
+	test_typed_containers();
+	print("OK!\n");
+	
 	print("Testing random distribution... ");
 	test_random_distribution();
 	print("OK!\n");
@@ -1744,9 +4006,45 @@ void oogabooga_run_tests() {
 	test_mutex();
 	print("OK!\n");
 	
+	print("Testing atomics... ");
+	test_atomics();
+	print("OK!\n");
+	
+	print("Testing sync primitives... ");
+	test_sync_primitives();
+	print("OK!\n");
+	
 	print("Testing binary semaphore... ");
 	test_os_binary_semaphore();
 	print("OK!\n");
+	
+	print("Testing string intern... ");
+	test_string_intern();
+	print("OK!\n");
+	
+	print("Testing job system... ");
+	test_job_system();
+	print("OK!\n");
+	
+	print("Testing ring buffers... ");
+	test_ring_buffers();
+	print("OK!\n");
+	
+	print("Testing radix sort keys... ");
+	test_radix_sort_keys();
+	print("OK!\n");
+	
+	print("Testing tasks... ");
+	test_tasks();
+	print("OK!\n");
+	
+	print("Testing entity storage... ");
+	test_entity_storage();
+	print("OK!\n");
+	
+	print("Testing spatial hash... ");
+	test_spatial_hash();
+	print("OK!\n");
 
 #ifndef OOGABOOGA_HEADLESS
 	print("Testing radix sort... ");
@@ -0,0 +1,186 @@
+
+/*
+
+	Typed growing array & hash map functions, for hot loops.
+
+	growing_array_add() & hash_map_set_raw() take the item size at runtime and memcpy
+	everything. These macros stamp out functions for one item type so copies are plain
+	assignments with a compile time size, and comparisons are whatever you pass in.
+
+	The data is the same as the untyped containers, so the untyped API still works on it:
+	a typed array is a regular growing array, and a typed map is a regular Hash_Map.
+
+	Full API:
+
+		DEFINE_TYPED_ARRAY(Name, Item_Type, EQUALS)
+
+			void       Name_init(Item_Type **array, Allocator allocator);
+			void       Name_init_reserve(Item_Type **array, u64 count_to_reserve, Allocator allocator);
+			void       Name_deinit(Item_Type **array);
+			u32        Name_count(Item_Type *array);
+			Item_Type *Name_add(Item_Type **array, Item_Type item);
+			void       Name_add_multiple(Item_Type **array, Item_Type *items, u64 count);
+			Item_Type  Name_pop(Item_Type **array);
+			void       Name_ordered_remove(Item_Type **array, u32 index);
+			void       Name_unordered_remove(Item_Type **array, u32 index);
+			// Returns -1 if not found
+			s32        Name_find(Item_Type *array, Item_Type item);
+			bool       Name_unordered_remove_one_by_value(Item_Type **array, Item_Type item);
+
+		DEFINE_TYPED_MAP(Name, Key_Type, Value_Type, HASH, EQUALS)
+
+			Hash_Map    Name_make(Allocator allocator);
+			// Returns true if key was newly added or false if it already existed
+			bool        Name_set(Hash_Map *map, Key_Type key, Value_Type value);
+			// Returns 0 if not found
+			Value_Type *Name_find(Hash_Map *map, Key_Type key);
+			bool        Name_contains(Hash_Map *map, Key_Type key);
+			bool        Name_remove(Hash_Map *map, Key_Type key);
+
+	EQUALS(a, b) is called with two Item_Type/Key_Type lvalues. typed_equals_scalar,
+	typed_equals_bytes and typed_equals_string are there for the usual cases.
+	HASH(key) is called with a Key_Type. Pass get_hash if you also want to use the untyped
+	hash_map_* macros on the same map.
+
+	Usage:
+
+		// At file scope
+		DEFINE_TYPED_ARRAY(entity_array, Entity*, typed_equals_scalar)
+		DEFINE_TYPED_MAP(id_map, u64, Entity*, get_hash, typed_equals_scalar)
+
+		Entity **entities;
+		entity_array_init(&entities, get_heap_allocator());
+		entity_array_add(&entities, e);
+
+		Hash_Map ids = id_map_make(get_heap_allocator());
+		id_map_set(&ids, e->id, e);
+		Entity **found = id_map_find(&ids, e->id);
+*/
+
+#define typed_equals_scalar(a, b) ((a) == (b))
+#define typed_equals_bytes(a, b) bytes_match(&(a), &(b), sizeof(a))
+#define typed_equals_string(a, b) strings_match((a), (b))
+
+#define TYPED_MAP_VALUE_OFFSET(Key_Type) (HASH_MAP_KEY_OFFSET + align_next(sizeof(Key_Type), 8))
+#define TYPED_MAP_SLOT_SIZE(Key_Type, Value_Type) (TYPED_MAP_VALUE_OFFSET(Key_Type) + align_next(sizeof(Value_Type), 8))
+
+#define DEFINE_TYPED_ARRAY(Name, Item_Type, EQUALS) \
+	inline void Name##_init(Item_Type **array, Allocator allocator) { \
+		growing_array_init((void**)array, sizeof(Item_Type), allocator); \
+	} \
+	inline void Name##_init_reserve(Item_Type **array, u64 count_to_reserve, Allocator allocator) { \
+		growing_array_init_reserve((void**)array, sizeof(Item_Type), count_to_reserve, allocator); \
+	} \
+	inline void Name##_deinit(Item_Type **array) { \
+		growing_array_deinit((void**)array); \
+	} \
+	inline Growing_Array_Header *Name##_get_header(Item_Type *array) { \
+		Growing_Array_Header *header = ((Growing_Array_Header*)array) - 1; \
+		assert(header->block_size_in_bytes == sizeof(Item_Type), "Growing array was not initted for this item type"); \
+		return header; \
+	} \
+	inline u32 Name##_count(Item_Type *array) { \
+		return Name##_get_header(array)->valid_count; \
+	} \
+	inline Item_Type *Name##_add(Item_Type **array, Item_Type item) { \
+		Growing_Array_Header *header = Name##_get_header(*array); \
+		if (header->valid_count == header->allocated_count) { \
+			growing_array_reserve((void**)array, header->valid_count+1); \
+			header = Name##_get_header(*array); \
+		} \
+		Item_Type *p = *array + header->valid_count; \
+		*p = item; \
+		header->valid_count += 1; \
+		return p; \
+	} \
+	inline void Name##_add_multiple(Item_Type **array, Item_Type *items, u64 count) { \
+		Growing_Array_Header *header = Name##_get_header(*array); \
+		growing_array_reserve((void**)array, header->valid_count+count); \
+		header = Name##_get_header(*array); \
+		Item_Type *p = *array + header->valid_count; \
+		for (u64 i = 0; i < count; i += 1) p[i] = items[i]; \
+		header->valid_count += (u32)count; \
+	} \
+	inline Item_Type Name##_pop(Item_Type **array) { \
+		Growing_Array_Header *header = Name##_get_header(*array); \
+		assert(header->valid_count > 0, "No items to pop in growing array"); \
+		header->valid_count -= 1; \
+		return (*array)[header->valid_count]; \
+	} \
+	inline void Name##_ordered_remove(Item_Type **array, u32 index) { \
+		Growing_Array_Header *header = Name##_get_header(*array); \
+		assert(index < header->valid_count, "Growing array index out of range"); \
+		memmove(*array + index, *array + index + 1, (header->valid_count-index-1)*sizeof(Item_Type)); \
+		header->valid_count -= 1; \
+	} \
+	inline void Name##_unordered_remove(Item_Type **array, u32 index) { \
+		Growing_Array_Header *header = Name##_get_header(*array); \
+		assert(index < header->valid_count, "Growing array index out of range"); \
+		header->valid_count -= 1; \
+		(*array)[index] = (*array)[header->valid_count]; \
+	} \
+	inline s32 Name##_find(Item_Type *array, Item_Type item) { \
+		u32 count = Name##_get_header(array)->valid_count; \
+		for (u32 i = 0; i < count; i += 1) { \
+			if (EQUALS(array[i], item)) return (s32)i; \
+		} \
+		return -1; \
+	} \
+	inline bool Name##_unordered_remove_one_by_value(Item_Type **array, Item_Type item) { \
+		s32 i = Name##_find(*array, item); \
+		if (i < 0) return false; \
+		Name##_unordered_remove(array, (u32)i); \
+		return true; \
+	}
+
+// Same probing as hash_map_find_index(), with the key compare and slot size known at compile time
+#define DEFINE_TYPED_MAP(Name, Key_Type, Value_Type, HASH, EQUALS) \
+	inline Hash_Map Name##_make(Allocator allocator) { \
+		return make_hash_map(Key_Type, Value_Type, allocator); \
+	} \
+	inline s64 Name##_find_index(Hash_Map *map, Key_Type key, u64 hash) { \
+		assert(map->_slot_size == TYPED_MAP_SLOT_SIZE(Key_Type, Value_Type), "Hash map was not initted for these key & value types"); \
+		if (!map->capacity) return -1; \
+		u64 mask = map->capacity-1; \
+		u8 h2 = hash_map_get_h2(hash); \
+		u64 pos = hash_map_get_h1(hash) & mask; \
+		for (u64 probe = 0; probe <= map->capacity/HASH_MAP_GROUP_WIDTH; probe += 1) { \
+			u8 *group = map->ctrl + pos; \
+			u32 matches = hash_map_group_match(group, h2); \
+			while (matches) { \
+				u64 index = (pos + bit_scan_forward_64(matches)) & mask; \
+				u8 *slot = map->slots + index*TYPED_MAP_SLOT_SIZE(Key_Type, Value_Type); \
+				if (*(u64*)slot == hash && EQUALS(*(Key_Type*)(slot+HASH_MAP_KEY_OFFSET), key)) return (s64)index; \
+				matches &= matches-1; \
+			} \
+			if (hash_map_group_match(group, HASH_MAP_CTRL_EMPTY)) return -1; \
+			pos = (pos + (probe+1)*HASH_MAP_GROUP_WIDTH) & mask; \
+		} \
+		return -1; \
+	} \
+	inline Value_Type *Name##_find(Hash_Map *map, Key_Type key) { \
+		s64 index = Name##_find_index(map, key, HASH(key)); \
+		if (index == -1) return 0; \
+		return (Value_Type*)(map->slots + index*TYPED_MAP_SLOT_SIZE(Key_Type, Value_Type) + TYPED_MAP_VALUE_OFFSET(Key_Type)); \
+	} \
+	inline bool Name##_contains(Hash_Map *map, Key_Type key) { \
+		return Name##_find_index(map, key, HASH(key)) != -1; \
+	} \
+	inline bool Name##_set(Hash_Map *map, Key_Type key, Value_Type value) { \
+		u64 hash = HASH(key); \
+		s64 index = Name##_find_index(map, key, hash); \
+		if (index != -1) { \
+			*(Value_Type*)(map->slots + index*TYPED_MAP_SLOT_SIZE(Key_Type, Value_Type) + TYPED_MAP_VALUE_OFFSET(Key_Type)) = value; \
+			return false; \
+		} \
+		u8 *slot = hash_map_insert_new(map, hash); \
+		*(Key_Type*)(slot+HASH_MAP_KEY_OFFSET) = key; \
+		*(Value_Type*)(slot+TYPED_MAP_VALUE_OFFSET(Key_Type)) = value; \
+		return true; \
+	} \
+	inline bool Name##_remove(Hash_Map *map, Key_Type key) { \
+		s64 index = Name##_find_index(map, key, HASH(key)); \
+		if (index == -1) return false; \
+		hash_map_erase_index(map, (u64)index); \
+		return true; \
+	}
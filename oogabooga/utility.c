@@ -65,6 +65,72 @@ void radix_sort(void *collection, void *help_buffer, u64 item_count, u64 item_si
     }
 }
 
+// Key-only radix sort.
+// Instead of moving whole items around every pass like radix_sort, sort small keys that
+// hold the sort value and the item's index, then read the items through the sorted
+// indices (or permute them once).
+// A key is make_sort_key(value, index): the value in the upper 32 bits and the index in the
+// lower 32 bits. Only the lowest number_of_bits of the value are sorted on, so bias signed
+// values to be unsigned first. The sort is stable, so items with the same value keep the
+// order of their indices.
+// help_buffer should have room for count keys. The result ends up in keys.
+// parallel_radix_sort_keys() in concurrency.c does the same on the job system.
+#define RADIX_KEY_BITS_PER_PASS 11
+#define RADIX_KEY_BUCKETS (1 << RADIX_KEY_BITS_PER_PASS)
+#define RADIX_KEY_MAX_PASSES ((32 + RADIX_KEY_BITS_PER_PASS - 1) / RADIX_KEY_BITS_PER_PASS)
+
+inline u64 make_sort_key(u32 value, u32 index) {
+	return ((u64)value << 32) | (u64)index;
+}
+inline u32 sort_key_get_index(u64 key) {
+	return (u32)key;
+}
+inline u32 sort_key_get_digit(u64 key, u32 shift) {
+	return (u32)(key >> (32 + shift)) & (RADIX_KEY_BUCKETS-1);
+}
+
+void radix_sort_keys(u64 *keys, u64 *help_buffer, u64 count, u64 number_of_bits) {
+	assert(number_of_bits > 0 && number_of_bits <= 32, "radix_sort_keys sorts on 1 to 32 bits");
+	if (!count) return;
+	
+	const u32 pass_count = (u32)((number_of_bits + RADIX_KEY_BITS_PER_PASS - 1) / RADIX_KEY_BITS_PER_PASS);
+	
+	// Histograms for every pass in one read of the keys
+	u32 histograms[RADIX_KEY_MAX_PASSES][RADIX_KEY_BUCKETS];
+	memset(histograms, 0, sizeof(histograms));
+	for (u64 i = 0; i < count; i += 1) {
+		for (u32 pass = 0; pass < pass_count; pass += 1) {
+			histograms[pass][sort_key_get_digit(keys[i], pass*RADIX_KEY_BITS_PER_PASS)] += 1;
+		}
+	}
+	
+	u64 *src = keys;
+	u64 *dst = help_buffer;
+	for (u32 pass = 0; pass < pass_count; pass += 1) {
+		u32 shift = pass*RADIX_KEY_BITS_PER_PASS;
+		u32 *offsets = histograms[pass];
+		
+		// All keys have the same digit, this pass wouldn't move anything
+		if (offsets[sort_key_get_digit(src[0], shift)] == count) continue;
+		
+		u32 sum = 0;
+		for (u32 d = 0; d < RADIX_KEY_BUCKETS; d += 1) {
+			u32 c = offsets[d];
+			offsets[d] = sum;
+			sum += c;
+		}
+		
+		for (u64 i = 0; i < count; i += 1) {
+			u64 key = src[i];
+			dst[offsets[sort_key_get_digit(key, shift)]++] = key;
+		}
+		
+		u64 *t = src; src = dst; dst = t;
+	}
+	
+	if (src != keys) memcpy(keys, src, count*sizeof(u64));
+}
+
 void merge_sort(void *collection, void *help_buffer, u64 item_count, u64 item_size, int (*compare)(const void *, const void *)) {
     u8 *items = (u8 *)collection;
     u8 *buffer = (u8 *)help_buffer;